@@ -0,0 +1,155 @@
+#include <mpi.h>
+#include <omp.h>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../include/matrix.h"
+#include "../include/mpi_multiply.h"
+
+// Гибридный вариант: один ранг MPI на узел или сокет, внутри ранга — потоки OpenMP.
+// B хранится один раз на ранг, а не на каждое ядро, как в mpi.cc.
+// Запуск, например: mpirun -np 2 --map-by socket --bind-to socket ./hybrid --threads 13
+
+constexpr uint64_t SEED = 42;
+constexpr int MIN_VAL = 0;
+constexpr int MAX_VAL = 100;
+
+// 1, 2, 4, ..., max и сам max, если он не степень двойки.
+static std::vector<int> powers_up_to(int max) {
+    std::vector<int> counts;
+    for (int n = 1; n <= max; n *= 2) {
+        counts.push_back(n);
+    }
+    if (counts.back() != max) {
+        counts.push_back(max);
+    }
+    return counts;
+}
+
+struct Measurement {
+    int ranks, threads;
+    std::vector<double> times;
+};
+
+// Отдельный файл рядом с результатами mpi.cc: statistic.csv остаётся за ним.
+void write_csv_results(const std::vector<int>& sizes, const std::vector<Measurement>& results) {
+    const std::filesystem::path dir_result = "result";
+    try {
+        std::filesystem::create_directories(dir_result);
+    }
+    catch (const std::filesystem::filesystem_error& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return;
+    }
+
+    std::ofstream file(dir_result / "hybrid.csv");
+    if (!file.is_open()) {
+        std::cerr << "Couldn't open result/hybrid.csv for writing" << std::endl;
+        return;
+    }
+
+    file << "Ranks,Threads";
+    for (int size : sizes) {
+        file << "," << size;
+    }
+    file << "\n";
+
+    for (const Measurement& m : results) {
+        file << m.ranks << "," << m.threads;
+        for (double time : m.times) {
+            file << "," << std::fixed << std::setprecision(4) << time;
+        }
+        file << "\n";
+    }
+}
+
+int main(int argc, char** argv) {
+    // MPI вызывается только из главного потока, вне параллельных областей.
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+
+    int rank, world_size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+    if (provided < MPI_THREAD_FUNNELED && rank == 0) {
+        std::cerr << "Warning: MPI library does not provide MPI_THREAD_FUNNELED" << std::endl;
+    }
+
+    int max_threads = omp_get_max_threads();
+    int max_ranks = world_size;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            max_threads = std::stoi(argv[++i]);
+        } else if (arg == "--ranks" && i + 1 < argc) {
+            max_ranks = std::min(world_size, std::stoi(argv[++i]));
+        }
+    }
+
+    const std::vector<int> SIZES = {100, 200, 300, 400, 500, 1000, 2000};
+    const std::vector<int> RANK_COUNTS = powers_up_to(max_ranks);
+    const std::vector<int> THREAD_COUNTS = powers_up_to(max_threads);
+
+    std::vector<Measurement> results;
+    for (int ranks : RANK_COUNTS) {
+        for (int threads : THREAD_COUNTS) {
+            results.push_back({ranks, threads, std::vector<double>(SIZES.size())});
+        }
+    }
+
+    for (size_t size_idx = 0; size_idx < SIZES.size(); size_idx++) {
+        const int size = SIZES[size_idx];
+
+        // Входные матрицы есть только на ранге 0, остальные получают свои полосы.
+        M::Matrix<int> A{}, B{}, result{};
+        if (rank == 0) {
+            std::cout << "Processing size: " << size << "x" << size << std::endl;
+            A = M::Matrix<int>(size, size);
+            B = M::Matrix<int>(size, size);
+            result = M::Matrix<int>(size, size);
+            A.fill_random(MIN_VAL, MAX_VAL, SEED, max_threads);
+            B.fill_random(MIN_VAL, MAX_VAL, SEED + 1, max_threads);
+        }
+
+        size_t idx = 0;
+        for (int ranks : RANK_COUNTS) {
+            MPI_Comm comm;
+            MPI_Comm_split(MPI_COMM_WORLD, rank < ranks ? 0 : MPI_UNDEFINED, rank, &comm);
+
+            for (int threads : THREAD_COUNTS) {
+                MPI_Barrier(MPI_COMM_WORLD);
+                const double start_time = MPI_Wtime();
+
+                if (comm != MPI_COMM_NULL) {
+                    M::scatter_multiply<int>(A.view(), B.view(), result.view(), comm, threads);
+                }
+
+                MPI_Barrier(MPI_COMM_WORLD);
+                const double time = MPI_Wtime() - start_time;
+
+                if (rank == 0) {
+                    results[idx].times[size_idx] = time;
+                    std::cout << "  Ranks: " << ranks << " Threads: " << threads
+                              << " Time: " << time << " s" << std::endl;
+                }
+                ++idx;
+            }
+
+            if (comm != MPI_COMM_NULL) {
+                MPI_Comm_free(&comm);
+            }
+        }
+    }
+
+    if (rank == 0) {
+        write_csv_results(SIZES, results);
+    }
+
+    MPI_Finalize();
+    return 0;
+}
@@ -4,9 +4,21 @@
 #include <random>
 #include <filesystem>
 #include <string>
+#include <iomanip>
+#include <optional>
+#include <tuple>
+#include <utility>
 #include <mpi.h>
 
+#include "../include/dist_matrix.h"
 #include "../include/matrix.h"
+#include "../include/mpi_multiply.h"
+#include "../include/mpi_types.h"
+#include "../include/trace_mpi.h"
+#include "../include/verify_mpi.h"
+
+// Общий для всех рангов seed входных матриц.
+constexpr uint64_t SEED = 42;
 
 static void create_directory(const std::string& dir_name) {
     try {
@@ -42,72 +54,228 @@ static void create_directory(const std::string& dir_name) {
     }
 }
 
+using M::mpi_type;
+using M::row_type;
+using M::view_type;
+
+template <typename T>
+void send_view(M::ConstMatrixView<T> view, int dest) {
+    int count;
+    MPI_Datatype type = view_type(view, count);
+    MPI_Send(view.get_data(), count, type, dest, 0, MPI_COMM_WORLD);
+    if (!view.is_contiguous()) {
+        MPI_Type_free(&type);
+    }
+}
+
 template <typename T>
-M::Matrix<T> matrix_multiply_mpi(const M::Matrix<T>& A, const M::Matrix<T>& B, int num_procs) {
+void recv_view(M::MatrixView<T> view, int src) {
+    int count;
+    MPI_Datatype type = view_type<T>(view, count);
+    MPI_Recv(view.get_data(), count, type, src, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    if (!view.is_contiguous()) {
+        MPI_Type_free(&type);
+    }
+}
+
+// result заполняется только на ранге 0. Каждый ранг считает свои строки прямо
+// в result (ранг 0) или в локальную панель, которая уходит на ранг 0 без копирования.
+template <typename T>
+void matrix_multiply_mpi(M::ConstMatrixView<T> A, M::ConstMatrixView<T> B, M::MatrixView<T> result,
+                         int num_procs) {
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
     const size_t rows = A.get_rows();
     const size_t cols = B.get_cols();
-    const size_t inner_dim = A.get_cols();
-
-    M::Matrix<T> result(rows, cols);
 
     // Распределение работы между процессами
     const size_t rows_per_process = rows / num_procs;
     const size_t remainder = rows % num_procs;
 
-    size_t start_row = rank * rows_per_process + std::min(rank, static_cast<int>(remainder));
-    size_t end_row = start_row + rows_per_process + (rank < remainder ? 1 : 0);
+    auto first_row = [&](int r) {
+        return r * rows_per_process + std::min(static_cast<size_t>(r), remainder);
+    };
+    auto row_count = [&](int r) {
+        return rows_per_process + (static_cast<size_t>(r) < remainder ? 1 : 0);
+    };
 
-    // Каждый процесс вычисляет свою часть матрицы
-    M::Matrix<T> local_result(end_row - start_row, cols);
+    const size_t start_row = first_row(rank);
+    const size_t local_rows = row_count(rank);
 
-    for (size_t i = start_row; i < end_row; ++i) {
-        for (size_t j = 0; j < cols; ++j) {
-            T sum{};
-            for (size_t k = 0; k < inner_dim; ++k) {
-                sum += A(i, k) * B(k, j);
-            }
-            local_result(i - start_row, j) = sum;
+    // Собираем результаты на root процессе (ранг 0)
+    if (rank == 0) {
+        M::MatrixView<T> own = result.row_panel(start_row, local_rows);
+        for (size_t i = 0; i < local_rows; ++i) {
+            std::fill(own.row(i), own.row(i) + cols, T{});
+        }
+        M::gemm(A.row_panel(start_row, local_rows), B, own);
+
+        for (int src = 1; src < num_procs; ++src) {
+            recv_view(result.row_panel(first_row(src), row_count(src)), src);
         }
+    } else {
+        M::Matrix<T> local_result(local_rows, cols);
+        M::gemm(A.row_panel(start_row, local_rows), B, local_result.view());
+        send_view<T>(local_result.view(), 0);
     }
+}
 
-    // Собираем результаты на root процессе (ранг 0)
+template <typename T, typename Alloc>
+M::Matrix<T, Alloc> matrix_multiply_mpi(const M::Matrix<T, Alloc>& A, const M::Matrix<T, Alloc>& B,
+                                        int num_procs) {
+    M::Matrix<T, Alloc> result(A.get_rows(), B.get_cols());
+    matrix_multiply_mpi(A.view(), B.view(), result.view(), num_procs);
+    return result;
+}
+
+// Время одного ранга в конвейерном умножении.
+struct PipelineStats {
+    double compute = 0; // в gemm
+    double wait = 0;    // в ожидании обменов (MPI_Wait*), то есть не спрятанная связь
+};
+
+// Оценка перекрытия для одного замера pipeline (худший ранг), строка pipeline_overlap.csv.
+struct OverlapResult {
+    int processes = 0;
+    int size = 0;
+    double compute = 0;
+    double wait = 0;
+    double communication_alone = 0;
+    double hidden = 0;
+};
+
+// Часть c из chunks почти равных частей диапазона [0, count) как (начало, длина); последние могут быть пустыми.
+static std::pair<size_t, size_t> chunk_range(size_t count, size_t chunks, size_t c) {
+    const size_t step = (count + chunks - 1) / chunks;
+    const size_t first = std::min(count, c * step);
+    return {first, std::min(count, first + step) - first};
+}
+
+// Замер попадает и в статистику, и в трассу (если собрано с M_TRACE).
+template <typename F>
+static void timed(double& total, [[maybe_unused]] const char* name, F&& f) {
+    M_TRACE_SCOPE(name);
+    const double start = MPI_Wtime();
+    f();
+    total += MPI_Wtime() - start;
+}
+
+// Конвейерный вариант 1D-умножения. Локальные строки каждого ранга делятся на chunks полос, B — на
+// panels панелей строк. Все приёмы ставятся заранее: Irecv полос A, Ibcast панелей B, а на root —
+// Irecv полос C прямо в result. Полоса считается по панелям B, и перед каждой панелью ждём только её,
+// так что счёт начинается с приходом первой панели. Пока считается полоса r, следующие данные
+// уже идут по сети, а готовая полоса C сразу уходит на root через Isend.
+// С compute = false выполняются только обмены — так измеряется время связи без перекрытия.
+template <typename T>
+PipelineStats matrix_multiply_pipelined(M::ConstMatrixView<T> A, M::ConstMatrixView<T> B, M::MatrixView<T> result,
+                                        MPI_Comm comm, size_t chunks, size_t panels, bool compute = true) {
+    int rank, num_procs;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &num_procs);
+    chunks = std::max<size_t>(chunks, 1);
+    panels = std::max<size_t>(panels, 1);
+    PipelineStats stats;
+
+    unsigned long long dims[3] = {A.get_rows(), A.get_cols(), B.get_cols()};
+    MPI_Bcast(dims, 3, MPI_UNSIGNED_LONG_LONG, 0, comm);
+    const size_t rows = dims[0], inner = dims[1], cols = dims[2];
+
+    std::vector<size_t> counts(num_procs), displs(num_procs);
+    for (size_t r = 0, first = 0; r < static_cast<size_t>(num_procs); ++r) {
+        counts[r] = rows / num_procs + (r < rows % num_procs ? 1 : 0);
+        displs[r] = first;
+        first += counts[r];
+    }
+    const size_t local_rows = counts[rank];
+
+    std::vector<MPI_Request> a_requests(chunks, MPI_REQUEST_NULL);
+    std::vector<MPI_Request> b_requests(panels, MPI_REQUEST_NULL);
+    std::vector<MPI_Request> c_requests;
+
+    // Панели B.
+    M::Matrix<T> local_b{};
+    M::ConstMatrixView<T> b = B;
+    if (rank != 0) {
+        local_b = M::Matrix<T>(inner, cols);
+        b = local_b.view();
+    }
+    MPI_Datatype b_row = row_type<T>(cols, b.get_ld());
+    for (size_t p = 0; p < panels; ++p) {
+        const auto [first, count] = chunk_range(inner, panels, p);
+        MPI_Ibcast(const_cast<T*>(b.row(first)), static_cast<int>(count), b_row, 0, comm, &b_requests[p]);
+    }
+
+    // Полосы A и C.
+    M::Matrix<T> local_a{}, local_c{};
+    MPI_Datatype a_row = row_type<T>(inner, rank == 0 ? A.get_ld() : inner);
+    MPI_Datatype c_row = row_type<T>(cols, rank == 0 ? result.get_ld() : cols);
     if (rank == 0) {
-        for (size_t i = start_row; i < end_row; ++i) {
-            for (size_t j = 0; j < cols; ++j) {
-                result(i, j) = local_result(i - start_row, j);
+        for (int r = 1; r < num_procs; ++r) {
+            for (size_t c = 0; c < chunks; ++c) {
+                const auto [first, count] = chunk_range(counts[r], chunks, c);
+                if (count == 0) continue;
+                MPI_Request request;
+                MPI_Isend(A.row(displs[r] + first), static_cast<int>(count), a_row, r, static_cast<int>(c), comm,
+                          &request);
+                c_requests.push_back(request);
+                MPI_Irecv(result.row(displs[r] + first), static_cast<int>(count), c_row, r, static_cast<int>(c), comm,
+                          &request);
+                c_requests.push_back(request);
             }
         }
+    } else {
+        local_a = M::Matrix<T>(local_rows, inner);
+        local_c = M::Matrix<T>(local_rows, cols);
+        for (size_t c = 0; c < chunks; ++c) {
+            const auto [first, count] = chunk_range(local_rows, chunks, c);
+            if (count == 0) continue;
+            MPI_Irecv(local_a.view().row(first), static_cast<int>(count), a_row, 0, static_cast<int>(c), comm,
+                      &a_requests[c]);
+        }
+    }
 
-        for (int src = 1; src < num_procs; ++src) {
-            const size_t src_start = src * rows_per_process + std::min(src,
-                static_cast<int>(remainder));
-            const size_t src_end = src_start + rows_per_process + (src < remainder ? 1 : 0);
-            const size_t src_rows = src_end - src_start;
-
-            std::vector<T> recv_buffer(src_rows * cols);
-            MPI_Recv(recv_buffer.data(), src_rows * cols, MPI_INT, src, 0,
-                    MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-
-            for (size_t i = 0; i < src_rows; ++i) {
-                for (size_t j = 0; j < cols; ++j) {
-                    result(src_start + i, j) = recv_buffer[i * cols + j];
+    const M::ConstMatrixView<T> a = rank == 0 ? A.row_panel(0, local_rows) : local_a.view();
+    const M::MatrixView<T> out = rank == 0 ? result.row_panel(0, local_rows) : local_c.view();
+    for (size_t i = 0; i < local_rows; ++i) {
+        std::fill(out.row(i), out.row(i) + cols, T{});
+    }
+
+    for (size_t c = 0; c < chunks; ++c) {
+        size_t first, count;
+        std::tie(first, count) = chunk_range(local_rows, chunks, c);
+        timed(stats.wait, "wait A chunk", [&] { MPI_Wait(&a_requests[c], MPI_STATUS_IGNORE); });
+        if (count != 0 && compute) {
+            const M::ConstMatrixView<T> a_chunk = a.row_panel(first, count);
+            const M::MatrixView<T> c_chunk = out.row_panel(first, count);
+            for (size_t p = 0; p < panels; ++p) {
+                size_t k0, kp;
+                std::tie(k0, kp) = chunk_range(inner, panels, p);
+                timed(stats.wait, "wait B panel", [&] { MPI_Wait(&b_requests[p], MPI_STATUS_IGNORE); });
+                timed(stats.compute, "gemm panel", [&] { M::gemm(a_chunk.block(0, k0, count, kp), b.row_panel(k0, kp), c_chunk); });
+                // Даём библиотеке MPI продвинуть отложенные обмены.
+                int flag;
+                if (!c_requests.empty()) {
+                    MPI_Testall(static_cast<int>(c_requests.size()), c_requests.data(), &flag, MPI_STATUSES_IGNORE);
                 }
             }
         }
-    } else {
-        std::vector<T> send_buffer(local_result.get_rows() * local_result.get_cols());
-        for (size_t i = 0; i < local_result.get_rows(); ++i) {
-            for (size_t j = 0; j < local_result.get_cols(); ++j) {
-                send_buffer[i * local_result.get_cols() + j] = local_result(i, j);
-            }
+        if (rank != 0 && count != 0) {
+            MPI_Request request;
+            MPI_Isend(out.row(first), static_cast<int>(count), c_row, 0, static_cast<int>(c), comm, &request);
+            c_requests.push_back(request);
         }
-        MPI_Send(send_buffer.data(), send_buffer.size(), MPI_INT, 0, 0, MPI_COMM_WORLD);
     }
 
-    return result;
+    timed(stats.wait, "wait all", [&] {
+        MPI_Waitall(static_cast<int>(b_requests.size()), b_requests.data(), MPI_STATUSES_IGNORE);
+        MPI_Waitall(static_cast<int>(c_requests.size()), c_requests.data(), MPI_STATUSES_IGNORE);
+    });
+
+    MPI_Type_free(&a_row);
+    MPI_Type_free(&b_row);
+    MPI_Type_free(&c_row);
+    return stats;
 }
 
 void write_csv_results(const std::vector<int>& sizes,
@@ -134,12 +302,64 @@ void write_csv_results(const std::vector<int>& sizes,
     }
 }
 
+// Длинный формат — строка на замер, чтобы statistic.py мог строить долю спрятанной связи.
+void write_overlap_results(const std::vector<OverlapResult>& overlaps) {
+    std::ofstream file("pipeline_overlap.csv");
+    if (!file.is_open()) {
+        std::cerr << "Couldn't open pipeline_overlap.csv for writing" << std::endl;
+        return;
+    }
+
+    file << "Processes,Size,Compute,Waiting,CommunicationAlone,Hidden,HiddenPct\n";
+    for (const OverlapResult& r : overlaps) {
+        file << r.processes << "," << r.size << "," << std::setprecision(6) << r.compute << "," << r.wait << ","
+             << r.communication_alone << "," << r.hidden << ","
+             << (r.communication_alone > 0 ? 100.0 * r.hidden / r.communication_alone : 0.0) << "\n";
+    }
+}
+
 int main(int argc, char** argv) {
     MPI_Init(&argc, &argv);
 
+    // p2p — точечная отправка полос на ранг 0, scatter — Scatterv/Bcast/Gatherv,
+    // summa — блочно-циклическое 2D-распределение и SUMMA, pipeline — scatter с перекрытием
+    // обменов и счёта (--chunks полос строк, --panels панелей B).
+    // --verify — проверка результата по Фрейвалдсу вместо записи A.txt, B.txt и result.txt.
+    enum class Mode { P2P, Scatter, Summa, Pipeline };
+    Mode mode = Mode::Scatter;
+    size_t block = M::DistMatrix<int>::DEFAULT_BLOCK;
+    size_t chunks = 4, panels = 4;
+    std::string trace_file;
+    bool verify = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--mode" && i + 1 < argc) {
+            const std::string name = argv[++i];
+            mode = name == "p2p" ? Mode::P2P
+                 : name == "summa" ? Mode::Summa
+                 : name == "pipeline" ? Mode::Pipeline
+                 : Mode::Scatter;
+        } else if (arg == "--block" && i + 1 < argc) {
+            block = std::stoul(argv[++i]);
+        } else if (arg == "--chunks" && i + 1 < argc) {
+            chunks = std::stoul(argv[++i]);
+        } else if (arg == "--panels" && i + 1 < argc) {
+            panels = std::stoul(argv[++i]);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_file = argv[++i];
+        } else if (arg == "--verify") {
+            verify = true;
+        }
+    }
+
     int rank, world_size;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+    // Часы всех рангов приводятся к рангу 0, чтобы дорожки в трассе совпадали по времени.
+    // Это коллективный обмен, поэтому без --trace он не делается.
+    if (!trace_file.empty()) {
+        M::trace_sync_clock(MPI_COMM_WORLD);
+    }
 
     const std::vector<int> SIZES = {100, 200, 300, 400, 500, 1000, 2000};
     std::vector<int> PROC_COUNTS;
@@ -154,6 +374,7 @@ int main(int argc, char** argv) {
 
     std::vector<std::vector<double>> results(PROC_COUNTS.size(),
                                           std::vector<double>(SIZES.size()));
+    std::vector<OverlapResult> overlaps;
 
     if (rank == 0) {
         chdir(R"(C:\Users\user\Desktop\ALL\University\3 cours\6 semester\PP\Labs\Lab3)");
@@ -167,57 +388,139 @@ int main(int argc, char** argv) {
     for (size_t size_idx = 0; size_idx < SIZES.size(); size_idx++) {
         int current_size = SIZES[size_idx];
 
+        // Генератор счётный: в режиме p2p каждый ранг строит те же A и B сам, в режиме summa —
+        // только свои блоки. В режиме scatter данные есть только на ранге 0.
         M::Matrix<int> A{}, B{};
-        if (rank == 0) {
-            std::cout << "Processing size: " << current_size << "x" << current_size << std::endl;
+        if (rank == 0 || mode == Mode::P2P) {
             A = M::Matrix<int>(current_size, current_size);
             B = M::Matrix<int>(current_size, current_size);
-            A.fill_random(0, 100);
-            B.fill_random(0, 100);
-            std::string dir_name = std::to_string(SIZES[size_idx]);
-            chdir(dir_name);
-            A.write_to_file("A.txt");
-            B.write_to_file("B.txt");
+            A.fill_random(0, 100, SEED);
+            B.fill_random(0, 100, SEED + 1);
         }
-
-        // Рассылаем размер матрицы всем процессам
-        MPI_Bcast(&current_size, 1, MPI_INT, 0, MPI_COMM_WORLD);
-
-        // Выделяем память и рассылаем данные матриц
-        if (rank != 0) {
-            A = M::Matrix<int>(current_size, current_size);
-            B = M::Matrix<int>(current_size, current_size);
+        if (rank == 0) {
+            std::cout << "Processing size: " << current_size << "x" << current_size << std::endl;
+            if (!verify) {
+                std::string dir_name = std::to_string(SIZES[size_idx]);
+                chdir(dir_name);
+                A.write_to_file("A.txt");
+                B.write_to_file("B.txt");
+            }
         }
 
-        MPI_Bcast(A.get_data(), current_size * current_size, MPI_INT, 0, MPI_COMM_WORLD);
-        MPI_Bcast(B.get_data(), current_size * current_size, MPI_INT, 0, MPI_COMM_WORLD);
-        M::Matrix<int> result(current_size, current_size);
+        M::Matrix<int> result{};
+        if (rank == 0 || mode == Mode::P2P) {
+            result = M::Matrix<int>(current_size, current_size);
+        }
         for (size_t proc_idx = 0; proc_idx < PROC_COUNTS.size(); proc_idx++) {
             int num_procs = PROC_COUNTS[proc_idx];
 
+            // Коллективные операции идут только среди первых num_procs рангов.
+            MPI_Comm comm;
+            MPI_Comm_split(MPI_COMM_WORLD, rank < num_procs ? 0 : MPI_UNDEFINED, rank, &comm);
+
+            // Для summa входные блоки генерируются до замера, каждым рангом свои.
+            std::optional<M::ProcessGrid> grid;
+            std::optional<M::DistMatrix<int>> dA, dB, dC;
+            if (mode == Mode::Summa && rank < num_procs) {
+                grid.emplace(comm);
+                dA.emplace(*grid, current_size, current_size, block);
+                dB.emplace(*grid, current_size, current_size, block);
+                dC.emplace(*grid, current_size, current_size, block);
+                dA->fill_random(0, 100, SEED);
+                dB->fill_random(0, 100, SEED + 1);
+            }
+
             MPI_Barrier(MPI_COMM_WORLD);
             double start_time = MPI_Wtime();
 
+            PipelineStats stats;
             if (rank < num_procs) {
-                result = matrix_multiply_mpi(A, B, num_procs);
+                if (mode == Mode::Summa) {
+                    M::summa(*dA, *dB, *dC);
+                } else if (mode == Mode::Pipeline) {
+                    stats = matrix_multiply_pipelined<int>(A.view(), B.view(), result.view(), comm, chunks, panels);
+                } else if (mode == Mode::Scatter) {
+                    M::scatter_multiply<int>(A.view(), B.view(), result.view(), comm);
+                } else {
+                    result = matrix_multiply_mpi(A, B, num_procs);
+                }
             }
 
             MPI_Barrier(MPI_COMM_WORLD);
             double end_time = MPI_Wtime();
 
+            // Сколько связи спрятано за счётом: те же обмены без счёта дают время связи без перекрытия,
+            // из него вычитается время, которое ранг всё же простоял в ожидании. Берётся худший ранг.
+            if (mode == Mode::Pipeline && rank < num_procs) {
+                M::Matrix<int> scratch{};
+                if (rank == 0) {
+                    scratch = M::Matrix<int>(current_size, current_size);
+                }
+                MPI_Barrier(comm);
+                const double comm_start = MPI_Wtime();
+                matrix_multiply_pipelined<int>(A.view(), B.view(), scratch.view(), comm, chunks, panels, false);
+                const double comm_alone = MPI_Wtime() - comm_start;
+
+                double local[3] = {comm_alone, stats.wait, stats.compute}, worst[3];
+                MPI_Reduce(local, worst, 3, MPI_DOUBLE, MPI_MAX, 0, comm);
+                if (rank == 0) {
+                    const double hidden = std::max(0.0, worst[0] - worst[1]);
+                    overlaps.push_back({num_procs, current_size, worst[2], worst[1], worst[0], hidden});
+                    std::cout << "    Pipeline: compute " << worst[2] << " s, waiting " << worst[1]
+                              << " s, communication alone " << worst[0] << " s, hidden " << hidden << " s ("
+                              << (worst[0] > 0 ? 100.0 * hidden / worst[0] : 0.0) << "%)" << std::endl;
+                }
+            }
+
+            // Проверка не входит в замер: summa проверяется на распределённых блоках,
+            // остальные режимы — на ранге 0, где собран результат.
+            std::optional<M::VerifyResult> check;
+            if (verify && dC) {
+                check = M::freivalds_verify(*dA, *dB, *dC);
+            } else if (verify && rank == 0) {
+                check = M::freivalds_verify(A, B, result);
+            }
+
+            // Сборка на ранг 0 только для result.txt, в замер не входит.
+            if (dC && !verify) {
+                M::Matrix<int> gathered = dC->gather();
+                if (rank == 0) {
+                    result = std::move(gathered);
+                }
+            }
+
+            if (comm != MPI_COMM_NULL) {
+                MPI_Comm_free(&comm);
+            }
+
             if (rank == 0) {
                 double time = (end_time - start_time);
                 results[proc_idx][size_idx] = time;
                 std::cout << "  Processes: " << num_procs << " Time: " << time << " ms" << std::endl;
+                if (check) {
+                    if (check->passed) {
+                        std::cout << "    Verified in " << check->seconds << " s" << std::endl;
+                    } else {
+                        std::cout << "    VERIFICATION FAILED at row " << check->bad_row << std::endl;
+                    }
+                }
             }
         }
-        result.write_to_file("result.txt");
-        chdir("..");
+        if (rank == 0 && !verify) {
+            result.write_to_file("result.txt");
+            chdir("..");
+        }
     }
 
 
     if (rank == 0) {
         write_csv_results(SIZES, PROC_COUNTS, results);
+        if (mode == Mode::Pipeline) {
+            write_overlap_results(overlaps);
+        }
+    }
+    if (!trace_file.empty()) {
+        M::write_trace(trace_file, MPI_COMM_WORLD);
     }
 
     MPI_Finalize();
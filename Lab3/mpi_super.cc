@@ -1,10 +1,11 @@
 #include <mpi.h>
 #include <iostream>
 #include <vector>
-#include <cstdlib>
-#include <ctime>
 #include <algorithm>
 
+#include "../include/gemm.h"
+#include "../include/random_generator.h"
+
 class Matrix {
 private:
     std::vector<int> data;
@@ -15,10 +16,14 @@ public:
         data.resize(rows * cols);
     }
 
-    void fill_random(int min_val, int max_val) {
-        for (size_t i = 0; i < rows * cols; ++i) {
-            data[i] = min_val + rand() % (max_val - min_val + 1);
-        }
+    // Заполняются только строки [first_row, first_row + count), значения не зависят от разбиения.
+    void fill_random(int min_val, int max_val, uint64_t seed, size_t first_row, size_t count) {
+        RandomGenerator::fill_block(data.data() + first_row * cols, cols, first_row, 0, count, cols,
+                                    min_val, max_val, seed);
+    }
+
+    void fill_random(int min_val, int max_val, uint64_t seed) {
+        fill_random(min_val, max_val, seed, 0, rows);
     }
 
     int& operator()(size_t i, size_t j) { return data[i * cols + j]; }
@@ -27,6 +32,7 @@ public:
     size_t get_rows() const { return rows; }
     size_t get_cols() const { return cols; }
     int* get_data() { return data.data(); }
+    const int* get_data() const { return data.data(); }
 
     void print_part() const {
         const size_t print_size = std::min(size_t(5), rows);
@@ -39,39 +45,51 @@ public:
     }
 };
 
-void matrix_multiply_mpi(const Matrix& A, const Matrix& B, Matrix& C, int rank, int num_procs) {
+// Свои строки считаются полосами по CHUNK_ROWS: готовая полоса сразу уходит на ранг 0 через Isend,
+// пока считается следующая. Ранг 0 заранее ставит Irecv на все чужие полосы прямо в C
+// и считает свои строки, пока они приходят. Возвращает время, проведённое в ожидании обменов.
+double matrix_multiply_mpi(const Matrix& A, const Matrix& B, Matrix& C, int rank, int num_procs) {
+    const size_t CHUNK_ROWS = 64;
     const size_t rows = A.get_rows();
     const size_t cols = B.get_cols();
     const size_t inner_dim = A.get_cols();
 
     const size_t rows_per_proc = rows / num_procs;
     const size_t remainder = rows % num_procs;
+    auto first_row = [&](int r) { return r * rows_per_proc + std::min<size_t>(r, remainder); };
+    auto row_count = [&](int r) { return rows_per_proc + (r < static_cast<int>(remainder) ? 1 : 0); };
 
-    size_t start_row = rank * rows_per_proc + std::min<size_t>(rank, remainder);
-    size_t end_row = start_row + rows_per_proc + (rank < static_cast<int>(remainder) ? 1 : 0);
-
-    for (size_t i = start_row; i < end_row; ++i) {
-        for (size_t j = 0; j < cols; ++j) {
-            int sum = 0;
-            for (size_t k = 0; k < inner_dim; ++k) {
-                sum += A(i, k) * B(k, j);
+    std::vector<MPI_Request> requests;
+    if (rank == 0) {
+        for (int src = 1; src < num_procs; ++src) {
+            for (size_t i = 0; i < row_count(src); i += CHUNK_ROWS) {
+                const size_t chunk = std::min(CHUNK_ROWS, row_count(src) - i);
+                requests.emplace_back();
+                MPI_Irecv(&C(first_row(src) + i, 0), chunk * cols, MPI_INT, src, 0,
+                          MPI_COMM_WORLD, &requests.back());
             }
-            C(i, j) = sum;
         }
     }
 
-    if (rank == 0) {
-        for (int src = 1; src < num_procs; ++src) {
-            size_t src_start = src * rows_per_proc + std::min<size_t>(src, remainder);
-            size_t src_end = src_start + rows_per_proc + (src < static_cast<int>(remainder) ? 1 : 0);
-            size_t src_rows = src_end - src_start;
-
-            MPI_Recv(&C(src_start, 0), src_rows * cols, MPI_INT, src, 0,
-                    MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    const size_t start_row = first_row(rank);
+    for (size_t i = 0; i < row_count(rank); i += CHUNK_ROWS) {
+        const size_t chunk = std::min(CHUNK_ROWS, row_count(rank) - i);
+        M::gemm(chunk, cols, inner_dim,
+                A.get_data() + (start_row + i) * inner_dim, inner_dim,
+                B.get_data(), cols,
+                &C(start_row + i, 0), cols);
+        if (rank != 0) {
+            requests.emplace_back();
+            MPI_Isend(&C(start_row + i, 0), chunk * cols, MPI_INT, 0, 0, MPI_COMM_WORLD, &requests.back());
         }
-    } else {
-        MPI_Send(&C(start_row, 0), (end_row - start_row) * cols, MPI_INT, 0, 0, MPI_COMM_WORLD);
+        // Даём библиотеке MPI продвинуть уже отправленные полосы.
+        int flag;
+        MPI_Testall(static_cast<int>(requests.size()), requests.data(), &flag, MPI_STATUSES_IGNORE);
     }
+
+    const double wait_start = MPI_Wtime();
+    MPI_Waitall(static_cast<int>(requests.size()), requests.data(), MPI_STATUSES_IGNORE);
+    return MPI_Wtime() - wait_start;
 }
 
 int main(int argc, char** argv) {
@@ -84,6 +102,7 @@ int main(int argc, char** argv) {
     const std::vector<size_t> SIZES = {100, 200, 300, 400, 500, 1000, 2000};
     const int MIN_VAL = 0;
     const int MAX_VAL = 1000;
+    const uint64_t SEED = 42;
 
     if (rank == 0) {
         std::cout << "Running with " << num_procs << " processes" << std::endl;
@@ -94,23 +113,25 @@ int main(int argc, char** argv) {
         Matrix B(size, size);
         Matrix C(size, size);
 
-        if (rank == 0) {
-            std::srand(static_cast<unsigned>(std::time(nullptr)));
-            A.fill_random(MIN_VAL, MAX_VAL);
-            B.fill_random(MIN_VAL, MAX_VAL);
-        }
-
-        MPI_Bcast(A.get_data(), size * size, MPI_INT, 0, MPI_COMM_WORLD);
-        MPI_Bcast(B.get_data(), size * size, MPI_INT, 0, MPI_COMM_WORLD);
+        // Каждый ранг строит свою полосу A и всю B сам, без рассылки с ранга 0.
+        const size_t rows_per_proc = size / num_procs;
+        const size_t remainder = size % num_procs;
+        const size_t start_row = rank * rows_per_proc + std::min<size_t>(rank, remainder);
+        const size_t local_rows = rows_per_proc + (rank < static_cast<int>(remainder) ? 1 : 0);
+        A.fill_random(MIN_VAL, MAX_VAL, SEED, start_row, local_rows);
+        B.fill_random(MIN_VAL, MAX_VAL, SEED + 1);
 
         double start_time = MPI_Wtime();
-        matrix_multiply_mpi(A, B, C, rank, num_procs);
+        const double wait = matrix_multiply_mpi(A, B, C, rank, num_procs);
         double end_time = MPI_Wtime();
 
+        double max_wait;
+        MPI_Reduce(&wait, &max_wait, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
         if (rank == 0) {
             double time_ms = (end_time - start_time);
             std::cout << "Size " << size << "x" << size
-                      << " Time: " << time_ms << "s" << std::endl;
+                      << " Time: " << time_ms << "s"
+                      << " Waiting for transfers: " << max_wait << "s" << std::endl;
 
             if (size <= 5) {
                 std::cout << "Matrix A (first 5x5):" << std::endl;
@@ -1,3 +1,5 @@
+import os
+
 import numpy as np
 import matplotlib.pyplot as plt
 import pandas as pd
@@ -45,9 +47,51 @@ def plot_results(csv_path):
     plt.show()
 
 
+def plot_hybrid_results(csv_path):
+    # Гибридный замер: первые два столбца — ранги и потоки, остальные — размеры
+    df = pd.read_csv(csv_path)
+    sizes = [int(col) for col in df.columns[2:]]
+
+    plt.figure(figsize=(10, 6))
+    for _, row in df.iterrows():
+        times = row.iloc[2:].values
+        plt.plot(sizes, times, marker='o', label=f"{int(row['Ranks'])} ranks x {int(row['Threads'])} threads")
+
+    plt.xlabel('Size')
+    plt.ylabel('Time (s)')
+    plt.title('Гибридный MPI + OpenMP')
+    plt.grid(True)
+    plt.legend()
+    plt.savefig('stat_hybrid.png', dpi=300, bbox_inches='tight')
+    plt.show()
+
+
+def plot_overlap_results(csv_path):
+    # Режим pipeline: доля времени связи, спрятанная за счётом, по размерам для каждого числа процессов
+    df = pd.read_csv(csv_path)
+
+    plt.figure(figsize=(10, 6))
+    for processes, group in df.groupby("Processes"):
+        group = group.sort_values("Size")
+        plt.plot(group["Size"], group["HiddenPct"], marker='o', label=f'{processes} processes')
+
+    plt.xlabel('Size')
+    plt.ylabel('Hidden communication (%)')
+    plt.title('Перекрытие обменов и счёта')
+    plt.grid(True)
+    plt.legend()
+    plt.savefig('stat_overlap.png', dpi=300, bbox_inches='tight')
+    plt.show()
+
 
 def main():
     plot_results("result\statistic.csv")
+    hybrid_csv = os.path.join("result", "hybrid.csv")
+    if os.path.exists(hybrid_csv):
+        plot_hybrid_results(hybrid_csv)
+    overlap_csv = os.path.join("result", "pipeline_overlap.csv")
+    if os.path.exists(overlap_csv):
+        plot_overlap_results(overlap_csv)
     write_compare_res("compare_result.txt")
 
 
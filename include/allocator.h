@@ -0,0 +1,199 @@
+#ifndef ALLOCATOR_H
+#define ALLOCATOR_H
+
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace M
+{
+	constexpr size_t CACHE_LINE = 64;
+	constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+
+	namespace detail
+	{
+		inline void* aligned_allocate(size_t bytes, size_t alignment)
+		{
+			return ::operator new(bytes, std::align_val_t{alignment});
+		}
+
+		inline void aligned_deallocate(void* ptr, size_t alignment) noexcept
+		{
+			::operator delete(ptr, std::align_val_t{alignment});
+		}
+
+		// Большие буферы выравниваются на границу huge page и помечаются для THP,
+		// маленькие — просто на кэш-линию.
+		inline size_t huge_alignment(size_t bytes) noexcept
+		{
+			return bytes >= HUGE_PAGE ? HUGE_PAGE : CACHE_LINE;
+		}
+
+		inline void* huge_allocate(size_t bytes)
+		{
+			const size_t alignment = huge_alignment(bytes);
+			void* ptr = aligned_allocate(bytes, alignment);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+			if (alignment == HUGE_PAGE) {
+				madvise(ptr, bytes / HUGE_PAGE * HUGE_PAGE, MADV_HUGEPAGE);
+			}
+#endif
+			return ptr;
+		}
+
+		inline void huge_deallocate(void* ptr, size_t bytes) noexcept
+		{
+			aligned_deallocate(ptr, huge_alignment(bytes));
+		}
+
+		// Общий для всех типов пул освобождённых блоков, ключ — размер в байтах.
+		class BlockPool
+		{
+		public:
+			// Пул не уничтожается при выходе: матрицы со статическим временем жизни
+			// могут вернуть в него блоки уже после завершения main.
+			static BlockPool& instance()
+			{
+				static BlockPool* pool = new BlockPool;
+				return *pool;
+			}
+
+			void* acquire(size_t bytes)
+			{
+				{
+					std::lock_guard<std::mutex> lock{_mutex};
+					auto it = _free.find(bytes);
+					if (it != _free.end()) {
+						void* ptr = it->second;
+						_free.erase(it);
+						return ptr;
+					}
+				}
+				return huge_allocate(bytes);
+			}
+
+			// Вызывается из noexcept deallocate: если узел multimap не выделился, блок сразу уходит системе.
+			void release(void* ptr, size_t bytes) noexcept
+			{
+				try {
+					std::lock_guard<std::mutex> lock{_mutex};
+					_free.emplace(bytes, ptr);
+				}
+				catch (...) {
+					huge_deallocate(ptr, bytes);
+				}
+			}
+
+			void trim() noexcept
+			{
+				std::lock_guard<std::mutex> lock{_mutex};
+				for (const auto& [bytes, ptr] : _free) {
+					huge_deallocate(ptr, bytes);
+				}
+				_free.clear();
+			}
+
+		private:
+			BlockPool() = default;
+
+			std::mutex _mutex;
+			std::multimap<size_t, void*> _free;
+		};
+	}
+
+	// Память, выровненная на Alignment байт (по умолчанию — кэш-линия, подходит для AVX-512).
+	template <typename T, size_t Alignment = CACHE_LINE>
+	struct AlignedAllocator
+	{
+		using value_type = T;
+
+		template <typename U>
+		struct rebind
+		{
+			using other = AlignedAllocator<U, Alignment>;
+		};
+
+		AlignedAllocator() noexcept = default;
+		template <typename U>
+		AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept { }
+
+		T* allocate(size_t n)
+		{
+			return static_cast<T*>(detail::aligned_allocate(n * sizeof(T), Alignment));
+		}
+
+		void deallocate(T* ptr, size_t) noexcept
+		{
+			detail::aligned_deallocate(ptr, Alignment);
+		}
+	};
+
+	// Буферы от 2 МБ выравниваются на huge page и получают madvise(MADV_HUGEPAGE).
+	template <typename T>
+	struct HugePageAllocator
+	{
+		using value_type = T;
+
+		HugePageAllocator() noexcept = default;
+		template <typename U>
+		HugePageAllocator(const HugePageAllocator<U>&) noexcept { }
+
+		T* allocate(size_t n)
+		{
+			return static_cast<T*>(detail::huge_allocate(n * sizeof(T)));
+		}
+
+		void deallocate(T* ptr, size_t n) noexcept
+		{
+			detail::huge_deallocate(ptr, n * sizeof(T));
+		}
+	};
+
+	// Освобождённые блоки остаются в пуле и отдаются следующему запросу того же размера,
+	// поэтому повторные прогоны на одном размере не обращаются к системному аллокатору.
+	// Блоки берутся так же, как у HugePageAllocator. PoolAllocator<T>::trim() возвращает память системе.
+	template <typename T>
+	struct PoolAllocator
+	{
+		using value_type = T;
+
+		PoolAllocator() noexcept = default;
+		template <typename U>
+		PoolAllocator(const PoolAllocator<U>&) noexcept { }
+
+		T* allocate(size_t n)
+		{
+			return static_cast<T*>(detail::BlockPool::instance().acquire(n * sizeof(T)));
+		}
+
+		void deallocate(T* ptr, size_t n) noexcept
+		{
+			detail::BlockPool::instance().release(ptr, n * sizeof(T));
+		}
+
+		static void trim() noexcept
+		{
+			detail::BlockPool::instance().trim();
+		}
+	};
+
+	template <typename T, typename U, size_t A>
+	bool operator==(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) noexcept { return true; }
+	template <typename T, typename U, size_t A>
+	bool operator!=(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) noexcept { return false; }
+	template <typename T, typename U>
+	bool operator==(const HugePageAllocator<T>&, const HugePageAllocator<U>&) noexcept { return true; }
+	template <typename T, typename U>
+	bool operator!=(const HugePageAllocator<T>&, const HugePageAllocator<U>&) noexcept { return false; }
+	template <typename T, typename U>
+	bool operator==(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return true; }
+	template <typename T, typename U>
+	bool operator!=(const PoolAllocator<T>&, const PoolAllocator<U>&) noexcept { return false; }
+}
+
+#endif // ALLOCATOR_H
@@ -0,0 +1,195 @@
+#ifndef AUTOTUNE_H
+#define AUTOTUNE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "matrix.h"
+#include "omp_gemm.h"
+#include "strassen.h"
+#include "tuning.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace M
+{
+	struct TuneOptions
+	{
+		int max_threads = 0;         // 0 — omp_get_max_threads()
+		double budget_seconds = 10;  // на один размер, вместе со Штрассеном
+		int repeats = 3;             // берётся лучший прогон
+	};
+
+	// Покоординатный спуск на квадратной задаче size x size: число потоков, затем разбиение
+	// и расписание, затем размеры плиток и chunk. Каждый шаг оставляет лучший вариант
+	// и не откатывает предыдущие. Четверть бюджета уходит на порог Штрассена.
+	// Результат не сохраняется: его кладут в TuningCache вызывающий код.
+	template <typename T>
+	TunedParams autotune(size_t size, const TuneOptions& options = {});
+
+	namespace detail
+	{
+		class TuneBudget
+		{
+		public:
+			explicit TuneBudget(double seconds) :
+				_deadline{std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+					std::chrono::duration<double>(seconds))}
+			{ }
+
+			bool exhausted() const
+			{
+				return std::chrono::steady_clock::now() >= _deadline;
+			}
+
+		private:
+			std::chrono::steady_clock::time_point _deadline;
+		};
+
+		// Лучшее время из repeats прогонов f; C обнуляется перед каждым, как в бенчмарке.
+		template <typename T, typename F>
+		double best_time(Matrix<T>& c, int repeats, F&& f)
+		{
+			double best = 0;
+			for (int rep = 0; rep < std::max(repeats, 1); ++rep) {
+				std::fill(c.get_data(), c.get_data() + c.get_rows() * c.get_cols(), T{});
+				const auto start = std::chrono::steady_clock::now();
+				f();
+				const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+				if (rep == 0 || seconds < best) {
+					best = seconds;
+				}
+			}
+			return best;
+		}
+
+		inline std::vector<int> thread_candidates(int max_threads)
+		{
+			std::vector<int> counts;
+			for (int n = 1; n <= max_threads; n *= 2) {
+				counts.push_back(n);
+			}
+			if (counts.back() != max_threads) {
+				counts.push_back(max_threads);
+			}
+			return counts;
+		}
+	}
+}
+
+template <typename T>
+M::TunedParams M::autotune(size_t size, const TuneOptions& options)
+{
+	using Clock = std::chrono::steady_clock;
+
+	if (size == 0) {
+		throw std::invalid_argument{"[autotune]Size must be positive."};
+	}
+	int max_threads = options.max_threads;
+	if (max_threads <= 0) {
+#ifdef _OPENMP
+		max_threads = omp_get_max_threads();
+#else
+		max_threads = 1;
+#endif
+	}
+
+	Matrix<T> a(size, size), b(size, size), c(size, size);
+	a.fill_random(T(0), T(100), 42, max_threads);
+	b.fill_random(T(0), T(100), 43, max_threads);
+	const double flops = 2.0 * static_cast<double>(size) * size * size;
+
+	const auto tune_start = Clock::now();
+	const detail::TuneBudget gemm_budget(options.budget_seconds * 0.75);
+
+	TunedParams best;
+	best.threads = max_threads;
+	double best_time = 0;
+	const auto measure = [&](int threads, const OmpGemmConfig& config) {
+		return detail::best_time(c, options.repeats, [&] {
+			omp_gemm(a.view(), b.view(), c.view(), threads, config);
+		});
+	};
+	// Кандидат принимается, только если он быстрее текущего лучшего.
+	const auto try_candidate = [&](int threads, const OmpGemmConfig& config) {
+		if (gemm_budget.exhausted()) {
+			return;
+		}
+		const double time = measure(threads, config);
+		if (time < best_time) {
+			best_time = time;
+			best.threads = threads;
+			best.omp = config;
+		}
+	};
+
+	best_time = measure(best.threads, best.omp);
+	for (int threads : detail::thread_candidates(max_threads)) {
+		try_candidate(threads, best.omp);
+	}
+
+	for (OmpDecomposition decomposition : {OmpDecomposition::Tiles, OmpDecomposition::Rows, OmpDecomposition::TaskLoop}) {
+		for (OmpSchedule schedule : {OmpSchedule::Static, OmpSchedule::Dynamic, OmpSchedule::Guided}) {
+			// Для taskloop расписание не используется, достаточно одного варианта.
+			if (decomposition == OmpDecomposition::TaskLoop && schedule != OmpSchedule::Static) {
+				continue;
+			}
+			OmpGemmConfig config = best.omp;
+			config.decomposition = decomposition;
+			config.schedule = schedule;
+			try_candidate(best.threads, config);
+		}
+	}
+
+	for (size_t tile_m : {32, 64, 128, 256, 512}) {
+		if (tile_m > size) {
+			break;
+		}
+		OmpGemmConfig config = best.omp;
+		config.tile_m = tile_m;
+		try_candidate(best.threads, config);
+	}
+	if (best.omp.decomposition != OmpDecomposition::Rows) {
+		for (size_t tile_n : {64, 128, 256, 512, 1024}) {
+			if (tile_n > size) {
+				break;
+			}
+			OmpGemmConfig config = best.omp;
+			config.tile_n = tile_n;
+			try_candidate(best.threads, config);
+		}
+	}
+	for (int chunk : {1, 2, 4, 8}) {
+		OmpGemmConfig config = best.omp;
+		config.chunk = chunk;
+		try_candidate(best.threads, config);
+	}
+	best.gflops = flops / best_time * 1e-9;
+
+	// Порог Штрассена подбирается на лучшем числе потоков; остаток бюджета считается от начала подбора.
+	const double spent = std::chrono::duration<double>(Clock::now() - tune_start).count();
+	const detail::TuneBudget strassen_budget(std::max(options.budget_seconds - spent, options.budget_seconds * 0.25));
+	double best_strassen = 0;
+	for (size_t cutoff : {64, 128, 256, 512, 1024}) {
+		if (cutoff >= size || strassen_budget.exhausted()) {
+			break;
+		}
+		const double time = detail::best_time(c, options.repeats, [&] {
+#pragma omp parallel num_threads(best.threads) if(best.threads > 1)
+#pragma omp single
+			strassen_gemm(a.view(), b.view(), c.view(), cutoff);
+		});
+		if (best.strassen_cutoff == 0 || time < best_strassen) {
+			best_strassen = time;
+			best.strassen_cutoff = cutoff;
+		}
+	}
+	return best;
+}
+
+#endif // AUTOTUNE_H
@@ -0,0 +1,326 @@
+#ifndef BATCHED_GEMM_H
+#define BATCHED_GEMM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "allocator.h"
+#include "fixed_matrix.h"
+#include "simd_kernels.h"
+#include "trace.h"
+
+namespace M
+{
+	// Набор из count матриц R x C, переплетённых по LANES штук (AoSoA): в блоке сначала идут
+	// элементы (0, 0) всех LANES матриц, затем (0, 1) и т. д. Один элемент блока — ровно кэш-линия,
+	// и одна и та же операция над LANES матрицами — одна векторная инструкция.
+	// Хвост последнего блока заполнен нулями.
+	template <typename T, size_t R, size_t C>
+	class FixedBatch
+	{
+	public:
+		static constexpr size_t LANES = std::max<size_t>(CACHE_LINE / sizeof(T), 1);
+		static constexpr size_t BLOCK = R * C * LANES;
+
+		explicit FixedBatch(size_t count = 0);
+
+		size_t size() const noexcept;
+		size_t get_blocks() const noexcept;
+
+		FixedMatrix<T, R, C> get(size_t index) const;
+		void set(size_t index, const FixedMatrix<T, R, C>& matrix);
+
+		const T& operator()(size_t index, size_t row, size_t column) const;
+		T& operator()(size_t index, size_t row, size_t column);
+
+		T* block_data(size_t block) noexcept;
+		const T* block_data(size_t block) const noexcept;
+
+	private:
+		size_t _count;
+		std::vector<T, AlignedAllocator<T>> _data;
+	};
+
+	// C[i] = A[i] * B[i] для всех i; блоки по LANES произведений делятся между потоками.
+	template <typename T, size_t R, size_t K, size_t N>
+	void batched_multiply(const FixedBatch<T, R, K>& a, const FixedBatch<T, K, N>& b, FixedBatch<T, R, N>& c,
+		int threads = 1);
+
+	// То же для обычных массивов FixedMatrix: каждое произведение считается развёрнутым fixed_gemm.
+	// Проще в использовании, но векторизуется только внутри одного маленького произведения.
+	template <typename T, size_t R, size_t K, size_t N>
+	void batched_multiply(const FixedMatrix<T, R, K>* a, const FixedMatrix<T, K, N>* b, FixedMatrix<T, R, N>* c,
+		size_t count, int threads = 1);
+
+	namespace detail
+	{
+		template <typename T>
+		using BatchedBlockFn = void (*)(const T* a, const T* b, T* c);
+
+		// LANES произведений одного блока, переносимый вариант.
+		template <typename T, size_t R, size_t K, size_t N, size_t L>
+		void scalar_batched_block(const T* a, const T* b, T* c) noexcept
+		{
+			std::fill(c, c + R * N * L, T{});
+			for (size_t i = 0; i < R; ++i) {
+				T* c_row = c + i * N * L;
+				for (size_t k = 0; k < K; ++k) {
+					const T* a_ik = a + (i * K + k) * L;
+					const T* b_row = b + k * N * L;
+					for (size_t j = 0; j < N; ++j) {
+						for (size_t l = 0; l < L; ++l) {
+							c_row[j * L + l] += a_ik[l] * b_row[j * L + l];
+						}
+					}
+				}
+			}
+		}
+
+#ifdef M_SIMD_X86
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+		// Плитка IB x JB матрицы C для всех LANES матриц блока сразу: IB x JB x V аккумуляторов живут
+		// всю свёртку по k, каждая загрузка A идёт на JB умножений, каждая загрузка B — на IB.
+		template <typename Ops, size_t K, size_t N, size_t L, size_t IB, size_t JB>
+		M_INLINE void batched_tile(const typename Ops::value_type* a, const typename Ops::value_type* b,
+			typename Ops::value_type* c)
+		{
+			constexpr size_t W = Ops::width;
+			constexpr size_t V = L / W;
+			typename Ops::reg acc[IB][JB][V];
+			for (size_t ii = 0; ii < IB; ++ii) {
+				for (size_t jj = 0; jj < JB; ++jj) {
+					for (size_t v = 0; v < V; ++v) {
+						acc[ii][jj][v] = Ops::zero();
+					}
+				}
+			}
+			for (size_t k = 0; k < K; ++k) {
+				for (size_t v = 0; v < V; ++v) {
+					typename Ops::reg bv[JB];
+					for (size_t jj = 0; jj < JB; ++jj) {
+						bv[jj] = Ops::load(b + (k * N + jj) * L + v * W);
+					}
+					for (size_t ii = 0; ii < IB; ++ii) {
+						const typename Ops::reg av = Ops::load(a + (ii * K + k) * L + v * W);
+						for (size_t jj = 0; jj < JB; ++jj) {
+							acc[ii][jj][v] = Ops::mul_add(av, bv[jj], acc[ii][jj][v]);
+						}
+					}
+				}
+			}
+			for (size_t ii = 0; ii < IB; ++ii) {
+				for (size_t jj = 0; jj < JB; ++jj) {
+					for (size_t v = 0; v < V; ++v) {
+						Ops::store(c + (ii * N + jj) * L + v * W, acc[ii][jj][v]);
+					}
+				}
+			}
+		}
+
+		// Столбцы [j, j + JB) всех строк C: панель B для них (K x JB элементов блока) остаётся в L1,
+		// пока её проходят все полосы строк.
+		template <typename Ops, size_t R, size_t K, size_t N, size_t L, size_t IB, size_t JB>
+		M_INLINE void batched_columns(const typename Ops::value_type* a, const typename Ops::value_type* b,
+			typename Ops::value_type* c)
+		{
+			constexpr size_t IT = R % IB;
+			for (size_t i = 0; i + IB <= R; i += IB) {
+				batched_tile<Ops, K, N, L, IB, JB>(a + i * K * L, b, c + i * N * L);
+			}
+			if constexpr (IT > 0) {
+				batched_tile<Ops, K, N, L, IT, JB>(a + (R - IT) * K * L, b, c + (R - IT) * N * L);
+			}
+		}
+
+		// Плитка подбирается так, чтобы аккумуляторов было около половины векторных регистров:
+		// 16 для AVX-512 (регистр на элемент блока), 8 для AVX2 и SSE.
+		template <typename Ops, size_t R, size_t K, size_t N, size_t L>
+		M_INLINE void simd_batched_body(const typename Ops::value_type* a, const typename Ops::value_type* b,
+			typename Ops::value_type* c)
+		{
+			static_assert(L % Ops::width == 0, "A batch block element must be a whole number of registers");
+			constexpr size_t V = L / Ops::width;
+			constexpr size_t BUDGET = V == 1 ? 16 : 8;
+			constexpr size_t JB = std::min<size_t>(N, BUDGET / V >= 4 ? 4 : 2);
+			constexpr size_t IB = std::min<size_t>(R, std::max<size_t>(1, BUDGET / V / JB));
+			constexpr size_t JT = N % JB;
+			for (size_t j = 0; j + JB <= N; j += JB) {
+				batched_columns<Ops, R, K, N, L, IB, JB>(a, b + j * L, c + j * L);
+			}
+			if constexpr (JT > 0) {
+				batched_columns<Ops, R, K, N, L, IB, JT>(a, b + (N - JT) * L, c + (N - JT) * L);
+			}
+		}
+
+		template <typename Ops, size_t R, size_t K, size_t N, size_t L>
+		M_TARGET("sse4.2") M_FLATTEN
+		void sse42_batched_block(const typename Ops::value_type* a, const typename Ops::value_type* b,
+			typename Ops::value_type* c)
+		{
+			simd_batched_body<Ops, R, K, N, L>(a, b, c);
+		}
+
+		template <typename Ops, size_t R, size_t K, size_t N, size_t L>
+		M_TARGET("avx2,fma") M_FLATTEN
+		void avx2_batched_block(const typename Ops::value_type* a, const typename Ops::value_type* b,
+			typename Ops::value_type* c)
+		{
+			simd_batched_body<Ops, R, K, N, L>(a, b, c);
+		}
+
+		template <typename Ops, size_t R, size_t K, size_t N, size_t L>
+		M_TARGET("avx512f") M_FLATTEN
+		void avx512_batched_block(const typename Ops::value_type* a, const typename Ops::value_type* b,
+			typename Ops::value_type* c)
+		{
+			simd_batched_body<Ops, R, K, N, L>(a, b, c);
+		}
+#pragma GCC diagnostic pop
+#endif // M_SIMD_X86
+
+		// Ядро для типа и набора инструкций gemm (с учётом MATRIX_ISA); для остальных типов — переносимое.
+		template <typename T, size_t R, size_t K, size_t N, size_t L>
+		struct BatchedKernels
+		{
+			static BatchedBlockFn<T> get(Isa)
+			{
+				return &scalar_batched_block<T, R, K, N, L>;
+			}
+		};
+
+#ifdef M_SIMD_X86
+		template <typename T, typename SseOps, typename Avx2Ops, typename Avx512Ops, size_t R, size_t K, size_t N,
+			size_t L>
+		struct BatchedKernelTable
+		{
+			static BatchedBlockFn<T> get(Isa isa)
+			{
+				switch (isa) {
+				case Isa::Avx512: return &avx512_batched_block<Avx512Ops, R, K, N, L>;
+				case Isa::Avx2: return &avx2_batched_block<Avx2Ops, R, K, N, L>;
+				case Isa::Sse42: return &sse42_batched_block<SseOps, R, K, N, L>;
+				default: return &scalar_batched_block<T, R, K, N, L>;
+				}
+			}
+		};
+
+		template <size_t R, size_t K, size_t N, size_t L>
+		struct BatchedKernels<float, R, K, N, L>
+			: BatchedKernelTable<float, Sse42Float, Avx2Float, Avx512Float, R, K, N, L> {};
+		template <size_t R, size_t K, size_t N, size_t L>
+		struct BatchedKernels<double, R, K, N, L>
+			: BatchedKernelTable<double, Sse42Double, Avx2Double, Avx512Double, R, K, N, L> {};
+		template <size_t R, size_t K, size_t N, size_t L>
+		struct BatchedKernels<int, R, K, N, L>
+			: BatchedKernelTable<int, Sse42Int, Avx2Int, Avx512Int, R, K, N, L> {};
+#endif // M_SIMD_X86
+	}
+}
+
+template <typename T, size_t R, size_t C>
+M::FixedBatch<T, R, C>::FixedBatch(size_t count) :
+	_count{count},
+	_data((count + LANES - 1) / LANES * BLOCK, T{})
+{ }
+
+template <typename T, size_t R, size_t C>
+size_t M::FixedBatch<T, R, C>::size() const noexcept
+{
+	return _count;
+}
+
+template <typename T, size_t R, size_t C>
+size_t M::FixedBatch<T, R, C>::get_blocks() const noexcept
+{
+	return _data.size() / BLOCK;
+}
+
+template <typename T, size_t R, size_t C>
+M::FixedMatrix<T, R, C> M::FixedBatch<T, R, C>::get(size_t index) const
+{
+	FixedMatrix<T, R, C> matrix;
+	for (size_t i = 0; i < R; ++i) {
+		for (size_t j = 0; j < C; ++j) {
+			matrix(i, j) = (*this)(index, i, j);
+		}
+	}
+	return matrix;
+}
+
+template <typename T, size_t R, size_t C>
+void M::FixedBatch<T, R, C>::set(size_t index, const FixedMatrix<T, R, C>& matrix)
+{
+	for (size_t i = 0; i < R; ++i) {
+		for (size_t j = 0; j < C; ++j) {
+			(*this)(index, i, j) = matrix(i, j);
+		}
+	}
+}
+
+template <typename T, size_t R, size_t C>
+const T& M::FixedBatch<T, R, C>::operator()(size_t index, size_t row, size_t column) const
+{
+	if (index >= _count) {
+		throw std::out_of_range{"[FixedBatch]Index out of range."};
+	}
+	return _data[index / LANES * BLOCK + (row * C + column) * LANES + index % LANES];
+}
+
+template <typename T, size_t R, size_t C>
+T& M::FixedBatch<T, R, C>::operator()(size_t index, size_t row, size_t column)
+{
+	if (index >= _count) {
+		throw std::out_of_range{"[FixedBatch]Index out of range."};
+	}
+	return _data[index / LANES * BLOCK + (row * C + column) * LANES + index % LANES];
+}
+
+template <typename T, size_t R, size_t C>
+T* M::FixedBatch<T, R, C>::block_data(size_t block) noexcept
+{
+	return _data.data() + block * BLOCK;
+}
+
+template <typename T, size_t R, size_t C>
+const T* M::FixedBatch<T, R, C>::block_data(size_t block) const noexcept
+{
+	return _data.data() + block * BLOCK;
+}
+
+template <typename T, size_t R, size_t K, size_t N>
+void M::batched_multiply(const FixedBatch<T, R, K>& a, const FixedBatch<T, K, N>& b, FixedBatch<T, R, N>& c,
+	int threads)
+{
+	if (a.size() != b.size() || a.size() != c.size()) {
+		throw std::invalid_argument{"[batched_multiply]Batches differ in size."};
+	}
+	M_TRACE_SCOPE("batched_multiply");
+	threads = std::max(threads, 1);
+	constexpr size_t L = FixedBatch<T, R, K>::LANES;
+	const long blocks = static_cast<long>(a.get_blocks());
+	const detail::BatchedBlockFn<T> kernel = detail::BatchedKernels<T, R, K, N, L>::get(micro_kernel_for<T>().isa);
+
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+	for (long block = 0; block < blocks; ++block) {
+		kernel(a.block_data(block), b.block_data(block), c.block_data(block));
+	}
+}
+
+template <typename T, size_t R, size_t K, size_t N>
+void M::batched_multiply(const FixedMatrix<T, R, K>* a, const FixedMatrix<T, K, N>* b, FixedMatrix<T, R, N>* c,
+	size_t count, int threads)
+{
+	M_TRACE_SCOPE("batched_multiply");
+	threads = std::max(threads, 1);
+	const long n = static_cast<long>(count);
+
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+	for (long i = 0; i < n; ++i) {
+		c[i] = a[i] * b[i];
+	}
+}
+
+#endif // BATCHED_GEMM_H
@@ -0,0 +1,329 @@
+#ifndef DIST_MATRIX_H
+#define DIST_MATRIX_H
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <mpi.h>
+
+#include "gemm.h"
+#include "matrix.h"
+#include "matrix_view.h"
+#include "mpi_types.h"
+#include "random_generator.h"
+#include "trace.h"
+
+namespace M
+{
+	// Двумерная решётка процессов pr x pc (MPI_Cart_create). Для квадратного числа
+	// процессов решётка квадратная, иначе MPI_Dims_create подбирает близкую к квадрату.
+	// row_comm объединяет процессы одной строки решётки, col_comm — одного столбца.
+	class ProcessGrid
+	{
+	public:
+		explicit ProcessGrid(MPI_Comm comm);
+		~ProcessGrid();
+		ProcessGrid(const ProcessGrid&) = delete;
+		ProcessGrid& operator=(const ProcessGrid&) = delete;
+
+		int rows() const noexcept { return _dims[0]; }
+		int cols() const noexcept { return _dims[1]; }
+		int my_row() const noexcept { return _coords[0]; }
+		int my_col() const noexcept { return _coords[1]; }
+		int rank() const noexcept { return _rank; }
+
+		MPI_Comm comm() const noexcept { return _cart; }
+		MPI_Comm row_comm() const noexcept { return _row; }
+		MPI_Comm col_comm() const noexcept { return _col; }
+
+	private:
+		MPI_Comm _cart = MPI_COMM_NULL, _row = MPI_COMM_NULL, _col = MPI_COMM_NULL;
+		int _dims[2] = {0, 0};
+		int _coords[2] = {0, 0};
+		int _rank = 0;
+	};
+
+	// Матрица, разложенная блочно-циклически по решётке: блок (bi, bj) размера nb x nb
+	// хранится на процессе (bi mod pr, bj mod pc). Каждый процесс держит только свои блоки
+	// одной построчной локальной матрицей, так что память на процесс — около N^2 / P.
+	template <typename T>
+	class DistMatrix
+	{
+	public:
+		static constexpr size_t DEFAULT_BLOCK = 128;
+
+		DistMatrix(const ProcessGrid& grid, size_t rows, size_t cols, size_t block = DEFAULT_BLOCK);
+
+		size_t get_rows() const noexcept { return _rows; }
+		size_t get_cols() const noexcept { return _cols; }
+		size_t block_size() const noexcept { return _block; }
+		const ProcessGrid& grid() const noexcept { return _grid; }
+
+		MatrixView<T> local() noexcept { return _local.view(); }
+		ConstMatrixView<T> local() const noexcept { return _local.view(); }
+
+		// Глобальный индекс строки/столбца по локальному.
+		size_t global_row(size_t local_row) const noexcept;
+		size_t global_col(size_t local_col) const noexcept;
+
+		// Каждый процесс генерирует свои блоки сам; результат совпадает с
+		// Matrix::fill_random с тем же seed.
+		void fill_random(const T& min_val, const T& max_val, uint64_t seed);
+
+		// Сборка всей матрицы на процессе root решётки (для записи и проверки).
+		Matrix<T> gather(int root = 0) const;
+		// Раздача матрицы с процесса root; на остальных процессах source не читается.
+		void scatter(ConstMatrixView<detail::no_deduce_t<T>> source, int root = 0);
+
+	private:
+		// Обход локальных блоков: f(локальная строка, локальный столбец, глобальная строка,
+		// глобальный столбец, высота, ширина) для процесса с координатами (prow, pcol).
+		template <typename F>
+		void for_each_block(int prow, int pcol, F&& f) const;
+
+		const ProcessGrid& _grid;
+		size_t _rows, _cols, _block;
+		Matrix<T> _local;
+	};
+
+	// C = A * B по алгоритму SUMMA: на шаге kb процессы столбца решётки kb mod pc
+	// рассылают свой столбец блоков A по строкам решётки, процессы строки kb mod pr —
+	// свою строку блоков B по столбцам, и каждый процесс добавляет произведение панелей
+	// к своим блокам C. Все три матрицы должны быть на одной решётке с одним размером блока.
+	template <typename T>
+	void summa(const DistMatrix<T>& A, const DistMatrix<T>& B, DistMatrix<T>& C);
+
+	namespace detail
+	{
+		// Сколько элементов измерения n с блоком nb приходится на процесс p из np (numroc в ScaLAPACK).
+		inline size_t local_extent(size_t n, size_t nb, int p, int np) noexcept
+		{
+			const size_t blocks = n / nb;
+			size_t extent = blocks / np * nb;
+			const size_t extra = blocks % np;
+			if (static_cast<size_t>(p) < extra) {
+				extent += nb;
+			}
+			else if (static_cast<size_t>(p) == extra) {
+				extent += n % nb;
+			}
+			return extent;
+		}
+	}
+}
+
+inline M::ProcessGrid::ProcessGrid(MPI_Comm comm)
+{
+	int size;
+	MPI_Comm_size(comm, &size);
+	MPI_Dims_create(size, 2, _dims);
+	const int periods[2] = {0, 0};
+	MPI_Cart_create(comm, 2, _dims, periods, 0, &_cart);
+	MPI_Comm_rank(_cart, &_rank);
+	MPI_Cart_coords(_cart, _rank, 2, _coords);
+
+	const int keep_cols[2] = {0, 1};
+	const int keep_rows[2] = {1, 0};
+	MPI_Cart_sub(_cart, keep_cols, &_row);
+	MPI_Cart_sub(_cart, keep_rows, &_col);
+}
+
+inline M::ProcessGrid::~ProcessGrid()
+{
+	MPI_Comm_free(&_row);
+	MPI_Comm_free(&_col);
+	MPI_Comm_free(&_cart);
+}
+
+template <typename T>
+M::DistMatrix<T>::DistMatrix(const ProcessGrid& grid, size_t rows, size_t cols, size_t block) :
+	_grid{grid},
+	_rows{rows},
+	_cols{cols},
+	_block{std::max<size_t>(block, 1)},
+	_local{detail::local_extent(rows, _block, grid.my_row(), grid.rows()),
+		detail::local_extent(cols, _block, grid.my_col(), grid.cols())}
+{ }
+
+template <typename T>
+size_t M::DistMatrix<T>::global_row(size_t local_row) const noexcept
+{
+	const size_t lb = local_row / _block;
+	return (lb * _grid.rows() + _grid.my_row()) * _block + local_row % _block;
+}
+
+template <typename T>
+size_t M::DistMatrix<T>::global_col(size_t local_col) const noexcept
+{
+	const size_t lb = local_col / _block;
+	return (lb * _grid.cols() + _grid.my_col()) * _block + local_col % _block;
+}
+
+template <typename T>
+template <typename F>
+void M::DistMatrix<T>::for_each_block(int prow, int pcol, F&& f) const
+{
+	const size_t pr = _grid.rows(), pc = _grid.cols();
+	size_t li = 0;
+	for (size_t gi = prow * _block; gi < _rows; gi += pr * _block) {
+		const size_t h = std::min(_block, _rows - gi);
+		size_t lj = 0;
+		for (size_t gj = pcol * _block; gj < _cols; gj += pc * _block) {
+			const size_t w = std::min(_block, _cols - gj);
+			f(li, lj, gi, gj, h, w);
+			lj += w;
+		}
+		li += h;
+	}
+}
+
+template <typename T>
+void M::DistMatrix<T>::fill_random(const T& min_val, const T& max_val, uint64_t seed)
+{
+	const MatrixView<T> out = _local.view();
+	for_each_block(_grid.my_row(), _grid.my_col(), [&](size_t li, size_t lj, size_t gi, size_t gj, size_t h, size_t w) {
+		RandomGenerator::fill_block(&out(li, lj), out.get_ld(), gi, gj, h, w, min_val, max_val, seed);
+	});
+}
+
+template <typename T>
+M::Matrix<T> M::DistMatrix<T>::gather(int root) const
+{
+	M_TRACE_SCOPE("dist gather");
+	int size;
+	MPI_Comm_size(_grid.comm(), &size);
+
+	const int local_count = static_cast<int>(_local.get_rows() * _local.get_cols());
+	std::vector<int> counts(size), displs(size);
+	MPI_Gather(&local_count, 1, MPI_INT, counts.data(), 1, MPI_INT, root, _grid.comm());
+
+	std::vector<T> packed;
+	if (_grid.rank() == root) {
+		for (int r = 0, offset = 0; r < size; ++r) {
+			displs[r] = offset;
+			offset += counts[r];
+		}
+		packed.resize(static_cast<size_t>(displs.back()) + counts.back());
+	}
+	MPI_Gatherv(_local.get_data(), local_count, mpi_type<T>(), packed.data(), counts.data(), displs.data(),
+		mpi_type<T>(), root, _grid.comm());
+
+	if (_grid.rank() != root) {
+		return Matrix<T>{};
+	}
+	Matrix<T> result(_rows, _cols);
+	for (int r = 0; r < size; ++r) {
+		int coords[2];
+		MPI_Cart_coords(_grid.comm(), r, 2, coords);
+		const size_t ld = detail::local_extent(_cols, _block, coords[1], _grid.cols());
+		const T* src = packed.data() + displs[r];
+		for_each_block(coords[0], coords[1], [&](size_t li, size_t lj, size_t gi, size_t gj, size_t h, size_t w) {
+			for (size_t i = 0; i < h; ++i) {
+				std::copy(src + (li + i) * ld + lj, src + (li + i) * ld + lj + w, &result(gi + i, gj));
+			}
+		});
+	}
+	return result;
+}
+
+template <typename T>
+void M::DistMatrix<T>::scatter(ConstMatrixView<detail::no_deduce_t<T>> source, int root)
+{
+	M_TRACE_SCOPE("dist scatter");
+	int size;
+	MPI_Comm_size(_grid.comm(), &size);
+
+	std::vector<int> counts(size), displs(size);
+	std::vector<T> packed;
+	if (_grid.rank() == root) {
+		if (source.get_rows() != _rows || source.get_cols() != _cols) {
+			throw std::invalid_argument{"[DistMatrix::scatter]Source shape does not match."};
+		}
+		for (int r = 0, offset = 0; r < size; ++r) {
+			int coords[2];
+			MPI_Cart_coords(_grid.comm(), r, 2, coords);
+			const size_t lr = detail::local_extent(_rows, _block, coords[0], _grid.rows());
+			const size_t lc = detail::local_extent(_cols, _block, coords[1], _grid.cols());
+			counts[r] = static_cast<int>(lr * lc);
+			displs[r] = offset;
+			offset += counts[r];
+		}
+		packed.resize(static_cast<size_t>(displs.back()) + counts.back());
+		for (int r = 0; r < size; ++r) {
+			int coords[2];
+			MPI_Cart_coords(_grid.comm(), r, 2, coords);
+			const size_t ld = detail::local_extent(_cols, _block, coords[1], _grid.cols());
+			T* dst = packed.data() + displs[r];
+			for_each_block(coords[0], coords[1], [&](size_t li, size_t lj, size_t gi, size_t gj, size_t h, size_t w) {
+				for (size_t i = 0; i < h; ++i) {
+					std::copy(source.row(gi + i) + gj, source.row(gi + i) + gj + w, dst + (li + i) * ld + lj);
+				}
+			});
+		}
+	}
+	MPI_Scatterv(packed.data(), counts.data(), displs.data(), mpi_type<T>(), _local.get_data(),
+		static_cast<int>(_local.get_rows() * _local.get_cols()), mpi_type<T>(), root, _grid.comm());
+}
+
+template <typename T>
+void M::summa(const DistMatrix<T>& A, const DistMatrix<T>& B, DistMatrix<T>& C)
+{
+	if (A.get_cols() != B.get_rows() || A.get_rows() != C.get_rows() || B.get_cols() != C.get_cols()) {
+		throw std::invalid_argument{"Failed to multiply matrices"};
+	}
+	if (&A.grid() != &C.grid() || &B.grid() != &C.grid() ||
+		A.block_size() != C.block_size() || B.block_size() != C.block_size()) {
+		throw std::invalid_argument{"[summa]Matrices must share the process grid and block size."};
+	}
+
+	const ProcessGrid& grid = C.grid();
+	const size_t nb = C.block_size();
+	const size_t k = A.get_cols();
+	const MatrixView<T> c = C.local();
+	for (size_t i = 0; i < c.get_rows(); ++i) {
+		std::fill(c.row(i), c.row(i) + c.get_cols(), T{});
+	}
+
+	const ConstMatrixView<T> a = A.local();
+	const ConstMatrixView<T> b = B.local();
+	std::vector<T> a_panel(a.get_rows() * nb);
+	std::vector<T> b_panel(nb * b.get_cols());
+
+	for (size_t kb = 0; kb * nb < k; ++kb) {
+		const size_t w = std::min(nb, k - kb * nb);
+		const int owner_col = static_cast<int>(kb % grid.cols());
+		const int owner_row = static_cast<int>(kb % grid.rows());
+
+		// Столбец блоков A: локальные столбцы [kb / pc * nb, + w) у процессов столбца owner_col.
+		{
+			M_TRACE_SCOPE("summa bcast A");
+			if (grid.my_col() == owner_col) {
+				const size_t lj = kb / grid.cols() * nb;
+				for (size_t i = 0; i < a.get_rows(); ++i) {
+					std::copy(a.row(i) + lj, a.row(i) + lj + w, a_panel.data() + i * w);
+				}
+			}
+			MPI_Bcast(a_panel.data(), static_cast<int>(a.get_rows() * w), mpi_type<T>(), owner_col, grid.row_comm());
+		}
+
+		// Строка блоков B: локальные строки [kb / pr * nb, + w) у процессов строки owner_row.
+		{
+			M_TRACE_SCOPE("summa bcast B");
+			if (grid.my_row() == owner_row) {
+				const size_t li = kb / grid.rows() * nb;
+				for (size_t i = 0; i < w; ++i) {
+					std::copy(b.row(li + i), b.row(li + i) + b.get_cols(), b_panel.data() + i * b.get_cols());
+				}
+			}
+			MPI_Bcast(b_panel.data(), static_cast<int>(w * b.get_cols()), mpi_type<T>(), owner_row, grid.col_comm());
+		}
+
+		gemm(c.get_rows(), c.get_cols(), w, a_panel.data(), w, b_panel.data(), b.get_cols(),
+			c.get_data(), c.get_ld());
+	}
+}
+
+#endif // DIST_MATRIX_H
@@ -0,0 +1,198 @@
+#ifndef FIXED_MATRIX_H
+#define FIXED_MATRIX_H
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <initializer_list>
+#include <stdexcept>
+#include <utility>
+
+#include "matrix_view.h"
+
+namespace M
+{
+	// Матрица R x C с размерами на этапе компиляции и данными внутри объекта (построчно):
+	// ни выделения памяти, ни размеров во время выполнения. Рассчитана на 4x4 ... 32x32.
+	template <typename T, size_t R, size_t C>
+	class FixedMatrix
+	{
+		static_assert(R > 0 && C > 0, "FixedMatrix dimensions must be positive");
+
+	public:
+		using value_type = T;
+		static constexpr size_t ROWS = R;
+		static constexpr size_t COLS = C;
+
+		constexpr FixedMatrix() noexcept : _data{} { }
+		FixedMatrix(std::initializer_list<std::initializer_list<T>> list);
+		explicit FixedMatrix(ConstMatrixView<T> view);
+
+		static constexpr size_t get_rows() noexcept { return R; }
+		static constexpr size_t get_cols() noexcept { return C; }
+		constexpr T* get_data() noexcept { return _data.data(); }
+		constexpr const T* get_data() const noexcept { return _data.data(); }
+
+		constexpr const T& operator()(size_t row, size_t column) const noexcept { return _data[row * C + column]; }
+		constexpr T& operator()(size_t row, size_t column) noexcept { return _data[row * C + column]; }
+
+		MatrixView<T> view() noexcept;
+		ConstMatrixView<T> view() const noexcept;
+
+		static FixedMatrix identity() noexcept;
+		FixedMatrix<T, C, R> transpose() const noexcept;
+
+		FixedMatrix& operator+=(const FixedMatrix& rhs) noexcept;
+		FixedMatrix& operator-=(const FixedMatrix& rhs) noexcept;
+		bool operator==(const FixedMatrix& rhs) const noexcept;
+		bool operator!=(const FixedMatrix& rhs) const noexcept;
+
+	private:
+		std::array<T, R * C> _data;
+	};
+
+	// C(R x N) += A(R x K) * B(K x N) на сырых построчных массивах. Все границы — константы,
+	// строка C обновляется развёрнутой свёрткой по N, так что компилятор видит прямой код без счётчиков.
+	template <typename T, size_t R, size_t K, size_t N>
+	void fixed_gemm(const T* a, const T* b, T* c) noexcept;
+
+	template <typename T, size_t R, size_t K, size_t N>
+	FixedMatrix<T, R, N> operator*(const FixedMatrix<T, R, K>& lhs, const FixedMatrix<T, K, N>& rhs) noexcept;
+
+	template <typename T, size_t R, size_t C>
+	FixedMatrix<T, R, C> operator+(FixedMatrix<T, R, C> lhs, const FixedMatrix<T, R, C>& rhs) noexcept;
+
+	template <typename T, size_t R, size_t C>
+	FixedMatrix<T, R, C> operator-(FixedMatrix<T, R, C> lhs, const FixedMatrix<T, R, C>& rhs) noexcept;
+
+	namespace detail
+	{
+		// c[j] += a * b[j] для всех j из J: выражение раскрывается в N отдельных операций.
+		template <typename T, size_t... J>
+		inline void fixed_axpy(T* c, T a, const T* b, std::index_sequence<J...>) noexcept
+		{
+			((c[J] += a * b[J]), ...);
+		}
+	}
+}
+
+template <typename T, size_t R, size_t C>
+M::FixedMatrix<T, R, C>::FixedMatrix(std::initializer_list<std::initializer_list<T>> list) :
+	_data{}
+{
+	if (list.size() != R || std::any_of(list.begin(), list.end(), [](const auto& row) { return row.size() != C; })) {
+		throw std::invalid_argument{"[FixedMatrix]Initializer does not match the matrix dimensions."};
+	}
+	size_t i = 0;
+	for (const auto& row : list) {
+		std::copy(row.begin(), row.end(), _data.begin() + i++ * C);
+	}
+}
+
+template <typename T, size_t R, size_t C>
+M::FixedMatrix<T, R, C>::FixedMatrix(ConstMatrixView<T> view) :
+	_data{}
+{
+	if (view.get_rows() != R || view.get_cols() != C) {
+		throw std::invalid_argument{"[FixedMatrix]View does not match the matrix dimensions."};
+	}
+	for (size_t i = 0; i < R; ++i) {
+		std::copy_n(view.row(i), C, _data.begin() + i * C);
+	}
+}
+
+template <typename T, size_t R, size_t C>
+M::MatrixView<T> M::FixedMatrix<T, R, C>::view() noexcept
+{
+	return {_data.data(), R, C};
+}
+
+template <typename T, size_t R, size_t C>
+M::ConstMatrixView<T> M::FixedMatrix<T, R, C>::view() const noexcept
+{
+	return {_data.data(), R, C};
+}
+
+template <typename T, size_t R, size_t C>
+M::FixedMatrix<T, R, C> M::FixedMatrix<T, R, C>::identity() noexcept
+{
+	FixedMatrix result;
+	for (size_t i = 0; i < std::min(R, C); ++i) {
+		result(i, i) = T(1);
+	}
+	return result;
+}
+
+template <typename T, size_t R, size_t C>
+M::FixedMatrix<T, C, R> M::FixedMatrix<T, R, C>::transpose() const noexcept
+{
+	FixedMatrix<T, C, R> result;
+	for (size_t i = 0; i < R; ++i) {
+		for (size_t j = 0; j < C; ++j) {
+			result(j, i) = (*this)(i, j);
+		}
+	}
+	return result;
+}
+
+template <typename T, size_t R, size_t C>
+M::FixedMatrix<T, R, C>& M::FixedMatrix<T, R, C>::operator+=(const FixedMatrix& rhs) noexcept
+{
+	for (size_t i = 0; i < R * C; ++i) {
+		_data[i] += rhs._data[i];
+	}
+	return *this;
+}
+
+template <typename T, size_t R, size_t C>
+M::FixedMatrix<T, R, C>& M::FixedMatrix<T, R, C>::operator-=(const FixedMatrix& rhs) noexcept
+{
+	for (size_t i = 0; i < R * C; ++i) {
+		_data[i] -= rhs._data[i];
+	}
+	return *this;
+}
+
+template <typename T, size_t R, size_t C>
+bool M::FixedMatrix<T, R, C>::operator==(const FixedMatrix& rhs) const noexcept
+{
+	return _data == rhs._data;
+}
+
+template <typename T, size_t R, size_t C>
+bool M::FixedMatrix<T, R, C>::operator!=(const FixedMatrix& rhs) const noexcept
+{
+	return !(*this == rhs);
+}
+
+template <typename T, size_t R, size_t K, size_t N>
+void M::fixed_gemm(const T* a, const T* b, T* c) noexcept
+{
+	for (size_t i = 0; i < R; ++i) {
+		for (size_t k = 0; k < K; ++k) {
+			detail::fixed_axpy(c + i * N, a[i * K + k], b + k * N, std::make_index_sequence<N>{});
+		}
+	}
+}
+
+template <typename T, size_t R, size_t K, size_t N>
+M::FixedMatrix<T, R, N> M::operator*(const FixedMatrix<T, R, K>& lhs, const FixedMatrix<T, K, N>& rhs) noexcept
+{
+	FixedMatrix<T, R, N> result;
+	fixed_gemm<T, R, K, N>(lhs.get_data(), rhs.get_data(), result.get_data());
+	return result;
+}
+
+template <typename T, size_t R, size_t C>
+M::FixedMatrix<T, R, C> M::operator+(FixedMatrix<T, R, C> lhs, const FixedMatrix<T, R, C>& rhs) noexcept
+{
+	return lhs += rhs;
+}
+
+template <typename T, size_t R, size_t C>
+M::FixedMatrix<T, R, C> M::operator-(FixedMatrix<T, R, C> lhs, const FixedMatrix<T, R, C>& rhs) noexcept
+{
+	return lhs -= rhs;
+}
+
+#endif // FIXED_MATRIX_H
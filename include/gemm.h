@@ -0,0 +1,177 @@
+#ifndef GEMM_H
+#define GEMM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "matrix_view.h"
+#include "simd_kernels.h"
+#include "trace.h"
+
+namespace M
+{
+	// Размеры блоков: панель B (kc x nc) держим в L3, блок A (mc x kc) — в L2,
+	// полоску B (kc x NR) — в L1. MR и NR задаёт выбранное микроядро.
+	struct GemmBlocking
+	{
+		size_t mc, kc, nc;
+	};
+
+	template <typename T>
+	GemmBlocking default_blocking() noexcept;
+
+	// C(m x n) += A(m x k) * B(k x n). Все матрицы построчные, ld* — длина строки в памяти.
+	template <typename T>
+	void gemm(size_t m, size_t n, size_t k,
+		const T* a, size_t lda,
+		const T* b, size_t ldb,
+		T* c, size_t ldc,
+		int threads = 1);
+
+	// То же на представлениях: можно умножать блоки и панели строк без копирования.
+	template <typename T>
+	void gemm(ConstMatrixView<detail::no_deduce_t<T>> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+		MatrixView<T> c, int threads = 1);
+
+	namespace detail
+	{
+		inline size_t round_up(size_t value, size_t step) noexcept
+		{
+			return (value + step - 1) / step * step;
+		}
+
+		// Буферы упаковки живут в потоке и переиспользуются между вызовами.
+		template <typename T>
+		std::vector<T>& packing_buffer(size_t slot)
+		{
+			thread_local std::vector<T> buffers[2];
+			return buffers[slot];
+		}
+
+		// Блок A раскладывается полосками по MR строк: для каждого p подряд идут MR значений.
+		template <typename T>
+		void pack_a(size_t mc, size_t kc, const T* a, size_t lda, T* buf, size_t MR)
+		{
+			for (size_t ir = 0; ir < mc; ir += MR) {
+				const size_t mr = std::min(MR, mc - ir);
+				for (size_t p = 0; p < kc; ++p) {
+					for (size_t i = 0; i < mr; ++i) {
+						buf[i] = a[(ir + i) * lda + p];
+					}
+					for (size_t i = mr; i < MR; ++i) {
+						buf[i] = T{};
+					}
+					buf += MR;
+				}
+			}
+		}
+
+		// Панель B раскладывается полосками по NR столбцов: для каждого p подряд идут NR значений.
+		template <typename T>
+		void pack_b(size_t kc, size_t nc, const T* b, size_t ldb, T* buf, size_t NR)
+		{
+			for (size_t jr = 0; jr < nc; jr += NR) {
+				const size_t nr = std::min(NR, nc - jr);
+				for (size_t p = 0; p < kc; ++p) {
+					const T* row = b + p * ldb + jr;
+					for (size_t j = 0; j < nr; ++j) {
+						buf[j] = row[j];
+					}
+					for (size_t j = nr; j < NR; ++j) {
+						buf[j] = T{};
+					}
+					buf += NR;
+				}
+			}
+		}
+	}
+}
+
+template <typename T>
+M::GemmBlocking M::default_blocking() noexcept
+{
+	constexpr size_t kc = 256;
+	constexpr size_t l2_bytes = 128 * 1024;
+	constexpr size_t l3_bytes = 2 * 1024 * 1024;
+
+	const MicroKernel<T>& kernel = micro_kernel_for<T>();
+	const size_t mc = std::max(kernel.mr, l2_bytes / (kc * sizeof(T)) / kernel.mr * kernel.mr);
+	const size_t nc = std::max(kernel.nr, l3_bytes / (kc * sizeof(T)) / kernel.nr * kernel.nr);
+	return {mc, kc, nc};
+}
+
+template <typename T>
+void M::gemm(size_t m, size_t n, size_t k,
+	const T* a, size_t lda,
+	const T* b, size_t ldb,
+	T* c, size_t ldc,
+	int threads)
+{
+	using namespace detail;
+
+	if (m == 0 || n == 0 || k == 0) {
+		return;
+	}
+	M_TRACE_SCOPE("gemm");
+
+	const MicroKernel<T>& kernel = micro_kernel_for<T>();
+	const size_t MR = kernel.mr;
+	const size_t NR = kernel.nr;
+
+	const GemmBlocking blocking = default_blocking<T>();
+	// Чтобы все потоки получили работу и на маленьких матрицах, уменьшаем mc.
+	const size_t per_thread = round_up((m + threads - 1) / std::max(threads, 1), MR);
+	const size_t mc = std::max(MR, std::min(blocking.mc, per_thread));
+	const long m_blocks = static_cast<long>((m + mc - 1) / mc);
+
+	std::vector<T>& b_buf = packing_buffer<T>(1);
+	b_buf.resize(blocking.kc * round_up(std::min(blocking.nc, n), NR));
+
+	for (size_t jc = 0; jc < n; jc += blocking.nc) {
+		const size_t nc = std::min(blocking.nc, n - jc);
+		for (size_t pc = 0; pc < k; pc += blocking.kc) {
+			const size_t kc = std::min(blocking.kc, k - pc);
+			pack_b(kc, nc, b + pc * ldb + jc, ldb, b_buf.data(), NR);
+			const T* bp = b_buf.data();
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+#endif
+			for (long block = 0; block < m_blocks; ++block) {
+				M_TRACE_SCOPE("gemm block");
+				const size_t ic = static_cast<size_t>(block) * mc;
+				const size_t mc_cur = std::min(mc, m - ic);
+
+				std::vector<T>& a_buf = packing_buffer<T>(0);
+				a_buf.resize(round_up(mc, MR) * blocking.kc);
+				pack_a(mc_cur, kc, a + ic * lda + pc, lda, a_buf.data(), MR);
+
+				for (size_t jr = 0; jr < nc; jr += NR) {
+					for (size_t ir = 0; ir < mc_cur; ir += MR) {
+						kernel.run(kc, a_buf.data() + ir * kc, bp + jr * kc,
+							c + (ic + ir) * ldc + jc + jr, ldc,
+							std::min(MR, mc_cur - ir), std::min(NR, nc - jr));
+					}
+				}
+			}
+		}
+	}
+}
+
+template <typename T>
+void M::gemm(ConstMatrixView<detail::no_deduce_t<T>> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+	MatrixView<T> c, int threads)
+{
+	if (a.get_cols() != b.get_rows() || a.get_rows() != c.get_rows() || b.get_cols() != c.get_cols()) {
+		throw std::invalid_argument{"Failed to multiply matrices"};
+	}
+	gemm(a.get_rows(), b.get_cols(), a.get_cols(),
+		a.get_data(), a.get_ld(),
+		b.get_data(), b.get_ld(),
+		c.get_data(), c.get_ld(),
+		threads);
+}
+
+#endif // GEMM_H
@@ -8,17 +8,35 @@
 #include <stdexcept>
 #include <fstream>
 
+#include "allocator.h"
+#include "gemm.h"
+#include "matrix_expr.h"
+#include "matrix_view.h"
+#include "text_io.h"
 #include "random_generator.h"
+#ifdef _OPENMP
+#include "tuning.h"
+#endif
 
 namespace M
 {
-	template <typename T = float>
-	class Matrix
+	// Alloc задаёт политику памяти: AlignedAllocator (по умолчанию), HugePageAllocator
+	// или PoolAllocator из allocator.h, либо любой стандартный аллокатор.
+	template <typename T = float, typename Alloc = AlignedAllocator<T>>
+	class Matrix : public MatrixExpr<Matrix<T, Alloc>>
 	{
 		public:
+		using value_type = T;
+		using allocator_type = Alloc;
+
 		Matrix(size_t rows, size_t cols); // все значения нулями
 		Matrix(size_t rows, size_t cols, const T *data);
 		Matrix(std::initializer_list<std::initializer_list<T>> list);
+		template <typename E>
+		Matrix(const MatrixExpr<E>& expr);
+
+		template <typename E>
+		Matrix& operator=(const MatrixExpr<E>& expr);
 
 		size_t get_rows() const noexcept;
 		size_t get_cols() const noexcept;
@@ -28,15 +46,26 @@ namespace M
 		const T& operator()(size_t row, size_t column) const;
 		T& operator()(size_t row, size_t column);
 
-		Matrix<T>& operator+=(const Matrix<T>& rhs);	
+		MatrixView<T> view() noexcept;
+		ConstMatrixView<T> view() const noexcept;
+		MatrixView<T> block(size_t row, size_t column, size_t height, size_t width);
+		ConstMatrixView<T> block(size_t row, size_t column, size_t height, size_t width) const;
+
+		Matrix transpose() const;
 
-		Matrix<T>& operator-=(const Matrix<T>& rhs);		
+		Matrix& operator+=(const Matrix& rhs);	
+		template <typename E>
+		Matrix& operator+=(const MatrixExpr<E>& rhs);
+
+		Matrix& operator-=(const Matrix& rhs);		
 		
-		Matrix<T>& operator*=(Matrix<T> rhs);
+		Matrix& operator*=(const Matrix& rhs);
 
 		void clear();
 
-		void fill_random(const T& min_val, const T& max_val);
+		// С одинаковым seed матрица получается одной и той же при любом числе потоков.
+		void fill_random(const T& min_val, const T& max_val,
+			uint64_t seed = RandomGenerator::random_seed(), int threads = 1);
 
 		void write_to_file(const std::string& filename) const;
 
@@ -44,25 +73,25 @@ namespace M
 
 	private:
 		size_t _rows, _cols;
-		std::vector<T> _data;
+		std::vector<T, Alloc> _data;
 	};
 }
-template <typename T>
-M::Matrix<T>::Matrix(size_t rows, size_t cols) : 
+template <typename T, typename Alloc>
+M::Matrix<T, Alloc>::Matrix(size_t rows, size_t cols) : 
 	_rows{rows},
 	_cols{cols},
 	_data(rows * cols, 0)
 { }
 
-template <typename T>
-M::Matrix<T>::Matrix(size_t rows, size_t cols, const T *data) : 
+template <typename T, typename Alloc>
+M::Matrix<T, Alloc>::Matrix(size_t rows, size_t cols, const T *data) : 
 	_rows{rows},
 	_cols{cols},
 	_data(data, data + rows * cols)
 { }
 
-template <typename T>
-M::Matrix<T>::Matrix(std::initializer_list<std::initializer_list<T>> list) : 
+template <typename T, typename Alloc>
+M::Matrix<T, Alloc>::Matrix(std::initializer_list<std::initializer_list<T>> list) : 
 				Matrix{static_cast<size_t>(list.size()),
 				static_cast<size_t>(list.size() ? list.begin()->size() : 0)}
 {
@@ -74,44 +103,102 @@ M::Matrix<T>::Matrix(std::initializer_list<std::initializer_list<T>> list) :
 		);
 }
 
-template <typename T>
-size_t M::Matrix<T>::get_rows() const noexcept
+template <typename T, typename Alloc>
+template <typename E>
+M::Matrix<T, Alloc>::Matrix(const MatrixExpr<E>& expr) :
+	_rows{expr.self().get_rows()},
+	_cols{expr.self().get_cols()},
+	_data(_rows * _cols)
+{
+	detail::make_operand(expr).assign_to(_data.data());
+}
+
+template <typename T, typename Alloc>
+template <typename E>
+M::Matrix<T, Alloc>& M::Matrix<T, Alloc>::operator=(const MatrixExpr<E>& expr)
+{
+	const auto node = detail::make_operand(expr);
+	const bool same_shape = node.get_rows() == _rows && node.get_cols() == _cols;
+	// Если выражение читает приёмник уже после того, как тот начал перезаписываться,
+	// считаем во временную матрицу и перемещаем её.
+	if (!same_shape || !node.safe_in_place(_data.data())) {
+		*this = Matrix(expr);
+		return *this;
+	}
+	node.assign_to(_data.data());
+	return *this;
+}
+
+template <typename T, typename Alloc>
+size_t M::Matrix<T, Alloc>::get_rows() const noexcept
 {
 	return _rows;
 }
 
-template <typename T>
-size_t M::Matrix<T>::get_cols() const noexcept
+template <typename T, typename Alloc>
+size_t M::Matrix<T, Alloc>::get_cols() const noexcept
 {
 	return _cols;
 }
 
-template<typename T>
-T* M::Matrix<T>::get_data() noexcept
+template <typename T, typename Alloc>
+T* M::Matrix<T, Alloc>::get_data() noexcept
 {
 	return _data.data();
 }
 
-template<typename T>
-const T* M::Matrix<T>::get_data() const noexcept {
+template <typename T, typename Alloc>
+const T* M::Matrix<T, Alloc>::get_data() const noexcept {
 	return _data.data();
 }
 
 
-template <typename T>
-const T& M::Matrix<T>::operator()(size_t row, size_t column) const
+template <typename T, typename Alloc>
+const T& M::Matrix<T, Alloc>::operator()(size_t row, size_t column) const
 {
 	return _data[row * _cols + column];
 }
 
-template <typename T>
-T& M::Matrix<T>::operator()(size_t row, size_t column)
+template <typename T, typename Alloc>
+T& M::Matrix<T, Alloc>::operator()(size_t row, size_t column)
 {
 	return _data[row * _cols + column];
 }
 
-template<typename T>
-M::Matrix<T>& M::Matrix<T>::operator+=(const Matrix<T>& rhs) 
+template <typename T, typename Alloc>
+M::MatrixView<T> M::Matrix<T, Alloc>::view() noexcept
+{
+	return {_data.data(), _rows, _cols};
+}
+
+template <typename T, typename Alloc>
+M::ConstMatrixView<T> M::Matrix<T, Alloc>::view() const noexcept
+{
+	return {_data.data(), _rows, _cols};
+}
+
+template <typename T, typename Alloc>
+M::MatrixView<T> M::Matrix<T, Alloc>::block(size_t row, size_t column, size_t height, size_t width)
+{
+	return view().block(row, column, height, width);
+}
+
+template <typename T, typename Alloc>
+M::ConstMatrixView<T> M::Matrix<T, Alloc>::block(size_t row, size_t column, size_t height, size_t width) const
+{
+	return view().block(row, column, height, width);
+}
+
+template <typename T, typename Alloc>
+M::Matrix<T, Alloc> M::Matrix<T, Alloc>::transpose() const
+{
+	Matrix result(_cols, _rows);
+	M::transpose(view(), result.view());
+	return result;
+}
+
+template <typename T, typename Alloc>
+M::Matrix<T, Alloc>& M::Matrix<T, Alloc>::operator+=(const Matrix& rhs) 
 {
 	if(this->_cols != rhs._cols || this->_rows != rhs._rows){
 		throw std::invalid_argument{"Failed to sum matrices"};
@@ -124,15 +211,24 @@ M::Matrix<T>& M::Matrix<T>::operator+=(const Matrix<T>& rhs)
 	return *this;
 }
 
-template<typename T>
-M::Matrix<T> operator+(M::Matrix<T> lhs, const M::Matrix<T>& rhs) 
+template <typename T, typename Alloc>
+template<typename E>
+M::Matrix<T, Alloc>& M::Matrix<T, Alloc>::operator+=(const MatrixExpr<E>& rhs)
 {
-    lhs += rhs;
-    return lhs;
-}	
+	const auto node = detail::make_operand(rhs);
+	if(_rows != node.get_rows() || _cols != node.get_cols()){
+		throw std::invalid_argument{"Failed to sum matrices"};
+	}
+	// C += A * B накапливается прямо в C без временной матрицы.
+	if(node.aliases(_data.data())){
+		return *this += Matrix(rhs);
+	}
+	node.accumulate_into(_data.data());
+	return *this;
+}
 
-template<typename T>
-M::Matrix<T>& M::Matrix<T>::operator-=(const Matrix<T>& rhs)
+template <typename T, typename Alloc>
+M::Matrix<T, Alloc>& M::Matrix<T, Alloc>::operator-=(const Matrix& rhs)
 {
 	if(_rows != rhs._rows || _cols != rhs._cols){
 		throw std::invalid_argument{"Failed to subtruct matrices"};
@@ -145,73 +241,42 @@ M::Matrix<T>& M::Matrix<T>::operator-=(const Matrix<T>& rhs)
 	return *this;
 }
 
-template<typename T>
-M::Matrix<T> operator-(M::Matrix<T> lhs, const M::Matrix<T>& rhs) 
-{ 
-    lhs -= rhs;  
-    return lhs;
-}
-
-template<typename T>
-M::Matrix<T>& M::Matrix<T>::operator*=(Matrix<T> rhs)
+template <typename T, typename Alloc>
+M::Matrix<T, Alloc>& M::Matrix<T, Alloc>::operator*=(const Matrix& rhs)
 {
 	if(_cols != rhs._rows){
 		throw std::invalid_argument{"Failed to multiply matrices"};
 	}
-	Matrix<T> result(_rows, rhs._cols);
-	for(size_t i = 0; i < _cols; ++i)
-	{
-		for(size_t j = 0; j < rhs._rows; ++j)
-		{
-			T sum{};
-			for(size_t k = 0; k < _cols; ++k)
-			{
-				sum += (*this)(i, k) * rhs(k, j);
-			}
-			result(i, j) = sum;
-		}
-	}
-	*this = result;
+	Matrix result(_rows, rhs._cols);
+	// С OpenMP умножение идёт на потоках и плитках из кэша подбора, если для размера есть запись.
+#ifdef _OPENMP
+	tuned_gemm(view(), rhs.view(), result.view());
+#else
+	gemm(view(), rhs.view(), result.view());
+#endif
+	*this = std::move(result);
 	return *this;
 }
 
-template<typename T>
-M::Matrix<T> operator*(M::Matrix<T> lhs, const M::Matrix<T>& rhs)
-{
-	lhs *= rhs;
-	return lhs;
-}
-
-template<typename T>
-void M::Matrix<T>::clear() {
+template <typename T, typename Alloc>
+void M::Matrix<T, Alloc>::clear() {
 	_data.clear();
 	_rows = 0;
 	_cols = 0;
 }
 
-template<typename T>
-void M::Matrix<T>::fill_random(const T& min_val, const T& max_val) {
-	_data = RandomGenerator::generate_matrix(_rows, _cols, min_val, max_val);
+template <typename T, typename Alloc>
+void M::Matrix<T, Alloc>::fill_random(const T& min_val, const T& max_val, uint64_t seed, int threads) {
+	RandomGenerator::fill_block(_data.data(), _cols, 0, 0, _rows, _cols, min_val, max_val, seed, threads);
 }
 
-template<typename T>
-void M::Matrix<T>::write_to_file(const std::string& filename) const {
-	std::ofstream file(filename);
-	if (!file.is_open()) {
-		throw std::runtime_error("[Matrix::write_to_file]Couldn't open the file for writing.");
-	}
-
-	for (size_t i = 0; i < _rows; i++) {
-		for (size_t j = 0; j < _cols; j++) {
-			file << (*this)(i, j) << "\t";
-		}
-		file << "\n";
-	}
-	file.close();
+template <typename T, typename Alloc>
+void M::Matrix<T, Alloc>::write_to_file(const std::string& filename) const {
+	write_text(filename, view());
 }
 
-template<typename T>
-void M::Matrix<T>::print() const 
+template <typename T, typename Alloc>
+void M::Matrix<T, Alloc>::print() const 
 {
 	for(size_t i = 0; i < _rows; i++){
 		for(size_t j = 0; j < _cols; j++){
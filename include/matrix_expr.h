@@ -0,0 +1,328 @@
+#ifndef MATRIX_EXPR_H
+#define MATRIX_EXPR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "allocator.h"
+#include "gemm.h"
+#ifdef _OPENMP
+#include "tuning.h"
+#endif
+
+namespace M
+{
+	template <typename T, typename Alloc>
+	class Matrix;
+
+	// Базовый класс ленивых выражений (CRTP). Выражение ничего не вычисляет,
+	// пока его не присвоят матрице: поэлементные цепочки считаются за один проход,
+	// а A * B + C — одним gemm с накоплением прямо в приёмник.
+	template <typename E>
+	struct MatrixExpr
+	{
+		const E& self() const noexcept
+		{
+			return static_cast<const E&>(*this);
+		}
+	};
+
+	namespace detail
+	{
+		// Лист выражения — ссылка на существующую матрицу с любым аллокатором.
+		template <typename T, typename Alloc>
+		class Leaf
+		{
+		public:
+			using value_type = T;
+			static constexpr bool elementwise = true;
+
+			explicit Leaf(const Matrix<T, Alloc>& matrix) noexcept : _matrix{matrix} { }
+
+			size_t get_rows() const noexcept { return _matrix.get_rows(); }
+			size_t get_cols() const noexcept { return _matrix.get_cols(); }
+			T element(size_t index) const { return _matrix.get_data()[index]; }
+			bool aliases(const T* dst) const noexcept { return _matrix.get_data() == dst; }
+			bool safe_in_place(const T*) const noexcept { return true; }
+			const T* data() const noexcept { return _matrix.get_data(); }
+
+			void assign_to(T* dst) const
+			{
+				if (dst != _matrix.get_data()) {
+					std::copy(_matrix.get_data(), _matrix.get_data() + size(), dst);
+				}
+			}
+
+			void accumulate_into(T* dst) const
+			{
+				const T* src = _matrix.get_data();
+				for (size_t i = 0, n = size(); i < n; ++i) {
+					dst[i] += src[i];
+				}
+			}
+
+		private:
+			size_t size() const noexcept { return get_rows() * get_cols(); }
+
+			const Matrix<T, Alloc>& _matrix;
+		};
+
+		template <typename E>
+		struct Operand
+		{
+			using type = E;
+			static const E& make(const E& expr) noexcept { return expr; }
+		};
+
+		template <typename T, typename Alloc>
+		struct Operand<Matrix<T, Alloc>>
+		{
+			using type = Leaf<T, Alloc>;
+			static Leaf<T, Alloc> make(const Matrix<T, Alloc>& matrix) noexcept { return Leaf<T, Alloc>{matrix}; }
+		};
+
+		template <typename E>
+		struct is_leaf : std::false_type {};
+
+		template <typename T, typename Alloc>
+		struct is_leaf<Leaf<T, Alloc>> : std::true_type {};
+
+		template <typename E>
+		using operand_t = typename Operand<E>::type;
+
+		template <typename E>
+		operand_t<E> make_operand(const MatrixExpr<E>& expr)
+		{
+			return Operand<E>::make(expr.self());
+		}
+
+		// Узел выражения превращается в матрицу, если иначе его не посчитать.
+		template <typename Node>
+		auto materialize(const Node& node)
+		{
+			Matrix<typename Node::value_type, AlignedAllocator<typename Node::value_type>> result(
+				node.get_rows(), node.get_cols());
+			node.assign_to(result.get_data());
+			return result;
+		}
+	}
+
+	// Поэлементная операция над двумя выражениями одинакового размера.
+	template <typename L, typename R, typename Op>
+	class BinaryExpr : public MatrixExpr<BinaryExpr<L, R, Op>>
+	{
+	public:
+		using value_type = typename L::value_type;
+		static constexpr bool elementwise = L::elementwise && R::elementwise;
+		static constexpr bool is_sum = std::is_same_v<Op, std::plus<>>;
+
+		BinaryExpr(const L& lhs, const R& rhs, const char* error) :
+			_lhs{lhs},
+			_rhs{rhs}
+		{
+			if (lhs.get_rows() != rhs.get_rows() || lhs.get_cols() != rhs.get_cols()) {
+				throw std::invalid_argument{error};
+			}
+		}
+
+		size_t get_rows() const noexcept { return _lhs.get_rows(); }
+		size_t get_cols() const noexcept { return _lhs.get_cols(); }
+
+		value_type element(size_t index) const
+		{
+			return Op{}(_lhs.element(index), _rhs.element(index));
+		}
+
+		bool aliases(const value_type* dst) const noexcept
+		{
+			return _lhs.aliases(dst) || _rhs.aliases(dst);
+		}
+
+		// Можно ли писать результат прямо в dst, если dst — один из операндов.
+		bool safe_in_place(const value_type* dst) const noexcept
+		{
+			if constexpr (elementwise) {
+				return true;
+			}
+			else if constexpr (is_sum && !R::elementwise) {
+				return _lhs.safe_in_place(dst) && !_rhs.aliases(dst);
+			}
+			else if constexpr (is_sum && R::elementwise) {
+				return !_lhs.aliases(dst);
+			}
+			else if constexpr (!L::elementwise) {
+				return _lhs.safe_in_place(dst) && (!R::elementwise || !_rhs.aliases(dst));
+			}
+			else {
+				return _rhs.safe_in_place(dst) && !_lhs.aliases(dst);
+			}
+		}
+
+		void assign_to(value_type* dst) const
+		{
+			const size_t size = get_rows() * get_cols();
+			if constexpr (elementwise) {
+				for (size_t i = 0; i < size; ++i) {
+					dst[i] = element(i);
+				}
+			}
+			else if constexpr (is_sum && !R::elementwise) {
+				// X + A * B: сначала X, затем накопление произведения поверх.
+				_lhs.assign_to(dst);
+				_rhs.accumulate_into(dst);
+			}
+			else if constexpr (is_sum && !L::elementwise && R::elementwise) {
+				_rhs.assign_to(dst);
+				_lhs.accumulate_into(dst);
+			}
+			else if constexpr (!L::elementwise && R::elementwise) {
+				_lhs.assign_to(dst);
+				for (size_t i = 0; i < size; ++i) {
+					dst[i] = Op{}(dst[i], _rhs.element(i));
+				}
+			}
+			else if constexpr (L::elementwise) {
+				_rhs.assign_to(dst);
+				for (size_t i = 0; i < size; ++i) {
+					dst[i] = Op{}(_lhs.element(i), dst[i]);
+				}
+			}
+			else {
+				const auto rhs = detail::materialize(_rhs);
+				_lhs.assign_to(dst);
+				const value_type* src = rhs.get_data();
+				for (size_t i = 0; i < size; ++i) {
+					dst[i] = Op{}(dst[i], src[i]);
+				}
+			}
+		}
+
+		void accumulate_into(value_type* dst) const
+		{
+			const size_t size = get_rows() * get_cols();
+			if constexpr (elementwise) {
+				for (size_t i = 0; i < size; ++i) {
+					dst[i] += element(i);
+				}
+			}
+			else if constexpr (is_sum) {
+				_lhs.accumulate_into(dst);
+				_rhs.accumulate_into(dst);
+			}
+			else {
+				const auto value = detail::materialize(*this);
+				const value_type* src = value.get_data();
+				for (size_t i = 0; i < size; ++i) {
+					dst[i] += src[i];
+				}
+			}
+		}
+
+	private:
+		L _lhs;
+		R _rhs;
+	};
+
+	// Ленивое произведение. Операнды-выражения вычисляются один раз при построении.
+	template <typename T>
+	class ProductExpr : public MatrixExpr<ProductExpr<T>>
+	{
+	public:
+		using value_type = T;
+		static constexpr bool elementwise = false;
+
+		template <typename L, typename R>
+		ProductExpr(const L& lhs, const R& rhs) :
+			_m{lhs.get_rows()},
+			_k{lhs.get_cols()},
+			_n{rhs.get_cols()},
+			_lhs{hold(lhs, _lhs_owned)},
+			_rhs{hold(rhs, _rhs_owned)}
+		{
+			if (lhs.get_cols() != rhs.get_rows()) {
+				throw std::invalid_argument{"Failed to multiply matrices"};
+			}
+		}
+
+		size_t get_rows() const noexcept { return _m; }
+		size_t get_cols() const noexcept { return _n; }
+
+		bool aliases(const T* dst) const noexcept
+		{
+			return _lhs == dst || _rhs == dst;
+		}
+
+		bool safe_in_place(const T* dst) const noexcept
+		{
+			return !aliases(dst);
+		}
+
+		void assign_to(T* dst) const
+		{
+			std::fill(dst, dst + _m * _n, T{});
+			accumulate_into(dst);
+		}
+
+		// С OpenMP произведение берёт потоки и плитки из кэша подбора (tuning.h).
+		void accumulate_into(T* dst) const
+		{
+#ifdef _OPENMP
+			tuned_gemm(ConstMatrixView<T>(_lhs, _m, _k), ConstMatrixView<T>(_rhs, _k, _n), MatrixView<T>(dst, _m, _n));
+#else
+			gemm(_m, _n, _k, _lhs, _k, _rhs, _n, dst, _n);
+#endif
+		}
+
+	private:
+		template <typename E>
+		static const T* hold(const E& expr, std::shared_ptr<const std::vector<T>>& owned)
+		{
+			if constexpr (detail::is_leaf<E>::value) {
+				return expr.data();
+			}
+			else {
+				auto values = std::make_shared<std::vector<T>>(expr.get_rows() * expr.get_cols());
+				expr.assign_to(values->data());
+				owned = std::move(values);
+				return owned->data();
+			}
+		}
+
+		size_t _m, _k, _n;
+		std::shared_ptr<const std::vector<T>> _lhs_owned, _rhs_owned;
+		const T* _lhs;
+		const T* _rhs;
+	};
+
+	template <typename L, typename R>
+	auto operator+(const MatrixExpr<L>& lhs, const MatrixExpr<R>& rhs)
+	{
+		using LO = detail::operand_t<L>;
+		using RO = detail::operand_t<R>;
+		return BinaryExpr<LO, RO, std::plus<>>{detail::make_operand(lhs), detail::make_operand(rhs),
+			"Failed to sum matrices"};
+	}
+
+	template <typename L, typename R>
+	auto operator-(const MatrixExpr<L>& lhs, const MatrixExpr<R>& rhs)
+	{
+		using LO = detail::operand_t<L>;
+		using RO = detail::operand_t<R>;
+		return BinaryExpr<LO, RO, std::minus<>>{detail::make_operand(lhs), detail::make_operand(rhs),
+			"Failed to subtruct matrices"};
+	}
+
+	template <typename L, typename R>
+	auto operator*(const MatrixExpr<L>& lhs, const MatrixExpr<R>& rhs)
+	{
+		using T = typename detail::operand_t<L>::value_type;
+		return ProductExpr<T>{detail::make_operand(lhs), detail::make_operand(rhs)};
+	}
+}
+
+#endif // MATRIX_EXPR_H
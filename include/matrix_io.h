@@ -0,0 +1,501 @@
+#ifndef MATRIX_IO_H
+#define MATRIX_IO_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "matrix.h"
+#include "matrix_view.h"
+#include "text_io.h"
+#include "trace.h"
+
+// Бинарный формат — это NumPy .npy версии 1.0: магическая строка, длина заголовка,
+// словарь с dtype и формой (rows, cols), дополненный пробелами до кратности 64 байтам,
+// и затем построчные данные без разделителей. Файл открывается через np.load(path, mmap_mode='r').
+namespace M
+{
+	constexpr size_t NPY_ALIGNMENT = 64;
+
+	template <typename T>
+	void write_binary(const std::string& filename, ConstMatrixView<T> matrix);
+
+	template <typename T, typename Alloc>
+	void write_binary(const std::string& filename, const Matrix<T, Alloc>& matrix);
+
+	// Матрица только для чтения, отображённая из файла в память. Данные не копируются.
+	template <typename T>
+	class MappedMatrix
+	{
+	public:
+		explicit MappedMatrix(const std::string& filename);
+		MappedMatrix(MappedMatrix&& other) noexcept;
+		MappedMatrix& operator=(MappedMatrix&& other) noexcept;
+		MappedMatrix(const MappedMatrix&) = delete;
+		MappedMatrix& operator=(const MappedMatrix&) = delete;
+		~MappedMatrix();
+
+		size_t get_rows() const noexcept;
+		size_t get_cols() const noexcept;
+		const T* get_data() const noexcept;
+		ConstMatrixView<T> view() const noexcept;
+
+		const T& operator()(size_t row, size_t column) const;
+
+	private:
+		void unmap() noexcept;
+
+		const char* _mapping = nullptr;
+		size_t _mapping_size = 0;
+		const T* _data = nullptr;
+		size_t _rows = 0, _cols = 0;
+#ifdef _WIN32
+		HANDLE _file = INVALID_HANDLE_VALUE;
+		HANDLE _map = nullptr;
+#endif
+	};
+
+	// Чтение с копированием в обычную матрицу.
+	template <typename T, typename Alloc = AlignedAllocator<T>>
+	Matrix<T, Alloc> read_binary(const std::string& filename);
+
+	// Чтение текстового файла в раскладке write_text. Число столбцов берётся из первой строки
+	// (или из заголовка), строки разбираются параллельно через from_chars.
+	// Разделителем считается любой пробельный символ, так что separator из layout не важен.
+	template <typename T, typename Alloc = AlignedAllocator<T>>
+	Matrix<T, Alloc> read_text(const std::string& filename, TextLayout layout = {}, int threads = 1);
+
+	namespace detail
+	{
+		constexpr char NPY_MAGIC[] = "\x93NUMPY";
+		constexpr size_t NPY_PREAMBLE = 10; // магия (6) + версия (2) + длина заголовка (2)
+
+		template <typename T>
+		std::string npy_descr()
+		{
+			static_assert(std::is_arithmetic_v<T>, "Only arithmetic element types can be stored");
+			const char kind = std::is_floating_point_v<T> ? 'f' : (std::is_signed_v<T> ? 'i' : 'u');
+			const char order = sizeof(T) == 1 ? '|' : '<';
+			return std::string{order} + kind + std::to_string(sizeof(T));
+		}
+
+		template <typename T>
+		std::string npy_header(size_t rows, size_t cols)
+		{
+			std::string dict = "{'descr': '" + npy_descr<T>() + "', 'fortran_order': False, 'shape': (" +
+				std::to_string(rows) + ", " + std::to_string(cols) + "), }";
+			const size_t unpadded = NPY_PREAMBLE + dict.size() + 1;
+			dict.append((NPY_ALIGNMENT - unpadded % NPY_ALIGNMENT) % NPY_ALIGNMENT, ' ');
+			dict.push_back('\n');
+
+			std::string header(NPY_MAGIC, 6);
+			header.push_back('\x01');
+			header.push_back('\x00');
+			header.push_back(static_cast<char>(dict.size() & 0xff));
+			header.push_back(static_cast<char>((dict.size() >> 8) & 0xff));
+			return header + dict;
+		}
+
+		// Длина преамбулы и словаря: в версии 1.0 длина словаря занимает 2 байта, в 2.0 и 3.0 — 4.
+		inline std::pair<size_t, size_t> npy_header_span(const char* bytes) noexcept
+		{
+			size_t header_len = 0;
+			if (static_cast<unsigned char>(bytes[6]) == 1) {
+				header_len = static_cast<unsigned char>(bytes[8]) | static_cast<unsigned char>(bytes[9]) << 8;
+				return {NPY_PREAMBLE, header_len};
+			}
+			for (int i = 3; i >= 0; --i) {
+				header_len = header_len << 8 | static_cast<unsigned char>(bytes[8 + i]);
+			}
+			return {NPY_PREAMBLE + 2, header_len};
+		}
+
+		// Разбор заголовка: возвращает смещение данных, проверяет dtype и порядок.
+		template <typename T>
+		size_t parse_npy_header(const char* bytes, size_t size, size_t& rows, size_t& cols)
+		{
+			if (size < NPY_PREAMBLE || std::memcmp(bytes, NPY_MAGIC, 6) != 0) {
+				throw std::runtime_error("[MappedMatrix]Not an .npy file.");
+			}
+			const auto [preamble, header_len] = npy_header_span(bytes);
+			if (preamble + header_len > size) {
+				throw std::runtime_error("[MappedMatrix]Truncated .npy header.");
+			}
+
+			const std::string header(bytes + preamble, header_len);
+			if (header.find("'descr': '" + npy_descr<T>() + "'") == std::string::npos) {
+				throw std::runtime_error("[MappedMatrix]Element type does not match the file.");
+			}
+			if (header.find("'fortran_order': False") == std::string::npos) {
+				throw std::runtime_error("[MappedMatrix]Only row-major files are supported.");
+			}
+			const size_t shape = header.find("'shape': (");
+			if (shape == std::string::npos) {
+				throw std::runtime_error("[MappedMatrix]Missing shape in .npy header.");
+			}
+			// (rows,), (rows, cols) или (rows, cols,); третье измерение дальше не проходит.
+			char* end = nullptr;
+			rows = std::strtoull(header.c_str() + shape + 10, &end, 10);
+			cols = 1;
+			if (*end == ',') {
+				while (*++end == ' ') { }
+				if (*end != ')') {
+					cols = std::strtoull(end, &end, 10);
+					if (*end == ',') {
+						while (*++end == ' ') { }
+					}
+				}
+			}
+			if (*end != ')') {
+				throw std::runtime_error("[MappedMatrix]Only one- and two-dimensional arrays are supported.");
+			}
+			if (cols != 0 && rows > std::numeric_limits<size_t>::max() / sizeof(T) / cols) {
+				throw std::runtime_error("[MappedMatrix]The .npy shape is too large.");
+			}
+
+			const size_t offset = preamble + header_len;
+			if (rows * cols * sizeof(T) > size - offset) {
+				throw std::runtime_error("[MappedMatrix]Truncated .npy data.");
+			}
+			return offset;
+		}
+
+		inline bool is_text_space(char c) noexcept
+		{
+			return c == ' ' || c == '\t' || c == '\r';
+		}
+
+		template <typename T>
+		const char* parse_value(const char* first, const char* last, T& value)
+		{
+			while (first != last && is_text_space(*first)) {
+				++first;
+			}
+			if (first != last && *first == '+') {
+				++first;
+			}
+			const auto [ptr, ec] = std::from_chars(first, last, value);
+			return ec == std::errc{} ? ptr : nullptr;
+		}
+
+		// Разбирает одну строку [first, last) ровно в cols значений, разделители — пробелы и табы.
+		template <typename T>
+		bool parse_row(const char* first, const char* last, T* out, size_t cols)
+		{
+			for (size_t j = 0; j < cols; ++j) {
+				first = parse_value(first, last, out[j]);
+				if (first == nullptr || (first != last && !is_text_space(*first))) {
+					return false;
+				}
+			}
+			while (first != last && is_text_space(*first)) {
+				++first;
+			}
+			return first == last;
+		}
+
+		// Останавливается на первом непробельном символе, так что строка с данными проверяется за O(1).
+		inline bool is_blank_line(const char* first, const char* last) noexcept
+		{
+			while (first != last && is_text_space(*first)) {
+				++first;
+			}
+			return first == last;
+		}
+
+		inline size_t count_values(const char* first, const char* last)
+		{
+			size_t count = 0;
+			while (first != last) {
+				while (first != last && is_text_space(*first)) {
+					++first;
+				}
+				if (first == last) {
+					break;
+				}
+				++count;
+				while (first != last && !is_text_space(*first)) {
+					++first;
+				}
+			}
+			return count;
+		}
+
+		inline std::vector<char> read_whole_file(const std::string& filename)
+		{
+			std::unique_ptr<std::FILE, FileCloser> file{std::fopen(filename.c_str(), "rb")};
+			if (!file) {
+				throw std::runtime_error("[read_text]Couldn't open the file for reading.");
+			}
+			std::vector<char> bytes;
+			std::fseek(file.get(), 0, SEEK_END);
+			const long size = std::ftell(file.get());
+			std::fseek(file.get(), 0, SEEK_SET);
+			if (size > 0) {
+				bytes.resize(static_cast<size_t>(size));
+				if (std::fread(bytes.data(), 1, bytes.size(), file.get()) != bytes.size()) {
+					throw std::runtime_error("[read_text]Failed to read the file.");
+				}
+			}
+			return bytes;
+		}
+	}
+}
+
+template <typename T>
+void M::write_binary(const std::string& filename, ConstMatrixView<T> matrix)
+{
+	M_TRACE_SCOPE("write_binary");
+	std::ofstream file(filename, std::ios::binary);
+	if (!file.is_open()) {
+		throw std::runtime_error("[write_binary]Couldn't open the file for writing.");
+	}
+
+	const std::string header = detail::npy_header<T>(matrix.get_rows(), matrix.get_cols());
+	file.write(header.data(), static_cast<std::streamsize>(header.size()));
+	if (matrix.is_contiguous()) {
+		file.write(reinterpret_cast<const char*>(matrix.get_data()),
+			static_cast<std::streamsize>(matrix.get_rows() * matrix.get_cols() * sizeof(T)));
+	}
+	else {
+		for (size_t i = 0; i < matrix.get_rows(); ++i) {
+			file.write(reinterpret_cast<const char*>(matrix.row(i)),
+				static_cast<std::streamsize>(matrix.get_cols() * sizeof(T)));
+		}
+	}
+	if (!file) {
+		throw std::runtime_error("[write_binary]Failed to write the file.");
+	}
+}
+
+template <typename T, typename Alloc>
+void M::write_binary(const std::string& filename, const Matrix<T, Alloc>& matrix)
+{
+	write_binary<T>(filename, matrix.view());
+}
+
+template <typename T>
+M::MappedMatrix<T>::MappedMatrix(const std::string& filename)
+{
+#ifdef _WIN32
+	_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_file == INVALID_HANDLE_VALUE) {
+		throw std::runtime_error("[MappedMatrix]Couldn't open the file for reading.");
+	}
+	LARGE_INTEGER size;
+	GetFileSizeEx(_file, &size);
+	_mapping_size = static_cast<size_t>(size.QuadPart);
+	_map = CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	_mapping = _map ? static_cast<const char*>(MapViewOfFile(_map, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+	if (_mapping == nullptr) {
+		unmap();
+		throw std::runtime_error("[MappedMatrix]Couldn't map the file.");
+	}
+#else
+	const int fd = open(filename.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error("[MappedMatrix]Couldn't open the file for reading.");
+	}
+	struct stat info;
+	if (fstat(fd, &info) != 0) {
+		close(fd);
+		throw std::runtime_error("[MappedMatrix]Couldn't stat the file.");
+	}
+	_mapping_size = static_cast<size_t>(info.st_size);
+	void* mapping = mmap(nullptr, _mapping_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		throw std::runtime_error("[MappedMatrix]Couldn't map the file.");
+	}
+	_mapping = static_cast<const char*>(mapping);
+#endif
+
+	try {
+		const size_t offset = detail::parse_npy_header<T>(_mapping, _mapping_size, _rows, _cols);
+		_data = reinterpret_cast<const T*>(_mapping + offset);
+	}
+	catch (...) {
+		unmap();
+		throw;
+	}
+}
+
+template <typename T>
+M::MappedMatrix<T>::MappedMatrix(MappedMatrix&& other) noexcept :
+	_mapping{std::exchange(other._mapping, nullptr)},
+	_mapping_size{std::exchange(other._mapping_size, 0)},
+	_data{std::exchange(other._data, nullptr)},
+	_rows{std::exchange(other._rows, 0)},
+	_cols{std::exchange(other._cols, 0)}
+#ifdef _WIN32
+	, _file{std::exchange(other._file, INVALID_HANDLE_VALUE)},
+	_map{std::exchange(other._map, nullptr)}
+#endif
+{ }
+
+template <typename T>
+M::MappedMatrix<T>& M::MappedMatrix<T>::operator=(MappedMatrix&& other) noexcept
+{
+	if (this != &other) {
+		unmap();
+		_mapping = std::exchange(other._mapping, nullptr);
+		_mapping_size = std::exchange(other._mapping_size, 0);
+		_data = std::exchange(other._data, nullptr);
+		_rows = std::exchange(other._rows, 0);
+		_cols = std::exchange(other._cols, 0);
+#ifdef _WIN32
+		_file = std::exchange(other._file, INVALID_HANDLE_VALUE);
+		_map = std::exchange(other._map, nullptr);
+#endif
+	}
+	return *this;
+}
+
+template <typename T>
+M::MappedMatrix<T>::~MappedMatrix()
+{
+	unmap();
+}
+
+template <typename T>
+void M::MappedMatrix<T>::unmap() noexcept
+{
+#ifdef _WIN32
+	if (_mapping) UnmapViewOfFile(_mapping);
+	if (_map) CloseHandle(_map);
+	if (_file != INVALID_HANDLE_VALUE) CloseHandle(_file);
+	_map = nullptr;
+	_file = INVALID_HANDLE_VALUE;
+#else
+	if (_mapping) munmap(const_cast<char*>(_mapping), _mapping_size);
+#endif
+	_mapping = nullptr;
+	_data = nullptr;
+}
+
+template <typename T>
+size_t M::MappedMatrix<T>::get_rows() const noexcept
+{
+	return _rows;
+}
+
+template <typename T>
+size_t M::MappedMatrix<T>::get_cols() const noexcept
+{
+	return _cols;
+}
+
+template <typename T>
+const T* M::MappedMatrix<T>::get_data() const noexcept
+{
+	return _data;
+}
+
+template <typename T>
+M::ConstMatrixView<T> M::MappedMatrix<T>::view() const noexcept
+{
+	return {_data, _rows, _cols};
+}
+
+template <typename T>
+const T& M::MappedMatrix<T>::operator()(size_t row, size_t column) const
+{
+	return _data[row * _cols + column];
+}
+
+template <typename T, typename Alloc>
+M::Matrix<T, Alloc> M::read_binary(const std::string& filename)
+{
+	M_TRACE_SCOPE("read_binary");
+	const MappedMatrix<T> mapped(filename);
+	return Matrix<T, Alloc>(mapped.get_rows(), mapped.get_cols(), mapped.get_data());
+}
+
+template <typename T, typename Alloc>
+M::Matrix<T, Alloc> M::read_text(const std::string& filename, TextLayout layout, [[maybe_unused]] int threads)
+{
+	M_TRACE_SCOPE("read_text");
+	const std::vector<char> bytes = detail::read_whole_file(filename);
+	const char* const begin = bytes.data();
+	const char* const end = begin + bytes.size();
+
+	// Индекс строк строится последовательно только по memchr, пустые строки пропускаются.
+	// Значения считаются лишь в первой строке, число столбцов остальных проверяет parse_row.
+	std::vector<std::pair<const char*, const char*>> lines;
+	for (const char* pos = begin; pos < end;) {
+		const char* eol = static_cast<const char*>(std::memchr(pos, '\n', static_cast<size_t>(end - pos)));
+		if (eol == nullptr) {
+			eol = end;
+		}
+		if (!detail::is_blank_line(pos, eol)) {
+			lines.emplace_back(pos, eol);
+		}
+		pos = eol + 1;
+	}
+
+	size_t rows = lines.size();
+	size_t cols = lines.empty() ? 0 : detail::count_values(lines[0].first, lines[0].second);
+	size_t first_line = 0;
+	if (layout.header) {
+		if (lines.empty() || detail::count_values(lines[0].first, lines[0].second) != 2) {
+			throw std::runtime_error("[read_text]Missing \"rows cols\" header.");
+		}
+		const char* pos = detail::parse_value(lines[0].first, lines[0].second, rows);
+		pos = pos ? detail::parse_value(pos, lines[0].second, cols) : nullptr;
+		if (pos == nullptr) {
+			throw std::runtime_error("[read_text]Malformed header.");
+		}
+		first_line = 1;
+		if (lines.size() - 1 != rows) {
+			throw std::runtime_error("[read_text]Row count does not match the header.");
+		}
+	}
+
+	Matrix<T, Alloc> result(rows, cols);
+	const MatrixView<T> out = result.view();
+	long bad_row = -1;
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+#endif
+	for (long i = 0; i < static_cast<long>(rows); ++i) {
+		const auto& [first, last] = lines[first_line + i];
+		if (!detail::parse_row(first, last, out.row(i), cols)) {
+#ifdef _OPENMP
+#pragma omp critical(read_text_error)
+#endif
+			if (bad_row < 0 || i < bad_row) {
+				bad_row = i;
+			}
+		}
+	}
+
+	if (bad_row >= 0) {
+		throw std::runtime_error("[read_text]Malformed row " + std::to_string(bad_row + 1) + ".");
+	}
+	return result;
+}
+
+#endif // MATRIX_IO_H
@@ -0,0 +1,161 @@
+#ifndef MATRIX_VIEW_H
+#define MATRIX_VIEW_H
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+
+namespace M
+{
+	// Невладеющее окно в построчную матрицу: указатель, размеры и длина строки в памяти (ld).
+	// MatrixView<T> разрешает запись, MatrixView<const T> — только чтение.
+	template <typename T>
+	class MatrixView
+	{
+	public:
+		using value_type = std::remove_const_t<T>;
+
+		MatrixView() noexcept = default;
+		MatrixView(T* data, size_t rows, size_t cols) noexcept;
+		MatrixView(T* data, size_t rows, size_t cols, size_t ld) noexcept;
+		template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+		MatrixView(const MatrixView<U>& other) noexcept;
+
+		size_t get_rows() const noexcept;
+		size_t get_cols() const noexcept;
+		size_t get_ld() const noexcept;
+		T* get_data() const noexcept;
+		T* row(size_t r) const noexcept;
+		bool is_contiguous() const noexcept;
+
+		T& operator()(size_t row, size_t column) const;
+
+		// Подматрица h x w с левым верхним углом (r, c), данные не копируются.
+		MatrixView<T> block(size_t r, size_t c, size_t h, size_t w) const;
+		MatrixView<T> row_panel(size_t r, size_t h) const;
+
+	private:
+		T* _data = nullptr;
+		size_t _rows = 0, _cols = 0, _ld = 0;
+	};
+
+	template <typename T>
+	using ConstMatrixView = MatrixView<const T>;
+
+	namespace detail
+	{
+		// Тип элемента выводится только из изменяемого аргумента,
+		// а MatrixView<T> в позицию ConstMatrixView<T> подставляется неявно.
+		template <typename T>
+		struct NoDeduce
+		{
+			using type = T;
+		};
+
+		template <typename T>
+		using no_deduce_t = typename NoDeduce<T>::type;
+	}
+
+	// dst = src^T, обход блоками, чтобы и чтение, и запись шли по кэш-линиям.
+	template <typename T>
+	void transpose(ConstMatrixView<detail::no_deduce_t<T>> src, MatrixView<T> dst);
+}
+
+template <typename T>
+M::MatrixView<T>::MatrixView(T* data, size_t rows, size_t cols) noexcept :
+	MatrixView{data, rows, cols, cols}
+{ }
+
+template <typename T>
+M::MatrixView<T>::MatrixView(T* data, size_t rows, size_t cols, size_t ld) noexcept :
+	_data{data},
+	_rows{rows},
+	_cols{cols},
+	_ld{ld}
+{ }
+
+template <typename T>
+template <typename U, typename>
+M::MatrixView<T>::MatrixView(const MatrixView<U>& other) noexcept :
+	MatrixView{other.get_data(), other.get_rows(), other.get_cols(), other.get_ld()}
+{ }
+
+template <typename T>
+size_t M::MatrixView<T>::get_rows() const noexcept
+{
+	return _rows;
+}
+
+template <typename T>
+size_t M::MatrixView<T>::get_cols() const noexcept
+{
+	return _cols;
+}
+
+template <typename T>
+size_t M::MatrixView<T>::get_ld() const noexcept
+{
+	return _ld;
+}
+
+template <typename T>
+T* M::MatrixView<T>::get_data() const noexcept
+{
+	return _data;
+}
+
+template <typename T>
+T* M::MatrixView<T>::row(size_t r) const noexcept
+{
+	return _data + r * _ld;
+}
+
+template <typename T>
+bool M::MatrixView<T>::is_contiguous() const noexcept
+{
+	return _ld == _cols || _rows <= 1;
+}
+
+template <typename T>
+T& M::MatrixView<T>::operator()(size_t row, size_t column) const
+{
+	return _data[row * _ld + column];
+}
+
+template <typename T>
+M::MatrixView<T> M::MatrixView<T>::block(size_t r, size_t c, size_t h, size_t w) const
+{
+	if (r + h > _rows || c + w > _cols) {
+		throw std::out_of_range{"[MatrixView::block]Block is out of the matrix bounds."};
+	}
+	return {_data + r * _ld + c, h, w, _ld};
+}
+
+template <typename T>
+M::MatrixView<T> M::MatrixView<T>::row_panel(size_t r, size_t h) const
+{
+	return block(r, 0, h, _cols);
+}
+
+template <typename T>
+void M::transpose(ConstMatrixView<detail::no_deduce_t<T>> src, MatrixView<T> dst)
+{
+	if (src.get_rows() != dst.get_cols() || src.get_cols() != dst.get_rows()) {
+		throw std::invalid_argument{"Failed to transpose matrix"};
+	}
+	constexpr size_t TILE = 32;
+	for (size_t ib = 0; ib < src.get_rows(); ib += TILE) {
+		const size_t ie = std::min(ib + TILE, src.get_rows());
+		for (size_t jb = 0; jb < src.get_cols(); jb += TILE) {
+			const size_t je = std::min(jb + TILE, src.get_cols());
+			for (size_t i = ib; i < ie; ++i) {
+				for (size_t j = jb; j < je; ++j) {
+					dst(j, i) = src(i, j);
+				}
+			}
+		}
+	}
+}
+
+#endif // MATRIX_VIEW_H
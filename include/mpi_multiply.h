@@ -0,0 +1,107 @@
+#ifndef MPI_MULTIPLY_H
+#define MPI_MULTIPLY_H
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include <mpi.h>
+
+#include "matrix.h"
+#include "matrix_view.h"
+#include "mpi_types.h"
+#include "omp_gemm.h"
+#include "trace.h"
+
+namespace M
+{
+	// 1D-распределение по строкам: полосы A расходятся через Scatterv, B — одним Bcast,
+	// полосы C собираются Gatherv прямо в result. A, B и result читаются только на root (ранг 0 в comm),
+	// остальные ранги получают размеры от root и держат только свою полосу A, B и полосу C.
+	// Локальная полоса считается omp_gemm на threads потоках; MPI вызывается только вне
+	// параллельных областей, так что достаточно MPI_THREAD_FUNNELED.
+	template <typename T>
+	void scatter_multiply(ConstMatrixView<detail::no_deduce_t<T>> A, ConstMatrixView<detail::no_deduce_t<T>> B,
+		MatrixView<T> result, MPI_Comm comm, int threads = 1);
+}
+
+template <typename T>
+void M::scatter_multiply(ConstMatrixView<detail::no_deduce_t<T>> A, ConstMatrixView<detail::no_deduce_t<T>> B,
+	MatrixView<T> result, MPI_Comm comm, int threads)
+{
+	int rank, num_procs;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &num_procs);
+
+	unsigned long long dims[3] = {A.get_rows(), A.get_cols(), B.get_cols()};
+	MPI_Bcast(dims, 3, MPI_UNSIGNED_LONG_LONG, 0, comm);
+	const size_t rows = dims[0], inner = dims[1], cols = dims[2];
+
+	std::vector<int> counts(num_procs), displs(num_procs);
+	for (int r = 0, first = 0; r < num_procs; ++r) {
+		counts[r] = static_cast<int>(rows / num_procs + (static_cast<size_t>(r) < rows % num_procs ? 1 : 0));
+		displs[r] = first;
+		first += counts[r];
+	}
+	const size_t local_rows = counts[rank];
+
+	Matrix<T> local_b{};
+	ConstMatrixView<T> b = B;
+	{
+		M_TRACE_SCOPE("bcast B");
+		if (rank == 0) {
+			int count;
+			MPI_Datatype type = view_type(B, count);
+			MPI_Bcast(const_cast<T*>(B.get_data()), count, type, 0, comm);
+			if (!B.is_contiguous()) {
+				MPI_Type_free(&type);
+			}
+		}
+		else {
+			local_b = Matrix<T>(inner, cols);
+			MPI_Bcast(local_b.get_data(), static_cast<int>(inner * cols), mpi_type<T>(), 0, comm);
+			b = local_b.view();
+		}
+	}
+
+	if (rank == 0) {
+		// Своя полоса root остаётся на месте (MPI_IN_PLACE) и считается прямо в result.
+		MPI_Datatype a_row = row_type<T>(inner, A.get_ld());
+		{
+			M_TRACE_SCOPE("scatter A");
+			MPI_Scatterv(A.get_data(), counts.data(), displs.data(), a_row,
+				MPI_IN_PLACE, 0, a_row, 0, comm);
+		}
+		MPI_Type_free(&a_row);
+
+		const MatrixView<T> own = result.row_panel(0, local_rows);
+		for (size_t i = 0; i < local_rows; ++i) {
+			std::fill(own.row(i), own.row(i) + cols, T{});
+		}
+		omp_gemm(A.row_panel(0, local_rows), b, own, threads);
+
+		MPI_Datatype c_row = row_type<T>(cols, result.get_ld());
+		{
+			M_TRACE_SCOPE("gather C");
+			MPI_Gatherv(MPI_IN_PLACE, 0, c_row, result.get_data(), counts.data(), displs.data(), c_row, 0, comm);
+		}
+		MPI_Type_free(&c_row);
+	}
+	else {
+		Matrix<T> local_a(local_rows, inner);
+		{
+			M_TRACE_SCOPE("scatter A");
+			MPI_Scatterv(nullptr, nullptr, nullptr, mpi_type<T>(), local_a.get_data(),
+				static_cast<int>(local_rows * inner), mpi_type<T>(), 0, comm);
+		}
+
+		Matrix<T> local_c(local_rows, cols);
+		omp_gemm(local_a.view(), b, local_c.view(), threads);
+
+		M_TRACE_SCOPE("gather C");
+		MPI_Gatherv(local_c.get_data(), static_cast<int>(local_rows * cols), mpi_type<T>(),
+			nullptr, nullptr, nullptr, mpi_type<T>(), 0, comm);
+	}
+}
+
+#endif // MPI_MULTIPLY_H
@@ -0,0 +1,59 @@
+#ifndef MPI_TYPES_H
+#define MPI_TYPES_H
+
+#include <cstdint>
+#include <type_traits>
+
+#include <mpi.h>
+
+#include "matrix_view.h"
+
+namespace M
+{
+	// Встроенный тип MPI для элемента матрицы.
+	template <typename T>
+	MPI_Datatype mpi_type()
+	{
+		if constexpr (std::is_same_v<T, int>) return MPI_INT;
+		else if constexpr (std::is_same_v<T, float>) return MPI_FLOAT;
+		else if constexpr (std::is_same_v<T, double>) return MPI_DOUBLE;
+		else if constexpr (std::is_same_v<T, int8_t>) return MPI_INT8_T;
+		else if constexpr (std::is_same_v<T, int16_t>) return MPI_INT16_T;
+		else if constexpr (std::is_same_v<T, int64_t>) return MPI_INT64_T;
+		else if constexpr (std::is_same_v<T, uint64_t>) return MPI_UINT64_T;
+		else static_assert(std::is_same_v<T, void>, "No MPI datatype for this element type");
+	}
+
+	// Тип MPI для представления: непрерывное — просто rows * cols элементов,
+	// блок с ld > cols — векторный тип с шагом ld, без промежуточного буфера.
+	// Производный тип (count == 1) освобождается вызывающим через MPI_Type_free.
+	template <typename T>
+	MPI_Datatype view_type(ConstMatrixView<T> view, int& count)
+	{
+		if (view.is_contiguous()) {
+			count = static_cast<int>(view.get_rows() * view.get_cols());
+			return mpi_type<T>();
+		}
+		MPI_Datatype type;
+		MPI_Type_vector(static_cast<int>(view.get_rows()), static_cast<int>(view.get_cols()),
+			static_cast<int>(view.get_ld()), mpi_type<T>(), &type);
+		MPI_Type_commit(&type);
+		count = 1;
+		return type;
+	}
+
+	// Строка матрицы с шагом ld: counts и displs в Scatterv/Gatherv задаются в строках,
+	// а представления с ld != cols передаются без упаковки.
+	template <typename T>
+	MPI_Datatype row_type(size_t cols, size_t ld)
+	{
+		MPI_Datatype row, resized;
+		MPI_Type_contiguous(static_cast<int>(cols), mpi_type<T>(), &row);
+		MPI_Type_create_resized(row, 0, static_cast<MPI_Aint>(ld * sizeof(T)), &resized);
+		MPI_Type_commit(&resized);
+		MPI_Type_free(&row);
+		return resized;
+	}
+}
+
+#endif // MPI_TYPES_H
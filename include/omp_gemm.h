@@ -0,0 +1,235 @@
+#ifndef OMP_GEMM_H
+#define OMP_GEMM_H
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "gemm.h"
+#include "matrix_view.h"
+#include "simd_kernels.h"
+#include "trace.h"
+
+namespace M
+{
+	enum class OmpSchedule { Static, Dynamic, Guided };
+
+	// Rows — полосы строк C во всю ширину, Tiles — 2D-плитки C (collapse(2)),
+	// TaskLoop — те же плитки, но раздаются через taskloop.
+	enum class OmpDecomposition { Rows, Tiles, TaskLoop };
+
+	// Нулевые chunk и размеры плиток означают «подобрать автоматически».
+	struct OmpGemmConfig
+	{
+		OmpDecomposition decomposition = OmpDecomposition::Tiles;
+		OmpSchedule schedule = OmpSchedule::Static;
+		int chunk = 0;
+		size_t tile_m = 0, tile_n = 0;
+	};
+
+	OmpSchedule parse_schedule(const std::string& name);
+	OmpDecomposition parse_decomposition(const std::string& name);
+	std::string to_string(OmpSchedule schedule);
+	std::string to_string(OmpDecomposition decomposition);
+
+	// C(m x n) += A(m x k) * B(k x n). Каждая плитка C считается одним потоком целиком
+	// со своими буферами упаковки A и B, поэтому потоки не ждут друг друга между панелями k.
+	template <typename T>
+	void omp_gemm(ConstMatrixView<detail::no_deduce_t<T>> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+		MatrixView<T> c, int threads, const OmpGemmConfig& config = {});
+
+	namespace detail
+	{
+		// Плитки уменьшаются, пока их не станет хотя бы TILES_PER_THREAD на поток.
+		constexpr size_t TILES_PER_THREAD = 4;
+		// Плитка по умолчанию крупнее блока gemm: B упаковывается заново для каждой строки плиток.
+		constexpr size_t DEFAULT_TILE_M = 256;
+		constexpr size_t DEFAULT_TILE_N = 512;
+
+		inline size_t ceil_div(size_t value, size_t step) noexcept
+		{
+			return (value + step - 1) / step;
+		}
+
+		struct TileShape
+		{
+			size_t tm, tn;
+		};
+
+		// Размеры плиток кратны MR/NR, для Rows плитка занимает всю ширину C.
+		template <typename T>
+		TileShape choose_tiles(size_t m, size_t n, int threads, const OmpGemmConfig& config,
+			const MicroKernel<T>& kernel)
+		{
+			size_t tm = round_up(config.tile_m ? config.tile_m : DEFAULT_TILE_M, kernel.mr);
+			size_t tn = config.decomposition == OmpDecomposition::Rows ? n
+				: config.tile_n ? round_up(config.tile_n, kernel.nr) : round_up(DEFAULT_TILE_N, kernel.nr);
+			const size_t wanted = TILES_PER_THREAD * static_cast<size_t>(std::max(threads, 1));
+			if (!config.tile_m) {
+				while (tm > kernel.mr && ceil_div(m, tm) * ceil_div(n, tn) < wanted) {
+					tm = std::max(kernel.mr, round_up(tm / 2, kernel.mr));
+				}
+			}
+			if (!config.tile_n && config.decomposition != OmpDecomposition::Rows) {
+				while (tn > kernel.nr && ceil_div(m, tm) * ceil_div(n, tn) < wanted) {
+					tn = std::max(kernel.nr, round_up(tn / 2, kernel.nr));
+				}
+			}
+			return {std::min(tm, round_up(m, kernel.mr)), std::min(tn, round_up(n, kernel.nr))};
+		}
+
+		template <typename T>
+		void compute_tile(const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+			size_t mt, size_t nt, size_t k, size_t kc_max, const MicroKernel<T>& kernel)
+		{
+			M_TRACE_SCOPE("gemm tile");
+			const size_t MR = kernel.mr;
+			const size_t NR = kernel.nr;
+
+			std::vector<T>& a_buf = packing_buffer<T>(0);
+			std::vector<T>& b_buf = packing_buffer<T>(1);
+			a_buf.resize(round_up(mt, MR) * kc_max);
+			b_buf.resize(round_up(nt, NR) * kc_max);
+
+			for (size_t pc = 0; pc < k; pc += kc_max) {
+				const size_t kc = std::min(kc_max, k - pc);
+				pack_b(kc, nt, b + pc * ldb, ldb, b_buf.data(), NR);
+				pack_a(mt, kc, a + pc, lda, a_buf.data(), MR);
+				for (size_t jr = 0; jr < nt; jr += NR) {
+					for (size_t ir = 0; ir < mt; ir += MR) {
+						kernel.run(kc, a_buf.data() + ir * kc, b_buf.data() + jr * kc,
+							c + ir * ldc + jr, ldc, std::min(MR, mt - ir), std::min(NR, nt - jr));
+					}
+				}
+			}
+		}
+	}
+}
+
+inline M::OmpSchedule M::parse_schedule(const std::string& name)
+{
+	if (name == "static") return OmpSchedule::Static;
+	if (name == "dynamic") return OmpSchedule::Dynamic;
+	if (name == "guided") return OmpSchedule::Guided;
+	throw std::invalid_argument{"[parse_schedule]Unknown schedule: " + name};
+}
+
+inline M::OmpDecomposition M::parse_decomposition(const std::string& name)
+{
+	if (name == "rows") return OmpDecomposition::Rows;
+	if (name == "tiles") return OmpDecomposition::Tiles;
+	if (name == "taskloop") return OmpDecomposition::TaskLoop;
+	throw std::invalid_argument{"[parse_decomposition]Unknown decomposition: " + name};
+}
+
+inline std::string M::to_string(OmpSchedule schedule)
+{
+	switch (schedule) {
+	case OmpSchedule::Dynamic: return "dynamic";
+	case OmpSchedule::Guided: return "guided";
+	default: return "static";
+	}
+}
+
+inline std::string M::to_string(OmpDecomposition decomposition)
+{
+	switch (decomposition) {
+	case OmpDecomposition::Rows: return "rows";
+	case OmpDecomposition::TaskLoop: return "taskloop";
+	default: return "tiles";
+	}
+}
+
+template <typename T>
+void M::omp_gemm(ConstMatrixView<detail::no_deduce_t<T>> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+	MatrixView<T> c, int threads, const OmpGemmConfig& config)
+{
+	using namespace detail;
+
+	if (a.get_cols() != b.get_rows() || a.get_rows() != c.get_rows() || b.get_cols() != c.get_cols()) {
+		throw std::invalid_argument{"Failed to multiply matrices"};
+	}
+	const size_t m = c.get_rows(), n = c.get_cols(), k = a.get_cols();
+	if (m == 0 || n == 0 || k == 0) {
+		return;
+	}
+	M_TRACE_SCOPE("omp_gemm");
+
+	const MicroKernel<T>& kernel = micro_kernel_for<T>();
+	const GemmBlocking blocking = default_blocking<T>();
+	threads = std::max(threads, 1);
+
+	const TileShape shape = choose_tiles(m, n, threads, config, kernel);
+	const size_t tm = shape.tm, tn = shape.tn;
+	const long tiles_m = static_cast<long>(ceil_div(m, tm));
+	const long tiles_n = static_cast<long>(ceil_div(n, tn));
+
+	const auto tile = [&](long ti, long tj) {
+		const size_t i = static_cast<size_t>(ti) * tm, j = static_cast<size_t>(tj) * tn;
+		compute_tile(a.row(i), a.get_ld(), b.get_data() + j, b.get_ld(), c.row(i) + j, c.get_ld(),
+			std::min(tm, m - i), std::min(tn, n - j), k, blocking.kc, kernel);
+	};
+
+#ifndef _OPENMP
+	// Сборка без OpenMP: те же плитки по порядку в одном потоке.
+	for (long ti = 0; ti < tiles_m; ++ti) {
+		for (long tj = 0; tj < tiles_n; ++tj) {
+			tile(ti, tj);
+		}
+	}
+#else
+	const int chunk = std::max(config.chunk, 1);
+
+	if (config.decomposition == OmpDecomposition::TaskLoop) {
+		const long tiles = tiles_m * tiles_n;
+#pragma omp parallel num_threads(threads) if(threads > 1)
+#pragma omp single
+#pragma omp taskloop grainsize(chunk)
+		for (long t = 0; t < tiles; ++t) {
+			tile(t / tiles_n, t % tiles_n);
+		}
+		return;
+	}
+
+	switch (config.schedule) {
+	case OmpSchedule::Dynamic:
+#pragma omp parallel for collapse(2) num_threads(threads) schedule(dynamic, chunk) if(threads > 1)
+		for (long ti = 0; ti < tiles_m; ++ti) {
+			for (long tj = 0; tj < tiles_n; ++tj) {
+				tile(ti, tj);
+			}
+		}
+		break;
+	case OmpSchedule::Guided:
+#pragma omp parallel for collapse(2) num_threads(threads) schedule(guided, chunk) if(threads > 1)
+		for (long ti = 0; ti < tiles_m; ++ti) {
+			for (long tj = 0; tj < tiles_n; ++tj) {
+				tile(ti, tj);
+			}
+		}
+		break;
+	default:
+		if (config.chunk > 0) {
+#pragma omp parallel for collapse(2) num_threads(threads) schedule(static, chunk) if(threads > 1)
+			for (long ti = 0; ti < tiles_m; ++ti) {
+				for (long tj = 0; tj < tiles_n; ++tj) {
+					tile(ti, tj);
+				}
+			}
+		}
+		else {
+#pragma omp parallel for collapse(2) num_threads(threads) schedule(static) if(threads > 1)
+			for (long ti = 0; ti < tiles_m; ++ti) {
+				for (long tj = 0; tj < tiles_n; ++tj) {
+					tile(ti, tj);
+				}
+			}
+		}
+		break;
+	}
+#endif // _OPENMP
+}
+
+#endif // OMP_GEMM_H
@@ -0,0 +1,412 @@
+#ifndef OUT_OF_CORE_H
+#define OUT_OF_CORE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "allocator.h"
+#include "gemm.h"
+#include "matrix_io.h"
+#include "matrix_view.h"
+#include "timer.h"
+#include "trace.h"
+
+namespace M
+{
+	// Матрица в файле .npy (формат write_binary), которую читают и пишут прямоугольными
+	// плитками, не загружая целиком. Поток файла не буферизуется: плитка читается прямо в приёмник.
+	template <typename T>
+	class TileFile
+	{
+	public:
+		// Существующий файл для чтения.
+		static TileFile open(const std::string& filename);
+		// Новый файл rows x cols, заполненный нулями, для записи плиток.
+		static TileFile create(const std::string& filename, size_t rows, size_t cols);
+
+		size_t get_rows() const noexcept;
+		size_t get_cols() const noexcept;
+
+		// Плитка размера dst, левый верхний угол — (row, col).
+		void read(size_t row, size_t col, MatrixView<T> dst);
+		void write(size_t row, size_t col, ConstMatrixView<T> src);
+
+	private:
+		TileFile(const std::string& filename, std::ios::openmode mode);
+
+		void check_tile(size_t row, size_t col, size_t height, size_t width, const char* where) const;
+		std::streamoff position(size_t row, size_t col) const noexcept;
+
+		std::fstream _file;
+		size_t _offset = 0;
+		size_t _rows = 0;
+		size_t _cols = 0;
+	};
+
+	struct OutOfCoreOptions
+	{
+		size_t memory_budget = size_t(1) << 30;  // байт на все буферы плиток
+		size_t tile = 0;                         // 0 — наибольшая плитка, которая помещается в бюджет
+		int threads = 1;                         // потоки gemm на одной плитке
+	};
+
+	struct OutOfCoreStats
+	{
+		size_t tile = 0;
+		double seconds = 0;
+		double read_seconds = 0;     // поток чтения занят вводом
+		double write_seconds = 0;    // поток записи занят выводом
+		double compute_seconds = 0;
+		double stall_seconds = 0;    // вычисления ждали плиток: ввод не успевал за gemm
+		uint64_t bytes_read = 0;
+		uint64_t bytes_written = 0;
+	};
+
+	// Сторона квадратной плитки для бюджета: по две плитки A, B и C (двойная буферизация).
+	// Буферы упаковки gemm (около 2 МБ) в бюджет не входят.
+	template <typename T>
+	size_t out_of_core_tile(size_t memory_budget);
+
+	// C = A * B для файлов .npy. Плитки C (tile x tile) считаются по очереди: фоновый поток читает
+	// следующую пару плиток A и B, пока gemm умножает текущую, а готовые плитки C пишет на диск
+	// второй фоновый поток. В памяти одновременно не больше двух плиток каждого вида.
+	template <typename T>
+	OutOfCoreStats out_of_core_multiply(const std::string& a_path, const std::string& b_path,
+		const std::string& c_path, const OutOfCoreOptions& options = {});
+
+	namespace detail
+	{
+		// Кольцо слотов между производителем и потребителем, которые проходят слоты по порядку:
+		// производитель ждёт свободный слот, потребитель — заполненный. stop() будит обоих.
+		class SlotPipe
+		{
+		public:
+			explicit SlotPipe(size_t slots) noexcept : _slots{slots} { }
+
+			bool wait_free()
+			{
+				std::unique_lock<std::mutex> lock{_mutex};
+				_changed.wait(lock, [this] { return _stopped || _published - _released < _slots; });
+				return !_stopped;
+			}
+
+			void publish()
+			{
+				{
+					std::lock_guard<std::mutex> lock{_mutex};
+					++_published;
+				}
+				_changed.notify_all();
+			}
+
+			bool wait_ready()
+			{
+				std::unique_lock<std::mutex> lock{_mutex};
+				_changed.wait(lock, [this] { return _stopped || _published > _taken; });
+				if (_stopped) {
+					return false;
+				}
+				++_taken;
+				return true;
+			}
+
+			void release()
+			{
+				{
+					std::lock_guard<std::mutex> lock{_mutex};
+					++_released;
+				}
+				_changed.notify_all();
+			}
+
+			void stop()
+			{
+				{
+					std::lock_guard<std::mutex> lock{_mutex};
+					_stopped = true;
+				}
+				_changed.notify_all();
+			}
+
+		private:
+			std::mutex _mutex;
+			std::condition_variable _changed;
+			size_t _slots;
+			size_t _published = 0;
+			size_t _taken = 0;
+			size_t _released = 0;
+			bool _stopped = false;
+		};
+	}
+}
+
+template <typename T>
+M::TileFile<T>::TileFile(const std::string& filename, std::ios::openmode mode)
+{
+	_file.rdbuf()->pubsetbuf(nullptr, 0);
+	_file.open(filename, mode | std::ios::binary);
+	if (!_file.is_open()) {
+		throw std::runtime_error("[TileFile]Couldn't open the file.");
+	}
+}
+
+template <typename T>
+M::TileFile<T> M::TileFile<T>::open(const std::string& filename)
+{
+	TileFile file(filename, std::ios::in);
+	const size_t file_size = static_cast<size_t>(std::filesystem::file_size(filename));
+
+	// Сначала преамбула, по ней — длина словаря; parse_npy_header сверяет её с размером файла.
+	std::vector<char> header(std::min(file_size, detail::NPY_PREAMBLE + 2));
+	file._file.read(header.data(), static_cast<std::streamsize>(header.size()));
+	if (header.size() == detail::NPY_PREAMBLE + 2 && std::memcmp(header.data(), detail::NPY_MAGIC, 6) == 0) {
+		const auto [preamble, header_len] = detail::npy_header_span(header.data());
+		header.resize(std::min(file_size, preamble + header_len));
+		file._file.seekg(0);
+		file._file.read(header.data(), static_cast<std::streamsize>(header.size()));
+	}
+	if (!file._file) {
+		throw std::runtime_error("[TileFile]Failed to read the header.");
+	}
+	file._offset = detail::parse_npy_header<T>(header.data(), file_size, file._rows, file._cols);
+	return file;
+}
+
+template <typename T>
+M::TileFile<T> M::TileFile<T>::create(const std::string& filename, size_t rows, size_t cols)
+{
+	const std::string header = detail::npy_header<T>(rows, cols);
+	{
+		std::ofstream out(filename, std::ios::binary | std::ios::trunc);
+		out.write(header.data(), static_cast<std::streamsize>(header.size()));
+		if (!out) {
+			throw std::runtime_error("[TileFile]Couldn't create the file.");
+		}
+	}
+	// Данные не пишутся: файл растягивается до нужной длины и читается нулями.
+	std::filesystem::resize_file(filename, header.size() + rows * cols * sizeof(T));
+
+	TileFile file(filename, std::ios::in | std::ios::out);
+	file._offset = header.size();
+	file._rows = rows;
+	file._cols = cols;
+	return file;
+}
+
+template <typename T>
+size_t M::TileFile<T>::get_rows() const noexcept
+{
+	return _rows;
+}
+
+template <typename T>
+size_t M::TileFile<T>::get_cols() const noexcept
+{
+	return _cols;
+}
+
+template <typename T>
+void M::TileFile<T>::check_tile(size_t row, size_t col, size_t height, size_t width, const char* where) const
+{
+	if (row + height > _rows || col + width > _cols) {
+		throw std::invalid_argument{std::string("[") + where + "]Tile is out of the matrix."};
+	}
+}
+
+template <typename T>
+std::streamoff M::TileFile<T>::position(size_t row, size_t col) const noexcept
+{
+	return static_cast<std::streamoff>(_offset + (row * _cols + col) * sizeof(T));
+}
+
+template <typename T>
+void M::TileFile<T>::read(size_t row, size_t col, MatrixView<T> dst)
+{
+	check_tile(row, col, dst.get_rows(), dst.get_cols(), "TileFile::read");
+	// Плитка во всю ширину лежит в файле одним куском.
+	const bool whole = dst.get_cols() == _cols && dst.is_contiguous();
+	const size_t chunks = whole ? 1 : dst.get_rows();
+	const size_t chunk = (whole ? dst.get_rows() * _cols : dst.get_cols()) * sizeof(T);
+	for (size_t i = 0; i < chunks; ++i) {
+		_file.seekg(position(row + i, col));
+		_file.read(reinterpret_cast<char*>(dst.row(i)), static_cast<std::streamsize>(chunk));
+	}
+	if (!_file) {
+		throw std::runtime_error("[TileFile::read]Failed to read the file.");
+	}
+}
+
+template <typename T>
+void M::TileFile<T>::write(size_t row, size_t col, ConstMatrixView<T> src)
+{
+	check_tile(row, col, src.get_rows(), src.get_cols(), "TileFile::write");
+	const bool whole = src.get_cols() == _cols && src.is_contiguous();
+	const size_t chunks = whole ? 1 : src.get_rows();
+	const size_t chunk = (whole ? src.get_rows() * _cols : src.get_cols()) * sizeof(T);
+	for (size_t i = 0; i < chunks; ++i) {
+		_file.seekp(position(row + i, col));
+		_file.write(reinterpret_cast<const char*>(src.row(i)), static_cast<std::streamsize>(chunk));
+	}
+	if (!_file.flush()) {
+		throw std::runtime_error("[TileFile::write]Failed to write the file.");
+	}
+}
+
+template <typename T>
+size_t M::out_of_core_tile(size_t memory_budget)
+{
+	size_t tile = static_cast<size_t>(std::sqrt(static_cast<double>(memory_budget) / (6.0 * sizeof(T))));
+	// Крупные плитки выравниваются по 64, чтобы края не дробили блоки gemm.
+	if (tile >= 256) {
+		tile = tile / 64 * 64;
+	}
+	if (tile == 0) {
+		throw std::invalid_argument{"[out_of_core_tile]Memory budget is too small."};
+	}
+	return tile;
+}
+
+template <typename T>
+M::OutOfCoreStats M::out_of_core_multiply(const std::string& a_path, const std::string& b_path,
+	const std::string& c_path, const OutOfCoreOptions& options)
+{
+	using Clock = std::chrono::steady_clock;
+	M_TRACE_SCOPE("out_of_core_multiply");
+	const auto start = Clock::now();
+
+	TileFile<T> a = TileFile<T>::open(a_path);
+	TileFile<T> b = TileFile<T>::open(b_path);
+	if (a.get_cols() != b.get_rows()) {
+		throw std::invalid_argument{"[out_of_core_multiply]Failed to multiply matrices."};
+	}
+	const size_t m = a.get_rows(), n = b.get_cols(), k = a.get_cols();
+	TileFile<T> c = TileFile<T>::create(c_path, m, n);
+
+	OutOfCoreStats stats;
+	stats.tile = options.tile ? options.tile : out_of_core_tile<T>(options.memory_budget);
+	if (m == 0 || n == 0 || k == 0) {
+		stats.seconds = detail::seconds_since(start);
+		return stats;
+	}
+
+	const size_t tm = std::min(stats.tile, m), tn = std::min(stats.tile, n), tk = std::min(stats.tile, k);
+	const size_t row_tiles = (m + tm - 1) / tm, col_tiles = (n + tn - 1) / tn, depth_tiles = (k + tk - 1) / tk;
+	const size_t c_tiles = row_tiles * col_tiles;
+
+	std::vector<T, AlignedAllocator<T>> a_buf[2], b_buf[2], c_buf[2];
+	for (int slot = 0; slot < 2; ++slot) {
+		a_buf[slot].resize(tm * tk);
+		b_buf[slot].resize(tk * tn);
+		c_buf[slot].resize(tm * tn);
+	}
+	// Плитка t матрицы C — (t / col_tiles, t % col_tiles); шаг s чтения — плитка s / depth_tiles,
+	// глубина s % depth_tiles. Края короче tile.
+	const auto rows_of = [&](size_t t) { return std::min(tm, m - t / col_tiles * tm); };
+	const auto cols_of = [&](size_t t) { return std::min(tn, n - t % col_tiles * tn); };
+	const auto depth_of = [&](size_t p) { return std::min(tk, k - p * tk); };
+
+	detail::SlotPipe inputs(2), outputs(2);
+	std::mutex error_mutex;
+	std::exception_ptr error;
+	const auto fail = [&](std::exception_ptr e) {
+		{
+			std::lock_guard<std::mutex> lock{error_mutex};
+			if (!error) {
+				error = e;
+			}
+		}
+		inputs.stop();
+		outputs.stop();
+	};
+
+	std::thread reader([&] {
+		try {
+			for (size_t s = 0; s < c_tiles * depth_tiles; ++s) {
+				if (!inputs.wait_free()) {
+					return;
+				}
+				M_TRACE_SCOPE("ooc read");
+				const auto read_start = Clock::now();
+				const size_t t = s / depth_tiles, p = s % depth_tiles, slot = s % 2;
+				const size_t rows = rows_of(t), cols = cols_of(t), depth = depth_of(p);
+				a.read(t / col_tiles * tm, p * tk, MatrixView<T>{a_buf[slot].data(), rows, depth});
+				b.read(p * tk, t % col_tiles * tn, MatrixView<T>{b_buf[slot].data(), depth, cols});
+				stats.bytes_read += (rows + cols) * depth * sizeof(T);
+				stats.read_seconds += detail::seconds_since(read_start);
+				inputs.publish();
+			}
+		}
+		catch (...) {
+			fail(std::current_exception());
+		}
+	});
+
+	std::thread writer([&] {
+		try {
+			for (size_t t = 0; t < c_tiles; ++t) {
+				if (!outputs.wait_ready()) {
+					return;
+				}
+				M_TRACE_SCOPE("ooc write");
+				const auto write_start = Clock::now();
+				const size_t rows = rows_of(t), cols = cols_of(t);
+				c.write(t / col_tiles * tm, t % col_tiles * tn, ConstMatrixView<T>{c_buf[t % 2].data(), rows, cols});
+				stats.bytes_written += rows * cols * sizeof(T);
+				stats.write_seconds += detail::seconds_since(write_start);
+				outputs.release();
+			}
+		}
+		catch (...) {
+			fail(std::current_exception());
+		}
+	});
+
+	try {
+		size_t s = 0;
+		for (size_t t = 0; t < c_tiles && outputs.wait_free(); ++t) {
+			const size_t rows = rows_of(t), cols = cols_of(t);
+			const MatrixView<T> tile{c_buf[t % 2].data(), rows, cols};
+			std::fill(c_buf[t % 2].begin(), c_buf[t % 2].end(), T{});
+			for (size_t p = 0; p < depth_tiles; ++p, ++s) {
+				const auto wait_start = Clock::now();
+				if (!inputs.wait_ready()) {
+					break;
+				}
+				stats.stall_seconds += detail::seconds_since(wait_start);
+
+				const auto compute_start = Clock::now();
+				const size_t depth = depth_of(p);
+				gemm<T>(ConstMatrixView<T>{a_buf[s % 2].data(), rows, depth},
+					ConstMatrixView<T>{b_buf[s % 2].data(), depth, cols}, tile, options.threads);
+				stats.compute_seconds += detail::seconds_since(compute_start);
+				inputs.release();
+			}
+			outputs.publish();
+		}
+	}
+	catch (...) {
+		fail(std::current_exception());
+	}
+	reader.join();
+	writer.join();
+	if (error) {
+		std::rethrow_exception(error);
+	}
+	stats.seconds = detail::seconds_since(start);
+	return stats;
+}
+
+#endif // OUT_OF_CORE_H
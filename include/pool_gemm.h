@@ -0,0 +1,95 @@
+#ifndef POOL_GEMM_H
+#define POOL_GEMM_H
+
+#include <cstddef>
+#include <optional>
+#include <stdexcept>
+#include <string>
+
+#include "matrix_view.h"
+#include "omp_gemm.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "tuning.h"
+
+namespace M
+{
+	enum class GemmBackend { OpenMP, Pool };
+
+	GemmBackend parse_backend(const std::string& name);
+	std::string to_string(GemmBackend backend);
+
+	// Та же разбивка C на плитки, что и в omp_gemm, но плитки раздаются постоянным пулом:
+	// нет fork/join на каждый вызов, и вызов изнутри задачи пула не плодит потоков.
+	// Одновременно работает не больше threads задач. Из config используются только размеры плиток.
+	template <typename T>
+	void pool_gemm(ConstMatrixView<detail::no_deduce_t<T>> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+		MatrixView<T> c, int threads, const OmpGemmConfig& config = {},
+		ThreadPool& pool = ThreadPool::instance());
+
+	// C += A * B на выбранном бэкенде. Без config берутся плитки и расписание из кэша автотюнера.
+	template <typename T>
+	void parallel_gemm(GemmBackend backend, ConstMatrixView<detail::no_deduce_t<T>> a,
+		ConstMatrixView<detail::no_deduce_t<T>> b, MatrixView<T> c, int threads,
+		const std::optional<OmpGemmConfig>& config = std::nullopt);
+}
+
+inline M::GemmBackend M::parse_backend(const std::string& name)
+{
+	if (name == "omp" || name == "openmp") return GemmBackend::OpenMP;
+	if (name == "pool") return GemmBackend::Pool;
+	throw std::invalid_argument{"[parse_backend]Unknown backend: " + name};
+}
+
+inline std::string M::to_string(GemmBackend backend)
+{
+	return backend == GemmBackend::Pool ? "pool" : "omp";
+}
+
+template <typename T>
+void M::pool_gemm(ConstMatrixView<detail::no_deduce_t<T>> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+	MatrixView<T> c, int threads, const OmpGemmConfig& config, ThreadPool& pool)
+{
+	using namespace detail;
+
+	if (a.get_cols() != b.get_rows() || a.get_rows() != c.get_rows() || b.get_cols() != c.get_cols()) {
+		throw std::invalid_argument{"Failed to multiply matrices"};
+	}
+	const size_t m = c.get_rows(), n = c.get_cols(), k = a.get_cols();
+	if (m == 0 || n == 0 || k == 0) {
+		return;
+	}
+	M_TRACE_SCOPE("pool_gemm");
+
+	const MicroKernel<T>& kernel = micro_kernel_for<T>();
+	const GemmBlocking blocking = default_blocking<T>();
+	threads = std::max(threads, 1);
+
+	const TileShape shape = choose_tiles(m, n, threads, config, kernel);
+	const size_t tm = shape.tm, tn = shape.tn;
+	const size_t tiles_n = ceil_div(n, tn);
+
+	pool.parallel_for(0, ceil_div(m, tm) * tiles_n, 1, [&](size_t first, size_t last) {
+		for (size_t t = first; t < last; ++t) {
+			const size_t i = t / tiles_n * tm, j = t % tiles_n * tn;
+			compute_tile(a.row(i), a.get_ld(), b.get_data() + j, b.get_ld(), c.row(i) + j, c.get_ld(),
+				std::min(tm, m - i), std::min(tn, n - j), k, blocking.kc, kernel);
+		}
+	}, static_cast<size_t>(threads));
+}
+
+template <typename T>
+void M::parallel_gemm(GemmBackend backend, ConstMatrixView<detail::no_deduce_t<T>> a,
+	ConstMatrixView<detail::no_deduce_t<T>> b, MatrixView<T> c, int threads,
+	const std::optional<OmpGemmConfig>& config)
+{
+	const OmpGemmConfig tuned = tuned_config<T>(c.get_rows(), c.get_cols(), a.get_cols(), threads, config);
+	if (backend == GemmBackend::Pool) {
+		pool_gemm(a, b, c, threads, tuned);
+	}
+	else {
+		omp_gemm(a, b, c, threads, tuned);
+	}
+}
+
+#endif // POOL_GEMM_H
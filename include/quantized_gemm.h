@@ -0,0 +1,528 @@
+#ifndef QUANTIZED_GEMM_H
+#define QUANTIZED_GEMM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "gemm.h"
+#include "matrix.h"
+#include "matrix_view.h"
+#include "simd_kernels.h"
+#include "trace.h"
+
+namespace M
+{
+	// Узкие целые входы: умножаются с расширением, сумма копится в int32.
+	template <typename T>
+	inline constexpr bool is_quantized_v = std::is_same_v<T, int8_t> || std::is_same_v<T, int16_t>;
+
+	// Ядро для упакованных парами int16: на каждый шаг q в полоске A лежат MR пар (a[i][2q], a[i][2q+1]),
+	// в полоске B — NR пар (b[2q][j], b[2q+1][j]). Одна команда pmaddwd (vpdpwssd) даёт сумму двух
+	// произведений в каждой 32-битной ячейке.
+	struct QuantKernel
+	{
+		using Fn = void (*)(size_t kp, const int16_t* ap, const int16_t* bp, int32_t* c, size_t ldc, size_t mr, size_t nr);
+
+		size_t mr;
+		size_t nr;
+		Fn run;
+		const char* name;
+	};
+
+	// Выбирается один раз, как и micro_kernel_for: по cpuid либо по MATRIX_ISA.
+	const QuantKernel& quant_kernel();
+	QuantKernel quant_kernel(Isa isa);
+
+	// Результат точен, если |C| + k * max|A| * max|B| помещается в int32: тогда не переполняется
+	// ни одна промежуточная сумма при любом порядке сложения.
+	constexpr bool qgemm_exact(size_t k, int64_t max_abs_a, int64_t max_abs_b, int64_t max_abs_c = 0) noexcept;
+
+	// Наибольший модуль квантованного значения, при котором произведение глубины k точно.
+	template <typename T>
+	T quant_limit(size_t k) noexcept;
+
+	// C(m x n) += A(m x k) * B(k x n) для int8/int16 с накоплением в int32. Перед умножением
+	// входы и C просматриваются один раз; если точность не гарантирована — std::overflow_error.
+	template <typename T>
+	void qgemm(size_t m, size_t n, size_t k,
+		const T* a, size_t lda,
+		const T* b, size_t ldb,
+		int32_t* c, size_t ldc,
+		int threads = 1);
+
+	template <typename T>
+	void qgemm(ConstMatrixView<T> a, ConstMatrixView<detail::no_deduce_t<T>> b, MatrixView<int32_t> c, int threads = 1);
+
+	// Новая матрица A * B типа int32.
+	template <typename T, typename Alloc>
+	Matrix<int32_t> widening_multiply(const Matrix<T, Alloc>& a, const Matrix<T, Alloc>& b, int threads = 1);
+
+	// Копия с сужением типа; значение, которое не помещается в T, — std::out_of_range.
+	template <typename T, typename S>
+	void narrow_copy(ConstMatrixView<S> src, MatrixView<T> dst, int threads = 1);
+
+	// Симметричное квантование: dst = round(src / scale), |dst| <= limit. Возвращает scale.
+	template <typename T>
+	float quantize(ConstMatrixView<float> src, MatrixView<T> dst, T limit = std::numeric_limits<T>::max(),
+		int threads = 1);
+
+	// dst = src * scale; для произведения scale = scale_a * scale_b.
+	void dequantize(ConstMatrixView<int32_t> src, float scale, MatrixView<float> dst, int threads = 1);
+
+	// C = A * B через квантование в T. Предел выбирается по quant_limit, так что целая часть
+	// считается точно, а погрешность — только от округления входов.
+	template <typename T>
+	void quantized_multiply(ConstMatrixView<float> a, ConstMatrixView<float> b, MatrixView<float> c, int threads = 1);
+
+	namespace detail
+	{
+		template <typename T>
+		int64_t max_abs(ConstMatrixView<T> view, int threads)
+		{
+			int64_t result = 0;
+			const long rows = static_cast<long>(view.get_rows());
+#pragma omp parallel for num_threads(threads) reduction(max:result) if(threads > 1)
+			for (long i = 0; i < rows; ++i) {
+				const T* row = view.row(static_cast<size_t>(i));
+				for (size_t j = 0; j < view.get_cols(); ++j) {
+					const int64_t value = row[j];
+					result = std::max(result, value < 0 ? -value : value);
+				}
+			}
+			return result;
+		}
+
+		// Блок A раскладывается полосками по MR строк; k дополняется нулём до чётного.
+		template <typename T>
+		void pack_a_pairs(size_t mc, size_t kc, const T* a, size_t lda, int16_t* buf, size_t MR)
+		{
+			for (size_t ir = 0; ir < mc; ir += MR) {
+				const size_t mr = std::min(MR, mc - ir);
+				for (size_t p = 0; p < kc; p += 2) {
+					for (size_t i = 0; i < mr; ++i) {
+						const T* row = a + (ir + i) * lda + p;
+						buf[2 * i] = row[0];
+						buf[2 * i + 1] = p + 1 < kc ? row[1] : 0;
+					}
+					std::fill(buf + 2 * mr, buf + 2 * MR, int16_t{0});
+					buf += 2 * MR;
+				}
+			}
+		}
+
+		// Панель B раскладывается полосками по NR столбцов, строки p и p + 1 чередуются.
+		template <typename T>
+		void pack_b_pairs(size_t kc, size_t nc, const T* b, size_t ldb, int16_t* buf, size_t NR)
+		{
+			for (size_t jr = 0; jr < nc; jr += NR) {
+				const size_t nr = std::min(NR, nc - jr);
+				for (size_t p = 0; p < kc; p += 2) {
+					const T* row0 = b + p * ldb + jr;
+					const T* row1 = row0 + ldb;
+					for (size_t j = 0; j < nr; ++j) {
+						buf[2 * j] = row0[j];
+						buf[2 * j + 1] = p + 1 < kc ? row1[j] : 0;
+					}
+					std::fill(buf + 2 * nr, buf + 2 * NR, int16_t{0});
+					buf += 2 * NR;
+				}
+			}
+		}
+
+		template <size_t MR, size_t NR>
+		void scalar_quant_kernel(size_t kp, const int16_t* ap, const int16_t* bp, int32_t* c, size_t ldc,
+			size_t mr, size_t nr)
+		{
+			int32_t acc[MR][NR] = {};
+			for (size_t q = 0; q < kp; ++q) {
+				for (size_t i = 0; i < MR; ++i) {
+					const int32_t a0 = ap[2 * i], a1 = ap[2 * i + 1];
+					for (size_t j = 0; j < NR; ++j) {
+						acc[i][j] += a0 * bp[2 * j] + a1 * bp[2 * j + 1];
+					}
+				}
+				ap += 2 * MR;
+				bp += 2 * NR;
+			}
+			for (size_t i = 0; i < mr; ++i) {
+				for (size_t j = 0; j < nr; ++j) {
+					c[i * ldc + j] += acc[i][j];
+				}
+			}
+		}
+
+#ifdef M_SIMD_X86
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+		// Та же схема, что и simd_kernel_body, но вместо fma — попарное произведение int16 в int32.
+		template <typename Ops, size_t MR, size_t NV>
+		M_INLINE void quant_kernel_body(size_t kp, const int16_t* ap, const int16_t* bp, int32_t* c, size_t ldc,
+			size_t mr, size_t nr)
+		{
+			using reg = typename Ops::reg;
+			constexpr size_t W = Ops::width;
+			constexpr size_t NR = NV * W;
+
+			reg acc[MR][NV];
+			for (size_t i = 0; i < MR; ++i) {
+				for (size_t v = 0; v < NV; ++v) {
+					acc[i][v] = Ops::zero();
+				}
+			}
+
+			for (size_t q = 0; q < kp; ++q) {
+				reg b[NV];
+				for (size_t v = 0; v < NV; ++v) {
+					b[v] = Ops::load(bp + 2 * v * W);
+				}
+				for (size_t i = 0; i < MR; ++i) {
+					int32_t pair;
+					std::memcpy(&pair, ap + 2 * i, sizeof(pair));
+					const reg a = Ops::broadcast(pair);
+					for (size_t v = 0; v < NV; ++v) {
+						acc[i][v] = Ops::dot(a, b[v], acc[i][v]);
+					}
+				}
+				ap += 2 * MR;
+				bp += 2 * NR;
+			}
+
+			if (mr == MR && nr == NR) {
+				for (size_t i = 0; i < MR; ++i) {
+					for (size_t v = 0; v < NV; ++v) {
+						int32_t* dst = c + i * ldc + v * W;
+						Ops::store(dst, Ops::add(Ops::load_acc(dst), acc[i][v]));
+					}
+				}
+				return;
+			}
+
+			int32_t tmp[MR * NR];
+			for (size_t i = 0; i < MR; ++i) {
+				for (size_t v = 0; v < NV; ++v) {
+					Ops::store(tmp + i * NR + v * W, acc[i][v]);
+				}
+			}
+			for (size_t i = 0; i < mr; ++i) {
+				for (size_t j = 0; j < nr; ++j) {
+					c[i * ldc + j] += tmp[i * NR + j];
+				}
+			}
+		}
+
+#define M_QUANT_OPS(NAME, TARGET, REG, WIDTH, ZERO, LOAD, SET1, STORE, ADD, DOT) \
+		struct NAME \
+		{ \
+			using reg = REG; \
+			static constexpr size_t width = WIDTH; \
+			M_TARGET(TARGET) static reg zero() { return ZERO; } \
+			M_TARGET(TARGET) static reg load(const int16_t* p) { return LOAD; } \
+			M_TARGET(TARGET) static reg load_acc(const int32_t* p) { return LOAD; } \
+			M_TARGET(TARGET) static reg broadcast(int32_t x) { return SET1; } \
+			M_TARGET(TARGET) static void store(int32_t* p, reg x) { STORE; } \
+			M_TARGET(TARGET) static reg add(reg x, reg y) { return ADD; } \
+			M_TARGET(TARGET) static reg dot(reg x, reg y, reg acc) { return DOT; } \
+		};
+
+		M_QUANT_OPS(Sse42Quant, "sse4.2", __m128i, 4,
+			_mm_setzero_si128(), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_set1_epi32(x),
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(p), x),
+			_mm_add_epi32(x, y), _mm_add_epi32(acc, _mm_madd_epi16(x, y)))
+		M_QUANT_OPS(Avx2Quant, "avx2", __m256i, 8,
+			_mm256_setzero_si256(), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), _mm256_set1_epi32(x),
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x),
+			_mm256_add_epi32(x, y), _mm256_add_epi32(acc, _mm256_madd_epi16(x, y)))
+		M_QUANT_OPS(Avx512Quant, "avx512f,avx512bw", __m512i, 16,
+			_mm512_setzero_si512(), _mm512_loadu_si512(p), _mm512_set1_epi32(x), _mm512_storeu_si512(p, x),
+			_mm512_add_epi32(x, y), _mm512_add_epi32(acc, _mm512_madd_epi16(x, y)))
+		M_QUANT_OPS(Avx512VnniQuant, "avx512f,avx512bw,avx512vnni", __m512i, 16,
+			_mm512_setzero_si512(), _mm512_loadu_si512(p), _mm512_set1_epi32(x), _mm512_storeu_si512(p, x),
+			_mm512_add_epi32(x, y), _mm512_dpwssd_epi32(acc, x, y))
+
+#undef M_QUANT_OPS
+
+		template <typename Ops, size_t MR, size_t NV>
+		M_TARGET("sse4.2") M_FLATTEN
+		void sse42_quant_kernel(size_t kp, const int16_t* ap, const int16_t* bp, int32_t* c, size_t ldc,
+			size_t mr, size_t nr)
+		{
+			quant_kernel_body<Ops, MR, NV>(kp, ap, bp, c, ldc, mr, nr);
+		}
+
+		template <typename Ops, size_t MR, size_t NV>
+		M_TARGET("avx2") M_FLATTEN
+		void avx2_quant_kernel(size_t kp, const int16_t* ap, const int16_t* bp, int32_t* c, size_t ldc,
+			size_t mr, size_t nr)
+		{
+			quant_kernel_body<Ops, MR, NV>(kp, ap, bp, c, ldc, mr, nr);
+		}
+
+		template <typename Ops, size_t MR, size_t NV>
+		M_TARGET("avx512f,avx512bw") M_FLATTEN
+		void avx512_quant_kernel(size_t kp, const int16_t* ap, const int16_t* bp, int32_t* c, size_t ldc,
+			size_t mr, size_t nr)
+		{
+			quant_kernel_body<Ops, MR, NV>(kp, ap, bp, c, ldc, mr, nr);
+		}
+
+		template <typename Ops, size_t MR, size_t NV>
+		M_TARGET("avx512f,avx512bw,avx512vnni") M_FLATTEN
+		void avx512vnni_quant_kernel(size_t kp, const int16_t* ap, const int16_t* bp, int32_t* c, size_t ldc,
+			size_t mr, size_t nr)
+		{
+			quant_kernel_body<Ops, MR, NV>(kp, ap, bp, c, ldc, mr, nr);
+		}
+#pragma GCC diagnostic pop
+#endif // M_SIMD_X86
+	}
+}
+
+inline M::QuantKernel M::quant_kernel(Isa isa)
+{
+	using namespace detail;
+#ifdef M_SIMD_X86
+	__builtin_cpu_init();
+	// Целочисленные команды AVX-512 — в расширении BW, которого может не быть при наличии F.
+	if (isa == Isa::Avx512 && !__builtin_cpu_supports("avx512bw")) {
+		isa = Isa::Avx2;
+	}
+	switch (isa) {
+	case Isa::Avx512:
+		if (__builtin_cpu_supports("avx512vnni")) {
+			return {8, 2 * Avx512VnniQuant::width, &avx512vnni_quant_kernel<Avx512VnniQuant, 8, 2>, "avx512-vnni"};
+		}
+		return {8, 2 * Avx512Quant::width, &avx512_quant_kernel<Avx512Quant, 8, 2>, "avx512"};
+	case Isa::Avx2:
+		return {6, 2 * Avx2Quant::width, &avx2_quant_kernel<Avx2Quant, 6, 2>, "avx2"};
+	case Isa::Sse42:
+		return {4, 2 * Sse42Quant::width, &sse42_quant_kernel<Sse42Quant, 4, 2>, "sse4.2"};
+	default:
+		break;
+	}
+#endif
+	(void)isa;
+	return {4, 8, &scalar_quant_kernel<4, 8>, "scalar"};
+}
+
+inline const M::QuantKernel& M::quant_kernel()
+{
+	static const QuantKernel kernel = quant_kernel(detail::isa_from_env(detect_isa()));
+	return kernel;
+}
+
+constexpr bool M::qgemm_exact(size_t k, int64_t max_abs_a, int64_t max_abs_b, int64_t max_abs_c) noexcept
+{
+	constexpr int64_t limit = std::numeric_limits<int32_t>::max();
+	if (max_abs_c > limit) {
+		return false;
+	}
+	const int64_t product = max_abs_a * max_abs_b;
+	if (product == 0) {
+		return true;
+	}
+	// Сравнение через деление: k * product может не поместиться и в int64.
+	return static_cast<int64_t>(k) <= (limit - max_abs_c) / product;
+}
+
+template <typename T>
+T M::quant_limit(size_t k) noexcept
+{
+	static_assert(is_quantized_v<T>, "quant_limit supports int8_t and int16_t");
+	const int64_t bound = static_cast<int64_t>(std::sqrt(static_cast<double>(std::numeric_limits<int32_t>::max())
+		/ static_cast<double>(std::max<size_t>(k, 1))));
+	return static_cast<T>(std::max<int64_t>(1, std::min<int64_t>(std::numeric_limits<T>::max(), bound)));
+}
+
+template <typename T>
+void M::qgemm(size_t m, size_t n, size_t k,
+	const T* a, size_t lda,
+	const T* b, size_t ldb,
+	int32_t* c, size_t ldc,
+	int threads)
+{
+	static_assert(is_quantized_v<T>, "qgemm supports int8_t and int16_t");
+	using namespace detail;
+
+	if (m == 0 || n == 0 || k == 0) {
+		return;
+	}
+	M_TRACE_SCOPE("qgemm");
+
+	// Для int8 хватает границы по типу: сканировать A и B не нужно, пока k не превысит 2^17.
+	constexpr int64_t type_bound = -static_cast<int64_t>(std::numeric_limits<T>::min());
+	const bool inputs_fit = qgemm_exact(k, type_bound, type_bound);
+	const int64_t abs_a = inputs_fit ? type_bound : max_abs(ConstMatrixView<T>{a, m, k, lda}, threads);
+	const int64_t abs_b = inputs_fit ? type_bound : max_abs(ConstMatrixView<T>{b, k, n, ldb}, threads);
+	const int64_t abs_c = max_abs(ConstMatrixView<int32_t>{c, m, n, ldc}, threads);
+	if (!qgemm_exact(k, abs_a, abs_b, abs_c)) {
+		throw std::overflow_error{"[qgemm]The int32 result may overflow for these inputs."};
+	}
+
+	const QuantKernel& kernel = quant_kernel();
+	const size_t MR = kernel.mr;
+	const size_t NR = kernel.nr;
+
+	// Блоки считаются по int16 в упаковке: A — в L2, панель B — в L3. kc чётное.
+	constexpr size_t kc_max = 512;
+	constexpr size_t l2_bytes = 128 * 1024;
+	constexpr size_t l3_bytes = 2 * 1024 * 1024;
+	const size_t mc_max = std::max(MR, l2_bytes / (kc_max * sizeof(int16_t)) / MR * MR);
+	const size_t nc_max = std::max(NR, l3_bytes / (kc_max * sizeof(int16_t)) / NR * NR);
+
+	const size_t per_thread = round_up((m + threads - 1) / std::max(threads, 1), MR);
+	const size_t mc = std::max(MR, std::min(mc_max, per_thread));
+	const long m_blocks = static_cast<long>((m + mc - 1) / mc);
+
+	std::vector<int16_t>& b_buf = packing_buffer<int16_t>(1);
+	b_buf.resize(kc_max * round_up(std::min(nc_max, n), NR));
+
+	for (size_t jc = 0; jc < n; jc += nc_max) {
+		const size_t nc = std::min(nc_max, n - jc);
+		for (size_t pc = 0; pc < k; pc += kc_max) {
+			const size_t kc = std::min(kc_max, k - pc);
+			const size_t kp = (kc + 1) / 2;
+			pack_b_pairs(kc, nc, b + pc * ldb + jc, ldb, b_buf.data(), NR);
+			const int16_t* bp = b_buf.data();
+
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+			for (long block = 0; block < m_blocks; ++block) {
+				M_TRACE_SCOPE("qgemm block");
+				const size_t ic = static_cast<size_t>(block) * mc;
+				const size_t mc_cur = std::min(mc, m - ic);
+
+				std::vector<int16_t>& a_buf = packing_buffer<int16_t>(0);
+				a_buf.resize(round_up(mc, MR) * kc_max);
+				pack_a_pairs(mc_cur, kc, a + ic * lda + pc, lda, a_buf.data(), MR);
+
+				for (size_t jr = 0; jr < nc; jr += NR) {
+					for (size_t ir = 0; ir < mc_cur; ir += MR) {
+						kernel.run(kp, a_buf.data() + 2 * ir * kp, bp + 2 * jr * kp,
+							c + (ic + ir) * ldc + jc + jr, ldc,
+							std::min(MR, mc_cur - ir), std::min(NR, nc - jr));
+					}
+				}
+			}
+		}
+	}
+}
+
+template <typename T>
+void M::qgemm(ConstMatrixView<T> a, ConstMatrixView<detail::no_deduce_t<T>> b, MatrixView<int32_t> c, int threads)
+{
+	if (a.get_cols() != b.get_rows() || a.get_rows() != c.get_rows() || b.get_cols() != c.get_cols()) {
+		throw std::invalid_argument{"[qgemm]Failed to multiply matrices."};
+	}
+	qgemm(a.get_rows(), b.get_cols(), a.get_cols(),
+		a.get_data(), a.get_ld(),
+		b.get_data(), b.get_ld(),
+		c.get_data(), c.get_ld(),
+		threads);
+}
+
+template <typename T, typename Alloc>
+M::Matrix<int32_t> M::widening_multiply(const Matrix<T, Alloc>& a, const Matrix<T, Alloc>& b, int threads)
+{
+	Matrix<int32_t> result(a.get_rows(), b.get_cols());
+	qgemm<T>(a.view(), b.view(), result.view(), threads);
+	return result;
+}
+
+template <typename T, typename S>
+void M::narrow_copy(ConstMatrixView<S> src, MatrixView<T> dst, int threads)
+{
+	if (src.get_rows() != dst.get_rows() || src.get_cols() != dst.get_cols()) {
+		throw std::invalid_argument{"[narrow_copy]Matrix dimensions do not match."};
+	}
+	const long rows = static_cast<long>(src.get_rows());
+	bool fits = true;
+#pragma omp parallel for num_threads(threads) reduction(&&:fits) if(threads > 1)
+	for (long i = 0; i < rows; ++i) {
+		const S* in = src.row(static_cast<size_t>(i));
+		T* out = dst.row(static_cast<size_t>(i));
+		for (size_t j = 0; j < src.get_cols(); ++j) {
+			fits = fits && in[j] >= std::numeric_limits<T>::min() && in[j] <= std::numeric_limits<T>::max();
+			out[j] = static_cast<T>(in[j]);
+		}
+	}
+	if (!fits) {
+		throw std::out_of_range{"[narrow_copy]Value does not fit into the target type."};
+	}
+}
+
+template <typename T>
+float M::quantize(ConstMatrixView<float> src, MatrixView<T> dst, T limit, int threads)
+{
+	static_assert(is_quantized_v<T>, "quantize supports int8_t and int16_t");
+	if (src.get_rows() != dst.get_rows() || src.get_cols() != dst.get_cols()) {
+		throw std::invalid_argument{"[quantize]Matrix dimensions do not match."};
+	}
+	if (limit <= 0) {
+		throw std::invalid_argument{"[quantize]Limit must be positive."};
+	}
+	const long rows = static_cast<long>(src.get_rows());
+	float peak = 0;
+#pragma omp parallel for num_threads(threads) reduction(max:peak) if(threads > 1)
+	for (long i = 0; i < rows; ++i) {
+		const float* row = src.row(static_cast<size_t>(i));
+		for (size_t j = 0; j < src.get_cols(); ++j) {
+			peak = std::max(peak, std::fabs(row[j]));
+		}
+	}
+	if (!std::isfinite(peak)) {
+		throw std::invalid_argument{"[quantize]Matrix contains a non-finite value."};
+	}
+
+	// Нулевая матрица квантуется в нули с единичным масштабом.
+	const float scale = peak > 0 ? peak / limit : 1.0f;
+	const float inverse = 1.0f / scale;
+	const float bound = static_cast<float>(limit);
+#pragma omp parallel for num_threads(threads) if(threads > 1)
+	for (long i = 0; i < rows; ++i) {
+		const float* in = src.row(static_cast<size_t>(i));
+		T* out = dst.row(static_cast<size_t>(i));
+		for (size_t j = 0; j < src.get_cols(); ++j) {
+			out[j] = static_cast<T>(std::clamp(std::nearbyint(in[j] * inverse), -bound, bound));
+		}
+	}
+	return scale;
+}
+
+inline void M::dequantize(ConstMatrixView<int32_t> src, float scale, MatrixView<float> dst, int threads)
+{
+	if (src.get_rows() != dst.get_rows() || src.get_cols() != dst.get_cols()) {
+		throw std::invalid_argument{"[dequantize]Matrix dimensions do not match."};
+	}
+	const long rows = static_cast<long>(src.get_rows());
+#pragma omp parallel for num_threads(threads) if(threads > 1)
+	for (long i = 0; i < rows; ++i) {
+		const int32_t* in = src.row(static_cast<size_t>(i));
+		float* out = dst.row(static_cast<size_t>(i));
+		for (size_t j = 0; j < src.get_cols(); ++j) {
+			out[j] = static_cast<float>(in[j]) * scale;
+		}
+	}
+}
+
+template <typename T>
+void M::quantized_multiply(ConstMatrixView<float> a, ConstMatrixView<float> b, MatrixView<float> c, int threads)
+{
+	if (a.get_cols() != b.get_rows() || a.get_rows() != c.get_rows() || b.get_cols() != c.get_cols()) {
+		throw std::invalid_argument{"[quantized_multiply]Failed to multiply matrices."};
+	}
+	const T limit = quant_limit<T>(a.get_cols());
+	Matrix<T> qa(a.get_rows(), a.get_cols()), qb(b.get_rows(), b.get_cols());
+	Matrix<int32_t> qc(c.get_rows(), c.get_cols());
+	const float scale_a = quantize<T>(a, qa.view(), limit, threads);
+	const float scale_b = quantize<T>(b, qb.view(), limit, threads);
+	qgemm<T>(qa.view(), qb.view(), qc.view(), threads);
+	dequantize(qc.view(), scale_a * scale_b, c, threads);
+}
+
+#endif // QUANTIZED_GEMM_H
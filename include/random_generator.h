@@ -1,36 +1,141 @@
 #ifndef RANDOM_GENERATOR_H
 #define RANDOM_GENERATOR_H
 
-#include <vector>
+#include <array>
+#include <cstdint>
+#include <limits>
 #include <random>
+#include <type_traits>
+#include <vector>
+
+// Philox4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"):
+// 128-битный счётчик и 64-битный ключ отображаются в 128 случайных бит без состояния.
+class Philox4x32 {
+public:
+    using Counter = std::array<uint32_t, 4>;
+    using Key = std::array<uint32_t, 2>;
 
+    static Counter generate(Counter counter, Key key) {
+        for (int round = 0; round < 10; ++round) {
+            const uint64_t p0 = static_cast<uint64_t>(M0) * counter[0];
+            const uint64_t p1 = static_cast<uint64_t>(M1) * counter[2];
+            counter = {static_cast<uint32_t>(p1 >> 32) ^ counter[1] ^ key[0], static_cast<uint32_t>(p1),
+                       static_cast<uint32_t>(p0 >> 32) ^ counter[3] ^ key[1], static_cast<uint32_t>(p0)};
+            key[0] += W0;
+            key[1] += W1;
+        }
+        return counter;
+    }
+
+private:
+    static constexpr uint32_t M0 = 0xD2511F53;
+    static constexpr uint32_t M1 = 0xCD9E8D57;
+    static constexpr uint32_t W0 = 0x9E3779B9;
+    static constexpr uint32_t W1 = 0xBB67AE85;
+};
+
+// Элемент (row, col) зависит только от seed, row и col, поэтому любой блок матрицы
+// можно сгенерировать на любом потоке или ранге, и результат не зависит от разбиения.
 class RandomGenerator {
 public:
+    // Случайное зерно для запусков, где воспроизводимость не нужна.
+    static uint64_t random_seed();
+
     template <typename T>
-    static std::vector<T> generate_matrix(size_t rows, size_t cols, const T& minVal, const T& maxVal);
+    static T value_at(uint64_t seed, size_t row, size_t col, const T& minVal, const T& maxVal);
+
+    // Заполняет блок rows x cols (шаг строки ld), левый верхний угол которого — (first_row, first_col)
+    // в логической матрице.
+    template <typename T>
+    static void fill_block(T* data, size_t ld, size_t first_row, size_t first_col, size_t rows, size_t cols,
+                           const T& minVal, const T& maxVal, uint64_t seed, int threads = 1);
+
+    template <typename T>
+    static std::vector<T> generate_matrix(size_t rows, size_t cols, const T& minVal, const T& maxVal,
+                                          uint64_t seed = random_seed());
+
+    template <typename T>
+    static void fill(T* data, size_t count, const T& minVal, const T& maxVal, uint64_t seed = random_seed());
+
+private:
+    // Один вызов Philox даёт два 64-битных числа: для столбцов 2c и 2c + 1.
+    static std::array<uint64_t, 2> bits_at(uint64_t seed, size_t row, size_t col_pair);
+
+    template <typename T>
+    static T to_range(uint64_t bits, const T& minVal, const T& maxVal);
 };
 
-template <typename T>
-std::vector<T> RandomGenerator::generate_matrix(size_t rows, size_t cols, const T& minVal, const T& maxVal) {
-    std::vector<T> matrix(rows * cols);
+inline uint64_t RandomGenerator::random_seed() {
     std::random_device rd;
-    std::mt19937 gen(rd());
+    return static_cast<uint64_t>(rd()) << 32 | rd();
+}
+
+inline std::array<uint64_t, 2> RandomGenerator::bits_at(uint64_t seed, size_t row, size_t col_pair) {
+    const uint64_t r = row, c = col_pair;
+    const Philox4x32::Counter out = Philox4x32::generate(
+        {static_cast<uint32_t>(c), static_cast<uint32_t>(c >> 32), static_cast<uint32_t>(r), static_cast<uint32_t>(r >> 32)},
+        {static_cast<uint32_t>(seed), static_cast<uint32_t>(seed >> 32)});
+    return {static_cast<uint64_t>(out[0]) << 32 | out[1], static_cast<uint64_t>(out[2]) << 32 | out[3]};
+}
 
+template <typename T>
+T RandomGenerator::to_range(uint64_t bits, const T& minVal, const T& maxVal) {
     if constexpr (std::is_integral_v<T>) {
-        std::uniform_int_distribution<T> dist(minVal, maxVal);
-        for (auto& elem : matrix) {
-            elem = dist(gen);
-        }
+        // Смещение остатка не превышает range / 2^64 — для матриц этого достаточно.
+        using U = std::make_unsigned_t<T>;
+        const uint64_t range = static_cast<uint64_t>(static_cast<U>(static_cast<U>(maxVal) - static_cast<U>(minVal))) + 1;
+        const uint64_t offset = range == 0 ? bits : bits % range;
+        return static_cast<T>(static_cast<U>(static_cast<U>(minVal) + static_cast<U>(offset)));
     }
     else {
-        std::uniform_real_distribution<T> dist(minVal, maxVal);
-        for (auto& elem : matrix) {
-            elem = dist(gen);
+        // 53 старших бита -> [0, 1)
+        const double unit = static_cast<double>(bits >> 11) * (1.0 / 9007199254740992.0);
+        return static_cast<T>(minVal + static_cast<T>(unit * (static_cast<double>(maxVal) - static_cast<double>(minVal))));
+    }
+}
+
+template <typename T>
+T RandomGenerator::value_at(uint64_t seed, size_t row, size_t col, const T& minVal, const T& maxVal) {
+    return to_range(bits_at(seed, row, col / 2)[col % 2], minVal, maxVal);
+}
+
+template <typename T>
+void RandomGenerator::fill_block(T* data, size_t ld, size_t first_row, size_t first_col, size_t rows, size_t cols,
+                                 const T& minVal, const T& maxVal, uint64_t seed, [[maybe_unused]] int threads) {
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+#endif
+    for (long i = 0; i < static_cast<long>(rows); ++i) {
+        T* out = data + i * ld;
+        const size_t row = first_row + i;
+        size_t j = 0;
+        // Нечётный первый столбец — вторая половина пары.
+        if (cols > 0 && first_col % 2 == 1) {
+            out[j++] = value_at(seed, row, first_col, minVal, maxVal);
+        }
+        for (; j + 1 < cols; j += 2) {
+            const std::array<uint64_t, 2> bits = bits_at(seed, row, (first_col + j) / 2);
+            out[j] = to_range(bits[0], minVal, maxVal);
+            out[j + 1] = to_range(bits[1], minVal, maxVal);
+        }
+        if (j < cols) {
+            out[j] = value_at(seed, row, first_col + j, minVal, maxVal);
         }
     }
+}
 
+template <typename T>
+std::vector<T> RandomGenerator::generate_matrix(size_t rows, size_t cols, const T& minVal, const T& maxVal,
+                                                uint64_t seed) {
+    std::vector<T> matrix(rows * cols);
+    fill_block(matrix.data(), cols, 0, 0, rows, cols, minVal, maxVal, seed);
     return matrix;
 }
 
+template <typename T>
+void RandomGenerator::fill(T* data, size_t count, const T& minVal, const T& maxVal, uint64_t seed) {
+    fill_block(data, count, 0, 0, 1, count, minVal, maxVal, seed);
+}
+
 
-#endif //RANDOM_GENERATOR_H
\ No newline at end of file
+#endif //RANDOM_GENERATOR_H
@@ -0,0 +1,248 @@
+#ifndef ROOFLINE_H
+#define ROOFLINE_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+
+#include "simd_kernels.h"
+#include "timer.h"
+
+namespace M
+{
+	// Потолки машины для одного типа элементов: пиковая производительность умножения-сложения
+	// на одном ядре и на threads потоках, а также пропускная способность памяти (STREAM triad).
+	struct RooflineProfile
+	{
+		double peak_core_gflops = 0;
+		double peak_total_gflops = 0;
+		double bandwidth_gbs = 0;
+		int threads = 1;
+		Isa isa = Isa::Scalar;
+	};
+
+	// Цикл из независимых умножений-сложений на том же наборе инструкций, что выбран для gemm.
+	template <typename T>
+	double measure_peak_gflops(int threads);
+
+	// a[i] = b[i] + s * c[i] на массивах, заведомо больших кэша; считаются 3 * 8 байт на элемент.
+	double measure_bandwidth_gbs(int threads, size_t elements);
+
+	template <typename T>
+	RooflineProfile calibrate_roofline(int threads);
+
+	// Операций на байт при минимальном трафике: A и B читаются, C читается и пишется по разу.
+	template <typename T>
+	double gemm_intensity(size_t m, size_t n, size_t k) noexcept;
+
+	// Потолок для ядра с интенсивностью intensity на cores ядрах (не больше, чем откалибровано).
+	double roofline_bound(const RooflineProfile& profile, double intensity, int cores) noexcept;
+
+	namespace detail
+	{
+		// Аккумуляторов больше, чем задержка FMA, умноженная на число портов: цепочки не ждут друг друга.
+		constexpr size_t PEAK_ACCUMULATORS = 12;
+		constexpr size_t PEAK_ITERATIONS = size_t{1} << 22;
+		constexpr size_t STREAM_ELEMENTS = size_t{1} << 23;
+		constexpr int CALIBRATION_REPEATS = 5;
+
+		template <typename T>
+		using PeakFn = T (*)(size_t iterations, T x, T y);
+
+		template <typename T>
+		struct PeakLoop
+		{
+			PeakFn<T> run;
+			size_t width;
+		};
+
+		// Возвращает сумму аккумуляторов, чтобы компилятор не выбросил цикл.
+		template <typename T>
+		T scalar_peak(size_t iterations, T x, T y)
+		{
+			T acc[PEAK_ACCUMULATORS] = {};
+			for (size_t it = 0; it < iterations; ++it) {
+				for (size_t i = 0; i < PEAK_ACCUMULATORS; ++i) {
+					acc[i] = acc[i] * x + y;
+				}
+			}
+			T sum{};
+			for (T value : acc) {
+				sum += value;
+			}
+			return sum;
+		}
+
+#ifdef M_SIMD_X86
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+		template <typename Ops>
+		M_INLINE typename Ops::value_type simd_peak_body(size_t iterations, typename Ops::value_type x,
+			typename Ops::value_type y)
+		{
+			using T = typename Ops::value_type;
+			using reg = typename Ops::reg;
+
+			reg acc[PEAK_ACCUMULATORS];
+			for (size_t i = 0; i < PEAK_ACCUMULATORS; ++i) {
+				acc[i] = Ops::zero();
+			}
+			const reg a = Ops::broadcast(x);
+			const reg b = Ops::broadcast(y);
+			// acc = acc * x + y: умножение зависит от аккумулятора, поэтому его нельзя вынести из цикла
+			// (для наборов без FMA и для int mul_add — это отдельные умножение и сложение).
+			for (size_t it = 0; it < iterations; ++it) {
+				for (size_t i = 0; i < PEAK_ACCUMULATORS; ++i) {
+					acc[i] = Ops::mul_add(acc[i], a, b);
+				}
+			}
+
+			T tmp[Ops::width];
+			T sum{};
+			for (size_t i = 0; i < PEAK_ACCUMULATORS; ++i) {
+				Ops::store(tmp, acc[i]);
+				for (T value : tmp) {
+					sum += value;
+				}
+			}
+			return sum;
+		}
+
+		template <typename Ops>
+		M_TARGET("sse4.2") M_FLATTEN
+		typename Ops::value_type sse42_peak(size_t iterations, typename Ops::value_type x, typename Ops::value_type y)
+		{
+			return simd_peak_body<Ops>(iterations, x, y);
+		}
+
+		template <typename Ops>
+		M_TARGET("avx2,fma") M_FLATTEN
+		typename Ops::value_type avx2_peak(size_t iterations, typename Ops::value_type x, typename Ops::value_type y)
+		{
+			return simd_peak_body<Ops>(iterations, x, y);
+		}
+
+		template <typename Ops>
+		M_TARGET("avx512f") M_FLATTEN
+		typename Ops::value_type avx512_peak(size_t iterations, typename Ops::value_type x, typename Ops::value_type y)
+		{
+			return simd_peak_body<Ops>(iterations, x, y);
+		}
+#pragma GCC diagnostic pop
+#endif // M_SIMD_X86
+
+		// Цикл для типа и набора инструкций: {SSE4.2, AVX2, AVX-512}, для остальных типов — скалярный.
+		template <typename T>
+		struct PeakLoops
+		{
+			static PeakLoop<T> get(Isa)
+			{
+				return {&scalar_peak<T>, 1};
+			}
+		};
+
+#ifdef M_SIMD_X86
+		template <typename T, typename SseOps, typename Avx2Ops, typename Avx512Ops>
+		struct PeakLoopTable
+		{
+			static PeakLoop<T> get(Isa isa)
+			{
+				switch (isa) {
+				case Isa::Avx512: return {&avx512_peak<Avx512Ops>, Avx512Ops::width};
+				case Isa::Avx2: return {&avx2_peak<Avx2Ops>, Avx2Ops::width};
+				case Isa::Sse42: return {&sse42_peak<SseOps>, SseOps::width};
+				default: return {&scalar_peak<T>, 1};
+				}
+			}
+		};
+
+		template <>
+		struct PeakLoops<float> : PeakLoopTable<float, Sse42Float, Avx2Float, Avx512Float> {};
+		template <>
+		struct PeakLoops<double> : PeakLoopTable<double, Sse42Double, Avx2Double, Avx512Double> {};
+		template <>
+		struct PeakLoops<int> : PeakLoopTable<int, Sse42Int, Avx2Int, Avx512Int> {};
+#endif // M_SIMD_X86
+	}
+}
+
+template <typename T>
+double M::measure_peak_gflops(int threads)
+{
+	const detail::PeakLoop<T> loop = detail::PeakLoops<T>::get(micro_kernel_for<T>().isa);
+	threads = std::max(threads, 1);
+	// Множители читаются через volatile, иначе компилятор свернёт цикл в константу. Сам цикл вызывается
+	// через указатель, выбранный во время выполнения, поэтому и без использования результата он не выбрасывается.
+	volatile T x = T(1), y = T(0);
+
+	double best = 0;
+	for (int repeat = 0; repeat < detail::CALIBRATION_REPEATS; ++repeat) {
+		const auto start = std::chrono::steady_clock::now();
+#pragma omp parallel num_threads(threads) if(threads > 1)
+		{
+			loop.run(detail::PEAK_ITERATIONS, x, y);
+		}
+		const double seconds = detail::seconds_since(start);
+		const double ops = 2.0 * static_cast<double>(loop.width * detail::PEAK_ACCUMULATORS * detail::PEAK_ITERATIONS)
+			* threads;
+		best = std::max(best, ops / seconds * 1e-9);
+	}
+	return best;
+}
+
+inline double M::measure_bandwidth_gbs(int threads, size_t elements)
+{
+	threads = std::max(threads, 1);
+	const long n = static_cast<long>(elements);
+	std::unique_ptr<double[]> a{new double[elements]}, b{new double[elements]}, c{new double[elements]};
+
+	// Первое касание теми же потоками и с тем же разбиением, что в замере (важно на NUMA).
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+	for (long i = 0; i < n; ++i) {
+		a[i] = 0.0;
+		b[i] = 1.0;
+		c[i] = 2.0;
+	}
+
+	const double scalar = 3.0;
+	double best = 0;
+	for (int repeat = 0; repeat < detail::CALIBRATION_REPEATS; ++repeat) {
+		const auto start = std::chrono::steady_clock::now();
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+		for (long i = 0; i < n; ++i) {
+			a[i] = b[i] + scalar * c[i];
+		}
+		const double seconds = detail::seconds_since(start);
+		best = std::max(best, 3.0 * sizeof(double) * static_cast<double>(elements) / seconds * 1e-9);
+	}
+	return best;
+}
+
+template <typename T>
+M::RooflineProfile M::calibrate_roofline(int threads)
+{
+	RooflineProfile profile;
+	profile.threads = std::max(threads, 1);
+	profile.isa = micro_kernel_for<T>().isa;
+	profile.peak_core_gflops = measure_peak_gflops<T>(1);
+	profile.peak_total_gflops = profile.threads > 1 ? measure_peak_gflops<T>(profile.threads) : profile.peak_core_gflops;
+	profile.bandwidth_gbs = measure_bandwidth_gbs(profile.threads, detail::STREAM_ELEMENTS);
+	return profile;
+}
+
+template <typename T>
+double M::gemm_intensity(size_t m, size_t n, size_t k) noexcept
+{
+	const double flops = 2.0 * static_cast<double>(m) * static_cast<double>(n) * static_cast<double>(k);
+	const double bytes = (static_cast<double>(m) * k + static_cast<double>(k) * n + 2.0 * m * n) * sizeof(T);
+	return bytes > 0 ? flops / bytes : 0;
+}
+
+inline double M::roofline_bound(const RooflineProfile& profile, double intensity, int cores) noexcept
+{
+	const double compute = std::min(profile.peak_core_gflops * std::max(cores, 1), profile.peak_total_gflops);
+	return std::min(compute, intensity * profile.bandwidth_gbs);
+}
+
+#endif // ROOFLINE_H
@@ -0,0 +1,307 @@
+#ifndef SIMD_KERNELS_H
+#define SIMD_KERNELS_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define M_SIMD_X86 1
+#include <immintrin.h>
+#define M_TARGET(isa) __attribute__((target(isa)))
+#define M_FLATTEN __attribute__((flatten))
+// Тела ядер без target встраиваются в обёртку всегда: при -O0 flatten не срабатывает,
+// и векторы передавались бы между функциями с разным ABI. Поэтому каждое общее тело,
+// которое вызывает обёртка M_TARGET M_FLATTEN, объявляется M_INLINE, а не просто inline.
+#define M_INLINE __attribute__((always_inline)) inline
+#endif
+
+namespace M
+{
+	enum class Isa
+	{
+		Scalar,
+		Sse42,
+		Avx2,
+		Avx512
+	};
+
+	// Микроядро считает полоску C (mr x nr, mr <= MR, nr <= NR) по упакованным
+	// полоскам A (kc x MR) и B (kc x NR) и прибавляет её к C.
+	template <typename T>
+	struct MicroKernel
+	{
+		using Fn = void (*)(size_t kc, const T* ap, const T* bp, T* c, size_t ldc, size_t mr, size_t nr);
+
+		size_t mr;
+		size_t nr;
+		Fn run;
+		Isa isa;
+	};
+
+	Isa detect_isa() noexcept;
+	const char* isa_name(Isa isa) noexcept;
+
+	// Ядро выбирается один раз при первом обращении: по cpuid либо по переменной MATRIX_ISA.
+	template <typename T>
+	const MicroKernel<T>& micro_kernel_for();
+
+	template <typename T>
+	MicroKernel<T> micro_kernel_for(Isa isa);
+
+	namespace detail
+	{
+		template <typename T, size_t MR, size_t NR>
+		void scalar_kernel(size_t kc, const T* ap, const T* bp, T* c, size_t ldc, size_t mr, size_t nr)
+		{
+			T acc[MR][NR] = {};
+			for (size_t p = 0; p < kc; ++p) {
+				for (size_t i = 0; i < MR; ++i) {
+					const T a_ip = ap[i];
+					for (size_t j = 0; j < NR; ++j) {
+						acc[i][j] += a_ip * bp[j];
+					}
+				}
+				ap += MR;
+				bp += NR;
+			}
+			for (size_t i = 0; i < mr; ++i) {
+				for (size_t j = 0; j < nr; ++j) {
+					c[i * ldc + j] += acc[i][j];
+				}
+			}
+		}
+
+#ifdef M_SIMD_X86
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpsabi"
+		// Регистровый блок MR x (NV векторов). Тело общее для всех наборов инструкций,
+		// конкретные команды подставляет Ops, а flatten в обёртке встраивает всё
+		// в функцию с нужным target.
+		template <typename Ops, size_t MR, size_t NV>
+		M_INLINE void simd_kernel_body(size_t kc, const typename Ops::value_type* ap,
+			const typename Ops::value_type* bp, typename Ops::value_type* c, size_t ldc,
+			size_t mr, size_t nr)
+		{
+			using T = typename Ops::value_type;
+			using reg = typename Ops::reg;
+			constexpr size_t W = Ops::width;
+			constexpr size_t NR = NV * W;
+
+			reg acc[MR][NV];
+			for (size_t i = 0; i < MR; ++i) {
+				for (size_t v = 0; v < NV; ++v) {
+					acc[i][v] = Ops::zero();
+				}
+			}
+
+			for (size_t p = 0; p < kc; ++p) {
+				reg b[NV];
+				for (size_t v = 0; v < NV; ++v) {
+					b[v] = Ops::load(bp + v * W);
+				}
+				for (size_t i = 0; i < MR; ++i) {
+					const reg a = Ops::broadcast(ap[i]);
+					for (size_t v = 0; v < NV; ++v) {
+						acc[i][v] = Ops::mul_add(a, b[v], acc[i][v]);
+					}
+				}
+				ap += MR;
+				bp += NR;
+			}
+
+			if (mr == MR && nr == NR) {
+				for (size_t i = 0; i < MR; ++i) {
+					for (size_t v = 0; v < NV; ++v) {
+						T* dst = c + i * ldc + v * W;
+						Ops::store(dst, Ops::add(Ops::load(dst), acc[i][v]));
+					}
+				}
+				return;
+			}
+
+			T tmp[MR * NR];
+			for (size_t i = 0; i < MR; ++i) {
+				for (size_t v = 0; v < NV; ++v) {
+					Ops::store(tmp + i * NR + v * W, acc[i][v]);
+				}
+			}
+			for (size_t i = 0; i < mr; ++i) {
+				for (size_t j = 0; j < nr; ++j) {
+					c[i * ldc + j] += tmp[i * NR + j];
+				}
+			}
+		}
+
+#define M_SIMD_OPS(NAME, TARGET, T, REG, WIDTH, ZERO, LOAD, SET1, STORE, ADD, MUL_ADD) \
+		struct NAME \
+		{ \
+			using value_type = T; \
+			using reg = REG; \
+			static constexpr size_t width = WIDTH; \
+			M_TARGET(TARGET) static reg zero() { return ZERO; } \
+			M_TARGET(TARGET) static reg load(const T* p) { return LOAD; } \
+			M_TARGET(TARGET) static reg broadcast(T x) { return SET1; } \
+			M_TARGET(TARGET) static void store(T* p, reg x) { STORE; } \
+			M_TARGET(TARGET) static reg add(reg x, reg y) { return ADD; } \
+			M_TARGET(TARGET) static reg mul_add(reg x, reg y, reg acc) { return MUL_ADD; } \
+		};
+
+		M_SIMD_OPS(Sse42Float, "sse4.2", float, __m128, 4,
+			_mm_setzero_ps(), _mm_loadu_ps(p), _mm_set1_ps(x), _mm_storeu_ps(p, x),
+			_mm_add_ps(x, y), _mm_add_ps(acc, _mm_mul_ps(x, y)))
+		M_SIMD_OPS(Sse42Double, "sse4.2", double, __m128d, 2,
+			_mm_setzero_pd(), _mm_loadu_pd(p), _mm_set1_pd(x), _mm_storeu_pd(p, x),
+			_mm_add_pd(x, y), _mm_add_pd(acc, _mm_mul_pd(x, y)))
+		M_SIMD_OPS(Sse42Int, "sse4.2", int, __m128i, 4,
+			_mm_setzero_si128(), _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)), _mm_set1_epi32(x),
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(p), x),
+			_mm_add_epi32(x, y), _mm_add_epi32(acc, _mm_mullo_epi32(x, y)))
+
+		M_SIMD_OPS(Avx2Float, "avx2,fma", float, __m256, 8,
+			_mm256_setzero_ps(), _mm256_loadu_ps(p), _mm256_set1_ps(x), _mm256_storeu_ps(p, x),
+			_mm256_add_ps(x, y), _mm256_fmadd_ps(x, y, acc))
+		M_SIMD_OPS(Avx2Double, "avx2,fma", double, __m256d, 4,
+			_mm256_setzero_pd(), _mm256_loadu_pd(p), _mm256_set1_pd(x), _mm256_storeu_pd(p, x),
+			_mm256_add_pd(x, y), _mm256_fmadd_pd(x, y, acc))
+		M_SIMD_OPS(Avx2Int, "avx2,fma", int, __m256i, 8,
+			_mm256_setzero_si256(), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), _mm256_set1_epi32(x),
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(p), x),
+			_mm256_add_epi32(x, y), _mm256_add_epi32(acc, _mm256_mullo_epi32(x, y)))
+
+		M_SIMD_OPS(Avx512Float, "avx512f", float, __m512, 16,
+			_mm512_setzero_ps(), _mm512_loadu_ps(p), _mm512_set1_ps(x), _mm512_storeu_ps(p, x),
+			_mm512_add_ps(x, y), _mm512_fmadd_ps(x, y, acc))
+		M_SIMD_OPS(Avx512Double, "avx512f", double, __m512d, 8,
+			_mm512_setzero_pd(), _mm512_loadu_pd(p), _mm512_set1_pd(x), _mm512_storeu_pd(p, x),
+			_mm512_add_pd(x, y), _mm512_fmadd_pd(x, y, acc))
+		M_SIMD_OPS(Avx512Int, "avx512f", int, __m512i, 16,
+			_mm512_setzero_si512(), _mm512_loadu_si512(p), _mm512_set1_epi32(x), _mm512_storeu_si512(p, x),
+			_mm512_add_epi32(x, y), _mm512_add_epi32(acc, _mm512_mullo_epi32(x, y)))
+
+#undef M_SIMD_OPS
+
+		template <typename Ops, size_t MR, size_t NV>
+		M_TARGET("sse4.2") M_FLATTEN
+		void sse42_kernel(size_t kc, const typename Ops::value_type* ap, const typename Ops::value_type* bp,
+			typename Ops::value_type* c, size_t ldc, size_t mr, size_t nr)
+		{
+			simd_kernel_body<Ops, MR, NV>(kc, ap, bp, c, ldc, mr, nr);
+		}
+
+		template <typename Ops, size_t MR, size_t NV>
+		M_TARGET("avx2,fma") M_FLATTEN
+		void avx2_kernel(size_t kc, const typename Ops::value_type* ap, const typename Ops::value_type* bp,
+			typename Ops::value_type* c, size_t ldc, size_t mr, size_t nr)
+		{
+			simd_kernel_body<Ops, MR, NV>(kc, ap, bp, c, ldc, mr, nr);
+		}
+
+		template <typename Ops, size_t MR, size_t NV>
+		M_TARGET("avx512f") M_FLATTEN
+		void avx512_kernel(size_t kc, const typename Ops::value_type* ap, const typename Ops::value_type* bp,
+			typename Ops::value_type* c, size_t ldc, size_t mr, size_t nr)
+		{
+			simd_kernel_body<Ops, MR, NV>(kc, ap, bp, c, ldc, mr, nr);
+		}
+#pragma GCC diagnostic pop
+#endif // M_SIMD_X86
+
+		// Набор ядер для типа: {SSE4.2, AVX2, AVX-512}. Для остальных типов — только скалярное.
+		template <typename T>
+		struct SimdKernels
+		{
+			static MicroKernel<T> get(Isa)
+			{
+				return {4, 8, &scalar_kernel<T, 4, 8>, Isa::Scalar};
+			}
+		};
+
+#ifdef M_SIMD_X86
+		template <typename T, typename SseOps, typename Avx2Ops, typename Avx512Ops>
+		struct SimdKernelTable
+		{
+			static MicroKernel<T> get(Isa isa)
+			{
+				constexpr size_t sse_nv = 2;
+				constexpr size_t avx2_nv = 2;
+				constexpr size_t avx512_nv = 2;
+				switch (isa) {
+				case Isa::Avx512:
+					return {8, avx512_nv * Avx512Ops::width, &avx512_kernel<Avx512Ops, 8, avx512_nv>, Isa::Avx512};
+				case Isa::Avx2:
+					return {6, avx2_nv * Avx2Ops::width, &avx2_kernel<Avx2Ops, 6, avx2_nv>, Isa::Avx2};
+				case Isa::Sse42:
+					return {4, sse_nv * SseOps::width, &sse42_kernel<SseOps, 4, sse_nv>, Isa::Sse42};
+				default:
+					return {4, 8, &scalar_kernel<T, 4, 8>, Isa::Scalar};
+				}
+			}
+		};
+
+		template <>
+		struct SimdKernels<float> : SimdKernelTable<float, Sse42Float, Avx2Float, Avx512Float> {};
+		template <>
+		struct SimdKernels<double> : SimdKernelTable<double, Sse42Double, Avx2Double, Avx512Double> {};
+		template <>
+		struct SimdKernels<int> : SimdKernelTable<int, Sse42Int, Avx2Int, Avx512Int> {};
+#endif // M_SIMD_X86
+
+		inline Isa isa_from_env(Isa detected) noexcept
+		{
+			const char* value = std::getenv("MATRIX_ISA");
+			if (value == nullptr) {
+				return detected;
+			}
+			Isa requested = detected;
+			if (std::strcmp(value, "scalar") == 0) requested = Isa::Scalar;
+			else if (std::strcmp(value, "sse4.2") == 0) requested = Isa::Sse42;
+			else if (std::strcmp(value, "avx2") == 0) requested = Isa::Avx2;
+			else if (std::strcmp(value, "avx512") == 0) requested = Isa::Avx512;
+			// Нельзя включить набор, которого нет у процессора.
+			return requested < detected ? requested : detected;
+		}
+	}
+}
+
+inline M::Isa M::detect_isa() noexcept
+{
+#ifdef M_SIMD_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f")) {
+		return Isa::Avx512;
+	}
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return Isa::Avx2;
+	}
+	if (__builtin_cpu_supports("sse4.2")) {
+		return Isa::Sse42;
+	}
+#endif
+	return Isa::Scalar;
+}
+
+inline const char* M::isa_name(Isa isa) noexcept
+{
+	switch (isa) {
+	case Isa::Sse42: return "sse4.2";
+	case Isa::Avx2: return "avx2";
+	case Isa::Avx512: return "avx512";
+	default: return "scalar";
+	}
+}
+
+template <typename T>
+M::MicroKernel<T> M::micro_kernel_for(Isa isa)
+{
+	return detail::SimdKernels<T>::get(isa);
+}
+
+template <typename T>
+const M::MicroKernel<T>& M::micro_kernel_for()
+{
+	static const MicroKernel<T> kernel = micro_kernel_for<T>(detail::isa_from_env(detect_isa()));
+	return kernel;
+}
+
+#endif // SIMD_KERNELS_H
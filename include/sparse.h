@@ -0,0 +1,578 @@
+#ifndef SPARSE_H
+#define SPARSE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "matrix.h"
+#include "matrix_view.h"
+#include "random_generator.h"
+#include "trace.h"
+
+namespace M
+{
+	// Номера столбцов хранятся в 32 битах: на SpMM/SpMV упирается в память, а не в арифметику.
+	using sparse_index = uint32_t;
+
+	// Compressed Sparse Row: ненулевые элементы строки i лежат в [row_ptr[i], row_ptr[i + 1])
+	// массивов col_idx и values, столбцы внутри строки по возрастанию.
+	template <typename T>
+	class CsrMatrix
+	{
+	public:
+		CsrMatrix() = default;
+		CsrMatrix(size_t rows, size_t cols, std::vector<size_t> row_ptr, std::vector<sparse_index> col_idx,
+			std::vector<T> values);
+
+		// Нули отбрасываются, остальные элементы сохраняются как есть.
+		static CsrMatrix from_dense(ConstMatrixView<T> dense);
+		Matrix<T> to_dense() const;
+
+		size_t get_rows() const noexcept;
+		size_t get_cols() const noexcept;
+		size_t get_nnz() const noexcept;
+		double density() const noexcept;
+
+		const std::vector<size_t>& get_row_ptr() const noexcept;
+		const std::vector<sparse_index>& get_col_idx() const noexcept;
+		const std::vector<T>& get_values() const noexcept;
+
+	private:
+		size_t _rows = 0, _cols = 0;
+		std::vector<size_t> _row_ptr{0};
+		std::vector<sparse_index> _col_idx;
+		std::vector<T> _values;
+	};
+
+	// Block Sparse Row: то же, что CSR, но над плотными блоками block x block (построчно внутри блока).
+	// Краевые блоки дополнены нулями до полного размера. Выгоден, когда ненулевые идут кучками:
+	// один индекс на блок и плотный внутренний цикл.
+	template <typename T>
+	class BsrMatrix
+	{
+	public:
+		BsrMatrix() = default;
+
+		// Блок сохраняется, если в нём есть хотя бы один ненулевой элемент.
+		static BsrMatrix from_dense(ConstMatrixView<T> dense, size_t block);
+		static BsrMatrix from_csr(const CsrMatrix<T>& csr, size_t block);
+		Matrix<T> to_dense() const;
+
+		size_t get_rows() const noexcept;
+		size_t get_cols() const noexcept;
+		size_t get_block() const noexcept;
+		size_t get_block_rows() const noexcept;
+		size_t get_blocks() const noexcept;
+
+		const std::vector<size_t>& get_row_ptr() const noexcept;
+		const std::vector<sparse_index>& get_col_idx() const noexcept;
+		const std::vector<T>& get_values() const noexcept;
+
+	private:
+		size_t _rows = 0, _cols = 0, _block = 1;
+		std::vector<size_t> _row_ptr{0};
+		std::vector<sparse_index> _col_idx;  // номер блочного столбца
+		std::vector<T> _values;
+	};
+
+	// C(m x n) += A(m x k) * B(k x n), A разреженная. Строки A делятся между потоками
+	// непрерывными кусками с примерно равным числом ненулевых.
+	template <typename T>
+	void spmm(const CsrMatrix<T>& a, ConstMatrixView<detail::no_deduce_t<T>> b, MatrixView<T> c, int threads = 1);
+	template <typename T>
+	void spmm(const BsrMatrix<T>& a, ConstMatrixView<detail::no_deduce_t<T>> b, MatrixView<T> c, int threads = 1);
+
+	// y += A * x, x длины get_cols(), y длины get_rows().
+	template <typename T>
+	void spmv(const CsrMatrix<T>& a, const T* x, T* y, int threads = 1);
+	template <typename T>
+	void spmv(const BsrMatrix<T>& a, const T* x, T* y, int threads = 1);
+
+	// Случайная разреженная матрица: элемент (блок block x block при block > 1) ненулевой
+	// с вероятностью density. Как и fill_random, зависит только от seed и координат.
+	template <typename T>
+	CsrMatrix<T> random_sparse(size_t rows, size_t cols, double density, const T& min_val, const T& max_val,
+		uint64_t seed, size_t block = 1, int threads = 1);
+
+	namespace detail
+	{
+		// Границы parts кусков строк с почти равным весом; вес строки — её ненулевые плюс один
+		// (пустые строки тоже чего-то стоят). Возвращает parts + 1 номеров строк.
+		inline std::vector<size_t> balanced_partition(const std::vector<size_t>& row_ptr, size_t parts)
+		{
+			const size_t rows = row_ptr.size() - 1;
+			parts = std::max<size_t>(1, std::min(parts, std::max<size_t>(rows, 1)));
+			const size_t total = row_ptr.back() + rows;
+			std::vector<size_t> bounds(parts + 1, rows);
+			bounds[0] = 0;
+			for (size_t p = 1; p < parts; ++p) {
+				const size_t target = total * p / parts;
+				// Первая строка r, у которой row_ptr[r] + r >= target.
+				size_t lo = bounds[p - 1], hi = rows;
+				while (lo < hi) {
+					const size_t mid = lo + (hi - lo) / 2;
+					if (row_ptr[mid] + mid < target) {
+						lo = mid + 1;
+					}
+					else {
+						hi = mid;
+					}
+				}
+				bounds[p] = lo;
+			}
+			return bounds;
+		}
+
+		// Проверка, что row_ptr монотонен и согласован с длиной col_idx, а индексы не выходят за cols.
+		inline void check_sparse_structure(size_t rows, size_t cols, const std::vector<size_t>& row_ptr,
+			const std::vector<sparse_index>& col_idx, const char* who)
+		{
+			if (row_ptr.size() != rows + 1 || row_ptr.front() != 0 || row_ptr.back() != col_idx.size()) {
+				throw std::invalid_argument{std::string("[") + who + "]Inconsistent row pointers."};
+			}
+			for (size_t i = 0; i < rows; ++i) {
+				if (row_ptr[i] > row_ptr[i + 1]) {
+					throw std::invalid_argument{std::string("[") + who + "]Row pointers must not decrease."};
+				}
+			}
+			for (sparse_index col : col_idx) {
+				if (col >= cols) {
+					throw std::invalid_argument{std::string("[") + who + "]Column index out of range."};
+				}
+			}
+		}
+
+		inline void check_index_range(size_t cols, const char* who)
+		{
+			if (cols > std::numeric_limits<sparse_index>::max()) {
+				throw std::invalid_argument{std::string("[") + who + "]Too many columns for 32-bit indices."};
+			}
+		}
+	}
+}
+
+template <typename T>
+M::CsrMatrix<T>::CsrMatrix(size_t rows, size_t cols, std::vector<size_t> row_ptr, std::vector<sparse_index> col_idx,
+	std::vector<T> values) :
+	_rows{rows},
+	_cols{cols},
+	_row_ptr{std::move(row_ptr)},
+	_col_idx{std::move(col_idx)},
+	_values{std::move(values)}
+{
+	detail::check_index_range(cols, "CsrMatrix");
+	detail::check_sparse_structure(_rows, _cols, _row_ptr, _col_idx, "CsrMatrix");
+	if (_values.size() != _col_idx.size()) {
+		throw std::invalid_argument{"[CsrMatrix]Values and column indices differ in length."};
+	}
+}
+
+template <typename T>
+M::CsrMatrix<T> M::CsrMatrix<T>::from_dense(ConstMatrixView<T> dense)
+{
+	detail::check_index_range(dense.get_cols(), "CsrMatrix::from_dense");
+	CsrMatrix result;
+	result._rows = dense.get_rows();
+	result._cols = dense.get_cols();
+	result._row_ptr.assign(result._rows + 1, 0);
+	for (size_t i = 0; i < result._rows; ++i) {
+		const T* row = dense.row(i);
+		for (size_t j = 0; j < result._cols; ++j) {
+			if (row[j] != T{}) {
+				result._col_idx.push_back(static_cast<sparse_index>(j));
+				result._values.push_back(row[j]);
+			}
+		}
+		result._row_ptr[i + 1] = result._values.size();
+	}
+	return result;
+}
+
+template <typename T>
+M::Matrix<T> M::CsrMatrix<T>::to_dense() const
+{
+	Matrix<T> dense(_rows, _cols);
+	for (size_t i = 0; i < _rows; ++i) {
+		for (size_t p = _row_ptr[i]; p < _row_ptr[i + 1]; ++p) {
+			dense(i, _col_idx[p]) = _values[p];
+		}
+	}
+	return dense;
+}
+
+template <typename T>
+size_t M::CsrMatrix<T>::get_rows() const noexcept
+{
+	return _rows;
+}
+
+template <typename T>
+size_t M::CsrMatrix<T>::get_cols() const noexcept
+{
+	return _cols;
+}
+
+template <typename T>
+size_t M::CsrMatrix<T>::get_nnz() const noexcept
+{
+	return _values.size();
+}
+
+template <typename T>
+double M::CsrMatrix<T>::density() const noexcept
+{
+	return _rows && _cols ? static_cast<double>(_values.size()) / (static_cast<double>(_rows) * _cols) : 0.0;
+}
+
+template <typename T>
+const std::vector<size_t>& M::CsrMatrix<T>::get_row_ptr() const noexcept
+{
+	return _row_ptr;
+}
+
+template <typename T>
+const std::vector<M::sparse_index>& M::CsrMatrix<T>::get_col_idx() const noexcept
+{
+	return _col_idx;
+}
+
+template <typename T>
+const std::vector<T>& M::CsrMatrix<T>::get_values() const noexcept
+{
+	return _values;
+}
+
+template <typename T>
+M::BsrMatrix<T> M::BsrMatrix<T>::from_dense(ConstMatrixView<T> dense, size_t block)
+{
+	if (block == 0) {
+		throw std::invalid_argument{"[BsrMatrix::from_dense]Block size must be positive."};
+	}
+	detail::check_index_range(dense.get_cols(), "BsrMatrix::from_dense");
+	BsrMatrix result;
+	result._rows = dense.get_rows();
+	result._cols = dense.get_cols();
+	result._block = block;
+	const size_t block_rows = (result._rows + block - 1) / block;
+	const size_t block_cols = (result._cols + block - 1) / block;
+	result._row_ptr.assign(block_rows + 1, 0);
+
+	for (size_t bi = 0; bi < block_rows; ++bi) {
+		const size_t h = std::min(block, result._rows - bi * block);
+		for (size_t bj = 0; bj < block_cols; ++bj) {
+			const size_t w = std::min(block, result._cols - bj * block);
+			bool nonzero = false;
+			for (size_t i = 0; i < h && !nonzero; ++i) {
+				const T* row = dense.row(bi * block + i) + bj * block;
+				nonzero = std::any_of(row, row + w, [](const T& value) { return value != T{}; });
+			}
+			if (!nonzero) {
+				continue;
+			}
+			result._col_idx.push_back(static_cast<sparse_index>(bj));
+			const size_t offset = result._values.size();
+			result._values.resize(offset + block * block, T{});
+			for (size_t i = 0; i < h; ++i) {
+				std::copy_n(dense.row(bi * block + i) + bj * block, w, result._values.data() + offset + i * block);
+			}
+		}
+		result._row_ptr[bi + 1] = result._col_idx.size();
+	}
+	return result;
+}
+
+template <typename T>
+M::BsrMatrix<T> M::BsrMatrix<T>::from_csr(const CsrMatrix<T>& csr, size_t block)
+{
+	if (block == 0) {
+		throw std::invalid_argument{"[BsrMatrix::from_csr]Block size must be positive."};
+	}
+	BsrMatrix result;
+	result._rows = csr.get_rows();
+	result._cols = csr.get_cols();
+	result._block = block;
+	const size_t block_rows = (result._rows + block - 1) / block;
+	const size_t block_cols = (result._cols + block - 1) / block;
+	result._row_ptr.assign(block_rows + 1, 0);
+
+	const std::vector<size_t>& row_ptr = csr.get_row_ptr();
+	const std::vector<sparse_index>& col_idx = csr.get_col_idx();
+	const std::vector<T>& values = csr.get_values();
+	// Номер блока в текущей блочной строке по блочному столбцу; SIZE_MAX — блока ещё нет.
+	std::vector<size_t> slot(block_cols, SIZE_MAX);
+	for (size_t bi = 0; bi < block_rows; ++bi) {
+		const size_t first_row = bi * block, last_row = std::min(first_row + block, result._rows);
+		const size_t first_block = result._col_idx.size();
+		// Сначала собираются блочные столбцы строки, чтобы расположить их по возрастанию.
+		for (size_t p = row_ptr[first_row]; p < row_ptr[last_row]; ++p) {
+			const size_t bj = col_idx[p] / block;
+			if (slot[bj] == SIZE_MAX) {
+				slot[bj] = 0;
+				result._col_idx.push_back(static_cast<sparse_index>(bj));
+			}
+		}
+		std::sort(result._col_idx.begin() + first_block, result._col_idx.end());
+		for (size_t b = first_block; b < result._col_idx.size(); ++b) {
+			slot[result._col_idx[b]] = b;
+		}
+		result._values.resize(result._col_idx.size() * block * block, T{});
+		for (size_t i = first_row; i < last_row; ++i) {
+			for (size_t p = row_ptr[i]; p < row_ptr[i + 1]; ++p) {
+				const size_t b = slot[col_idx[p] / block];
+				result._values[b * block * block + (i - first_row) * block + col_idx[p] % block] = values[p];
+			}
+		}
+		for (size_t b = first_block; b < result._col_idx.size(); ++b) {
+			slot[result._col_idx[b]] = SIZE_MAX;
+		}
+		result._row_ptr[bi + 1] = result._col_idx.size();
+	}
+	return result;
+}
+
+template <typename T>
+M::Matrix<T> M::BsrMatrix<T>::to_dense() const
+{
+	Matrix<T> dense(_rows, _cols);
+	for (size_t bi = 0; bi + 1 < _row_ptr.size(); ++bi) {
+		const size_t h = std::min(_block, _rows - bi * _block);
+		for (size_t b = _row_ptr[bi]; b < _row_ptr[bi + 1]; ++b) {
+			const size_t bj = _col_idx[b];
+			const size_t w = std::min(_block, _cols - bj * _block);
+			for (size_t i = 0; i < h; ++i) {
+				std::copy_n(_values.data() + b * _block * _block + i * _block, w,
+					dense.get_data() + (bi * _block + i) * _cols + bj * _block);
+			}
+		}
+	}
+	return dense;
+}
+
+template <typename T>
+size_t M::BsrMatrix<T>::get_rows() const noexcept
+{
+	return _rows;
+}
+
+template <typename T>
+size_t M::BsrMatrix<T>::get_cols() const noexcept
+{
+	return _cols;
+}
+
+template <typename T>
+size_t M::BsrMatrix<T>::get_block() const noexcept
+{
+	return _block;
+}
+
+template <typename T>
+size_t M::BsrMatrix<T>::get_block_rows() const noexcept
+{
+	return _row_ptr.size() - 1;
+}
+
+template <typename T>
+size_t M::BsrMatrix<T>::get_blocks() const noexcept
+{
+	return _col_idx.size();
+}
+
+template <typename T>
+const std::vector<size_t>& M::BsrMatrix<T>::get_row_ptr() const noexcept
+{
+	return _row_ptr;
+}
+
+template <typename T>
+const std::vector<M::sparse_index>& M::BsrMatrix<T>::get_col_idx() const noexcept
+{
+	return _col_idx;
+}
+
+template <typename T>
+const std::vector<T>& M::BsrMatrix<T>::get_values() const noexcept
+{
+	return _values;
+}
+
+template <typename T>
+void M::spmm(const CsrMatrix<T>& a, ConstMatrixView<detail::no_deduce_t<T>> b, MatrixView<T> c, int threads)
+{
+	if (a.get_cols() != b.get_rows() || a.get_rows() != c.get_rows() || b.get_cols() != c.get_cols()) {
+		throw std::invalid_argument{"Failed to multiply matrices"};
+	}
+	M_TRACE_SCOPE("spmm csr");
+	threads = std::max(threads, 1);
+	const size_t n = c.get_cols();
+	const std::vector<size_t>& row_ptr = a.get_row_ptr();
+	const sparse_index* col_idx = a.get_col_idx().data();
+	const T* values = a.get_values().data();
+	const std::vector<size_t> bounds = detail::balanced_partition(row_ptr, static_cast<size_t>(threads));
+	const long parts = static_cast<long>(bounds.size() - 1);
+
+	// Строка C накапливается как сумма строк B с весами из строки A: внутренний цикл непрерывный.
+#pragma omp parallel for num_threads(threads) schedule(static, 1) if(threads > 1)
+	for (long part = 0; part < parts; ++part) {
+		for (size_t i = bounds[part]; i < bounds[part + 1]; ++i) {
+			T* c_row = c.row(i);
+			for (size_t p = row_ptr[i]; p < row_ptr[i + 1]; ++p) {
+				const T value = values[p];
+				const T* b_row = b.row(col_idx[p]);
+				for (size_t j = 0; j < n; ++j) {
+					c_row[j] += value * b_row[j];
+				}
+			}
+		}
+	}
+}
+
+template <typename T>
+void M::spmm(const BsrMatrix<T>& a, ConstMatrixView<detail::no_deduce_t<T>> b, MatrixView<T> c, int threads)
+{
+	if (a.get_cols() != b.get_rows() || a.get_rows() != c.get_rows() || b.get_cols() != c.get_cols()) {
+		throw std::invalid_argument{"Failed to multiply matrices"};
+	}
+	M_TRACE_SCOPE("spmm bsr");
+	threads = std::max(threads, 1);
+	const size_t n = c.get_cols(), rows = a.get_rows(), cols = a.get_cols(), bs = a.get_block();
+	const std::vector<size_t>& row_ptr = a.get_row_ptr();
+	const sparse_index* col_idx = a.get_col_idx().data();
+	const T* values = a.get_values().data();
+	const std::vector<size_t> bounds = detail::balanced_partition(row_ptr, static_cast<size_t>(threads));
+	const long parts = static_cast<long>(bounds.size() - 1);
+
+	// Строка C собирается целиком, пока лежит в L1; строки B блочной строки A нужны всем bs строкам C
+	// подряд и остаются в L2.
+#pragma omp parallel for num_threads(threads) schedule(static, 1) if(threads > 1)
+	for (long part = 0; part < parts; ++part) {
+		for (size_t bi = bounds[part]; bi < bounds[part + 1]; ++bi) {
+			const size_t h = std::min(bs, rows - bi * bs);
+			for (size_t i = 0; i < h; ++i) {
+				T* c_row = c.row(bi * bs + i);
+				for (size_t blk = row_ptr[bi]; blk < row_ptr[bi + 1]; ++blk) {
+					const size_t first_col = static_cast<size_t>(col_idx[blk]) * bs;
+					const size_t w = std::min(bs, cols - first_col);
+					const T* block = values + blk * bs * bs;
+					for (size_t kk = 0; kk < w; ++kk) {
+						const T value = block[i * bs + kk];
+						const T* b_row = b.row(first_col + kk);
+						for (size_t j = 0; j < n; ++j) {
+							c_row[j] += value * b_row[j];
+						}
+					}
+				}
+			}
+		}
+	}
+}
+
+template <typename T>
+void M::spmv(const CsrMatrix<T>& a, const T* x, T* y, int threads)
+{
+	M_TRACE_SCOPE("spmv csr");
+	threads = std::max(threads, 1);
+	const std::vector<size_t>& row_ptr = a.get_row_ptr();
+	const sparse_index* col_idx = a.get_col_idx().data();
+	const T* values = a.get_values().data();
+	const std::vector<size_t> bounds = detail::balanced_partition(row_ptr, static_cast<size_t>(threads));
+	const long parts = static_cast<long>(bounds.size() - 1);
+
+#pragma omp parallel for num_threads(threads) schedule(static, 1) if(threads > 1)
+	for (long part = 0; part < parts; ++part) {
+		for (size_t i = bounds[part]; i < bounds[part + 1]; ++i) {
+			T sum{};
+			for (size_t p = row_ptr[i]; p < row_ptr[i + 1]; ++p) {
+				sum += values[p] * x[col_idx[p]];
+			}
+			y[i] += sum;
+		}
+	}
+}
+
+template <typename T>
+void M::spmv(const BsrMatrix<T>& a, const T* x, T* y, int threads)
+{
+	M_TRACE_SCOPE("spmv bsr");
+	threads = std::max(threads, 1);
+	const size_t rows = a.get_rows(), cols = a.get_cols(), bs = a.get_block();
+	const std::vector<size_t>& row_ptr = a.get_row_ptr();
+	const sparse_index* col_idx = a.get_col_idx().data();
+	const T* values = a.get_values().data();
+	const std::vector<size_t> bounds = detail::balanced_partition(row_ptr, static_cast<size_t>(threads));
+	const long parts = static_cast<long>(bounds.size() - 1);
+
+#pragma omp parallel for num_threads(threads) schedule(static, 1) if(threads > 1)
+	for (long part = 0; part < parts; ++part) {
+		for (size_t bi = bounds[part]; bi < bounds[part + 1]; ++bi) {
+			const size_t h = std::min(bs, rows - bi * bs);
+			for (size_t blk = row_ptr[bi]; blk < row_ptr[bi + 1]; ++blk) {
+				const size_t first_col = static_cast<size_t>(col_idx[blk]) * bs;
+				const size_t w = std::min(bs, cols - first_col);
+				const T* block = values + blk * bs * bs;
+				for (size_t i = 0; i < h; ++i) {
+					T sum{};
+					for (size_t kk = 0; kk < w; ++kk) {
+						sum += block[i * bs + kk] * x[first_col + kk];
+					}
+					y[bi * bs + i] += sum;
+				}
+			}
+		}
+	}
+}
+
+template <typename T>
+M::CsrMatrix<T> M::random_sparse(size_t rows, size_t cols, double density, const T& min_val, const T& max_val,
+	uint64_t seed, size_t block, int threads)
+{
+	if (density < 0.0 || density > 1.0) {
+		throw std::invalid_argument{"[random_sparse]Density must be in [0, 1]."};
+	}
+	if (block == 0) {
+		throw std::invalid_argument{"[random_sparse]Block size must be positive."};
+	}
+	detail::check_index_range(cols, "random_sparse");
+	threads = std::max(threads, 1);
+	// Маска и значения берутся из разных потоков Philox: seed и seed + 1.
+	const auto kept = [&](size_t i, size_t j) {
+		return RandomGenerator::value_at<double>(seed, i / block, j / block, 0.0, 1.0) < density;
+	};
+
+	// Два прохода: сначала число ненулевых в каждой строке, затем заполнение на своих местах.
+	std::vector<size_t> row_ptr(rows + 1, 0);
+	const long n_rows = static_cast<long>(rows);
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+	for (long i = 0; i < n_rows; ++i) {
+		size_t count = 0;
+		for (size_t j = 0; j < cols; ++j) {
+			count += kept(i, j);
+		}
+		row_ptr[i + 1] = count;
+	}
+	for (size_t i = 0; i < rows; ++i) {
+		row_ptr[i + 1] += row_ptr[i];
+	}
+
+	std::vector<sparse_index> col_idx(row_ptr.back());
+	std::vector<T> values(row_ptr.back());
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+	for (long i = 0; i < n_rows; ++i) {
+		size_t p = row_ptr[i];
+		for (size_t j = 0; j < cols; ++j) {
+			if (kept(i, j)) {
+				col_idx[p] = static_cast<sparse_index>(j);
+				values[p] = RandomGenerator::value_at<T>(seed + 1, i, j, min_val, max_val);
+				++p;
+			}
+		}
+	}
+	return CsrMatrix<T>(rows, cols, std::move(row_ptr), std::move(col_idx), std::move(values));
+}
+
+#endif // SPARSE_H
@@ -2,17 +2,94 @@
 #define STAT_H
 
 #include <iostream>
+#include <array>
 #include <chrono>
+#include <cstddef>
+#include <string>
 #include <vector>
 
+enum class PerfEvent { Cycles, Instructions, L1DMisses, LLCMisses, DTLBMisses, BranchMisses };
+constexpr size_t PERF_EVENT_COUNT = 6;
+
+const char* to_string(PerfEvent event);
+
+// Значения счётчиков за один замер, просуммированные по всем потокам процесса.
+struct PerfSample {
+    std::array<double, PERF_EVENT_COUNT> values{};
+    std::array<bool, PERF_EVENT_COUNT> valid{};
+
+    // Нет ни одного открытого счётчика.
+    bool empty() const;
+    // Счётчик открыт и посчитан; вытесненный мультиплексированием хранится как NaN и сюда не проходит.
+    bool has(PerfEvent event) const;
+    double get(PerfEvent event) const;
+    // Инструкций за такт; NaN, если счётчики недоступны.
+    double ipc() const;
+    // Событий на 1000 операций; NaN, если счётчик недоступен.
+    double per_kflop(PerfEvent event, double flops) const;
+
+    PerfSample& operator+=(const PerfSample& other);
+};
+
+// Аппаратные счётчики через perf_event_open (только Linux).
+// start() открывает счётчики на каждом уже существующем потоке процесса (/proc/self/task),
+// поэтому в сумму попадают рабочие OpenMP и пула. Потоки, созданные после start(), не считаются —
+// перед замером нужен прогрев. Если доступ закрыт (perf_event_paranoid, контейнер, не Linux),
+// start()/stop() ничего не делают, а PerfSample остаётся пустым.
+class PerfCounters {
+public:
+    PerfCounters() = default;
+    ~PerfCounters();
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    void start();
+    PerfSample stop();
+
+    // Причина, по которой последний start() не открыл ни одного счётчика; пусто, если всё в порядке.
+    const std::string& unavailable_reason() const;
+
+private:
+    struct Counter {
+        int fd;
+        PerfEvent event;
+    };
+
+    void close_all();
+
+    std::vector<Counter> _counters;
+    std::string _reason;
+};
+
 class ExecutionTimer {
 private:
     std::chrono::time_point<std::chrono::high_resolution_clock> _start, _end;
     std::chrono::duration<double> _duration;
+    bool _verbose;
+    PerfCounters* _counters;
+    PerfSample _sample;
 public:
-    ExecutionTimer();
+    // verbose = false — stop() ничего не печатает (для повторных замеров в бенчмарке).
+    // counters — необязательная группа счётчиков, запускается вместе с таймером.
+    explicit ExecutionTimer(bool verbose = true, PerfCounters* counters = nullptr);
     void stop();
     double get_duration() const;
+    const PerfSample& get_counters() const;
 };
 
-#endif //STAT_H
\ No newline at end of file
+// Сводка по повторным замерам одного прогона, в секундах.
+struct BenchmarkStats {
+    double min = 0;
+    double median = 0;
+    double p95 = 0;
+    double mean = 0;
+    double stddev = 0;
+};
+
+// stddev — выборочное (n - 1), p95 — по ближайшему рангу.
+BenchmarkStats compute_stats(std::vector<double> samples);
+
+// 2 * m * n * k операций за seconds секунд, в миллиардах в секунду.
+double gflops(size_t m, size_t n, size_t k, double seconds);
+
+#endif //STAT_H
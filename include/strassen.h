@@ -0,0 +1,193 @@
+#ifndef STRASSEN_H
+#define STRASSEN_H
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+#include "gemm.h"
+#include "matrix.h"
+#include "matrix_view.h"
+#include "trace.h"
+#include "tuning.h"
+
+namespace M
+{
+	constexpr size_t STRASSEN_DEFAULT_CUTOFF = 256;
+
+	// Умножение по схеме Штрассена-Винограда (7 умножений, 15 сложений на уровень).
+	// Рекурсия идёт, пока наименьшая из размерностей больше cutoff, дальше работает gemm.
+	// Нечётные размерности обрабатываются отщеплением последней строки/столбца.
+	// Нулевой cutoff — подобранный автотюнером для этого размера, иначе STRASSEN_DEFAULT_CUTOFF.
+	template <typename T, typename Alloc>
+	Matrix<T, Alloc> strassen_multiply(const Matrix<T, Alloc>& lhs, const Matrix<T, Alloc>& rhs,
+		size_t cutoff = 0, int threads = 1);
+
+	// C(m x n) = A(m x k) * B(k x n), C перезаписывается. Нулевой cutoff — как в strassen_multiply.
+	template <typename T>
+	void strassen_gemm(size_t m, size_t n, size_t k,
+		const T* a, size_t lda,
+		const T* b, size_t ldb,
+		T* c, size_t ldc,
+		size_t cutoff);
+
+	template <typename T>
+	void strassen_gemm(ConstMatrixView<detail::no_deduce_t<T>> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+		MatrixView<T> c, size_t cutoff);
+
+	namespace detail
+	{
+		// Глубина, до которой подзадачи порождаются как задачи OpenMP.
+		constexpr int STRASSEN_TASK_DEPTH = 3;
+
+		template <typename T, typename Op>
+		void combine(size_t rows, size_t cols, const T* x, size_t ldx, const T* y, size_t ldy,
+			T* out, size_t ldo, Op op)
+		{
+			for (size_t i = 0; i < rows; ++i) {
+				for (size_t j = 0; j < cols; ++j) {
+					out[i * ldo + j] = op(x[i * ldx + j], y[i * ldy + j]);
+				}
+			}
+		}
+
+		template <typename T>
+		void zero_fill(size_t rows, size_t cols, T* c, size_t ldc)
+		{
+			for (size_t i = 0; i < rows; ++i) {
+				std::fill(c + i * ldc, c + i * ldc + cols, T{});
+			}
+		}
+
+		template <typename T>
+		void strassen_rec(size_t m, size_t n, size_t k,
+			const T* a, size_t lda, const T* b, size_t ldb, T* c, size_t ldc,
+			size_t cutoff, int depth)
+		{
+			if (std::min({m, n, k}) <= std::max<size_t>(cutoff, 1)) {
+				zero_fill(m, n, c, ldc);
+				gemm(m, n, k, a, lda, b, ldb, c, ldc);
+				return;
+			}
+
+			const size_t mh = m / 2, nh = n / 2, kh = k / 2;
+			const T* A11 = a;
+			const T* A12 = a + kh;
+			const T* A21 = a + mh * lda;
+			const T* A22 = A21 + kh;
+			const T* B11 = b;
+			const T* B12 = b + nh;
+			const T* B21 = b + kh * ldb;
+			const T* B22 = B21 + nh;
+			T* C11 = c;
+			T* C12 = c + nh;
+			T* C21 = c + mh * ldc;
+			T* C22 = C21 + nh;
+
+			const auto plus = [](T x, T y) { return x + y; };
+			const auto minus = [](T x, T y) { return x - y; };
+
+			std::vector<T> S1(mh * kh), S2(mh * kh), S3(mh * kh), S4(mh * kh);
+			std::vector<T> T1(kh * nh), T2(kh * nh), T3(kh * nh), T4(kh * nh);
+			combine(mh, kh, A21, lda, A22, lda, S1.data(), kh, plus);
+			combine(mh, kh, S1.data(), kh, A11, lda, S2.data(), kh, minus);
+			combine(mh, kh, A11, lda, A21, lda, S3.data(), kh, minus);
+			combine(mh, kh, A12, lda, S2.data(), kh, S4.data(), kh, minus);
+			combine(kh, nh, B12, ldb, B11, ldb, T1.data(), nh, minus);
+			combine(kh, nh, B22, ldb, T1.data(), nh, T2.data(), nh, minus);
+			combine(kh, nh, B22, ldb, B12, ldb, T3.data(), nh, minus);
+			combine(kh, nh, T2.data(), nh, B21, ldb, T4.data(), nh, minus);
+
+			std::vector<T> P[7];
+			for (auto& p : P) {
+				p.resize(mh * nh);
+			}
+			const T* lhs[7] = {A11, A12, S4.data(), A22, S1.data(), S2.data(), S3.data()};
+			const size_t ldl[7] = {lda, lda, kh, lda, kh, kh, kh};
+			const T* rhs[7] = {B11, B21, B22, T4.data(), T1.data(), T2.data(), T3.data()};
+			const size_t ldr[7] = {ldb, ldb, ldb, nh, nh, nh, nh};
+
+			for (int i = 0; i < 7; ++i) {
+#pragma omp task default(shared) firstprivate(i) if(depth < STRASSEN_TASK_DEPTH)
+				strassen_rec(mh, nh, kh, lhs[i], ldl[i], rhs[i], ldr[i], P[i].data(), nh, cutoff, depth + 1);
+			}
+#pragma omp taskwait
+
+			// U2 = P1 + P6, U3 = U2 + P7, U4 = U2 + P5
+			for (size_t i = 0; i < mh; ++i) {
+				for (size_t j = 0; j < nh; ++j) {
+					const size_t idx = i * nh + j;
+					const T u2 = P[0][idx] + P[5][idx];
+					const T u3 = u2 + P[6][idx];
+					const T u4 = u2 + P[4][idx];
+					C11[i * ldc + j] = P[0][idx] + P[1][idx];
+					C12[i * ldc + j] = u4 + P[2][idx];
+					C21[i * ldc + j] = u3 - P[3][idx];
+					C22[i * ldc + j] = u3 + P[4][idx];
+				}
+			}
+
+			const size_t m2 = 2 * mh, n2 = 2 * nh, k2 = 2 * kh;
+			// Отщеплённый столбец A / строка B: ранг-1 поправка к чётной части C.
+			if (k2 != k) {
+				gemm(m2, n2, 1, a + k2, lda, b + k2 * ldb, ldb, c, ldc);
+			}
+			// Последний столбец C и последняя строка C считаются обычным ядром.
+			if (n2 != n) {
+				zero_fill(m, 1, c + n2, ldc);
+				gemm(m, 1, k, a, lda, b + n2, ldb, c + n2, ldc);
+			}
+			if (m2 != m) {
+				zero_fill(1, n2, c + m2 * ldc, ldc);
+				gemm(1, n2, k, a + m2 * lda, lda, b, ldb, c + m2 * ldc, ldc);
+			}
+		}
+	}
+}
+
+template <typename T>
+void M::strassen_gemm(size_t m, size_t n, size_t k,
+	const T* a, size_t lda,
+	const T* b, size_t ldb,
+	T* c, size_t ldc,
+	size_t cutoff)
+{
+	if (cutoff == 0) {
+		cutoff = tuned_strassen_cutoff<T>(m, n, k, STRASSEN_DEFAULT_CUTOFF);
+	}
+	detail::strassen_rec(m, n, k, a, lda, b, ldb, c, ldc, cutoff, 0);
+}
+
+template <typename T>
+void M::strassen_gemm(ConstMatrixView<detail::no_deduce_t<T>> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+	MatrixView<T> c, size_t cutoff)
+{
+	if (a.get_cols() != b.get_rows() || a.get_rows() != c.get_rows() || b.get_cols() != c.get_cols()) {
+		throw std::invalid_argument{"Failed to multiply matrices"};
+	}
+	strassen_gemm(a.get_rows(), b.get_cols(), a.get_cols(),
+		a.get_data(), a.get_ld(),
+		b.get_data(), b.get_ld(),
+		c.get_data(), c.get_ld(),
+		cutoff);
+}
+
+template <typename T, typename Alloc>
+M::Matrix<T, Alloc> M::strassen_multiply(const Matrix<T, Alloc>& lhs, const Matrix<T, Alloc>& rhs,
+	size_t cutoff, int threads)
+{
+	if (lhs.get_cols() != rhs.get_rows()) {
+		throw std::invalid_argument{"Failed to multiply matrices"};
+	}
+	M_TRACE_SCOPE("strassen");
+	Matrix<T, Alloc> result(lhs.get_rows(), rhs.get_cols());
+
+#pragma omp parallel num_threads(threads) if(threads > 1)
+#pragma omp single
+	strassen_gemm(lhs.view(), rhs.view(), result.view(), cutoff);
+
+	return result;
+}
+
+#endif // STRASSEN_H
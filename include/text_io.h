@@ -0,0 +1,132 @@
+#ifndef TEXT_IO_H
+#define TEXT_IO_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "matrix_view.h"
+#include "trace.h"
+
+namespace M
+{
+	// Раскладка текстового файла: после каждого элемента ставится separator,
+	// строка матрицы заканчивается '\n'. header — первая строка "rows cols".
+	// Matrix::write_to_file пишет {'\t', false}, openmp.cc — {' ', true}.
+	struct TextLayout
+	{
+		char separator = '\t';
+		bool header = false;
+	};
+
+	// Строки форматируются блоками параллельно (to_chars), каждый блок уходит в файл одной записью.
+	// Принимает и MatrixView<T>, и ConstMatrixView<T>.
+	template <typename T>
+	void write_text(const std::string& filename, MatrixView<T> matrix,
+		TextLayout layout = {}, int threads = 1);
+
+	namespace detail
+	{
+		// Целые — как есть, вещественные — как operator<< по умолчанию (%g, 6 знаков).
+		template <typename T>
+		char* format_value(char* first, char* last, T value)
+		{
+			if constexpr (std::is_floating_point_v<T>) {
+				return std::to_chars(first, last, value, std::chars_format::general, 6).ptr;
+			}
+			else {
+				return std::to_chars(first, last, value).ptr;
+			}
+		}
+
+		constexpr size_t TEXT_MAX_VALUE_CHARS = 32;
+		constexpr size_t TEXT_CHUNK_BYTES = 4 * 1024 * 1024;
+
+		template <typename T>
+		size_t format_rows(ConstMatrixView<T> matrix, size_t first_row, size_t last_row, char sep,
+			std::vector<char>& buffer)
+		{
+			buffer.resize((last_row - first_row) * (matrix.get_cols() * (TEXT_MAX_VALUE_CHARS + 1) + 1));
+			char* out = buffer.data();
+			char* const end = buffer.data() + buffer.size();
+			for (size_t i = first_row; i < last_row; ++i) {
+				const T* row = matrix.row(i);
+				for (size_t j = 0; j < matrix.get_cols(); ++j) {
+					out = format_value(out, end, row[j]);
+					*out++ = sep;
+				}
+				*out++ = '\n';
+			}
+			return static_cast<size_t>(out - buffer.data());
+		}
+
+		struct FileCloser
+		{
+			void operator()(std::FILE* file) const noexcept { std::fclose(file); }
+		};
+	}
+}
+
+template <typename T>
+void M::write_text(const std::string& filename, MatrixView<T> view, TextLayout layout, int threads)
+{
+	M_TRACE_SCOPE("write_text");
+	const ConstMatrixView<std::remove_const_t<T>> matrix = view;
+	std::unique_ptr<std::FILE, detail::FileCloser> file{std::fopen(filename.c_str(), "wb")};
+	if (!file) {
+		throw std::runtime_error("[write_text]Couldn't open the file for writing.");
+	}
+	// Буферизация stdio не нужна: блоки и так большие, пусть каждый будет одним write.
+	std::setvbuf(file.get(), nullptr, _IONBF, 0);
+
+	if (layout.header) {
+		const std::string header = std::to_string(matrix.get_rows()) + " " + std::to_string(matrix.get_cols()) + "\n";
+		if (std::fwrite(header.data(), 1, header.size(), file.get()) != header.size()) {
+			throw std::runtime_error("[write_text]Failed to write the file.");
+		}
+	}
+
+	const size_t rows = matrix.get_rows();
+	const size_t row_bytes = matrix.get_cols() * (detail::TEXT_MAX_VALUE_CHARS + 1) + 1;
+	const size_t chunk_rows = std::max<size_t>(1, detail::TEXT_CHUNK_BYTES / row_bytes);
+	const size_t chunks = (rows + chunk_rows - 1) / chunk_rows;
+	const size_t batch = static_cast<size_t>(std::max(threads, 1));
+
+	std::vector<std::vector<char>> buffers(std::min(batch, std::max<size_t>(chunks, 1)));
+	std::vector<size_t> lengths(buffers.size());
+	bool failed = false;
+
+	// За один проход форматируется до threads блоков, затем они пишутся по порядку.
+	for (size_t first = 0; first < chunks && !failed; first += batch) {
+		const long count = static_cast<long>(std::min(batch, chunks - first));
+
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static, 1) if(threads > 1)
+#endif
+		for (long c = 0; c < count; ++c) {
+			M_TRACE_SCOPE("format rows");
+			const size_t begin = (first + c) * chunk_rows;
+			const size_t end = std::min(rows, begin + chunk_rows);
+			lengths[c] = detail::format_rows(matrix, begin, end, layout.separator, buffers[c]);
+		}
+
+		M_TRACE_SCOPE("fwrite");
+		for (long c = 0; c < count; ++c) {
+			if (std::fwrite(buffers[c].data(), 1, lengths[c], file.get()) != lengths[c]) {
+				failed = true;
+				break;
+			}
+		}
+	}
+
+	if (failed || std::fflush(file.get()) != 0) {
+		throw std::runtime_error("[write_text]Failed to write the file.");
+	}
+}
+
+#endif // TEXT_IO_H
@@ -0,0 +1,317 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "trace.h"
+
+namespace M
+{
+	// Постоянный пул потоков с очередью у каждого рабочего и кражей задач.
+	// Свои задачи рабочий берёт с конца очереди (LIFO, данные ещё в кэше),
+	// чужие крадёт с начала. Поток, который ждёт задачи (TaskGroup::wait),
+	// не спит, а выполняет задачи из пула — поэтому вложенный параллелизм
+	// не создаёт новых потоков.
+	class ThreadPool
+	{
+	public:
+		using Task = std::function<void()>;
+
+		// threads — число участников вместе с вызывающим потоком, рабочих создаётся threads - 1.
+		explicit ThreadPool(size_t threads = std::thread::hardware_concurrency());
+		~ThreadPool();
+		ThreadPool(const ThreadPool&) = delete;
+		ThreadPool& operator=(const ThreadPool&) = delete;
+
+		// Общий пул на все ядра, создаётся при первом обращении.
+		static ThreadPool& instance();
+
+		size_t size() const noexcept;
+
+		void submit(Task task);
+
+		// Выполняет одну задачу из пула, если она есть.
+		bool try_run_one();
+
+		// body(first, last) для кусков [begin, end) размером не меньше grain.
+		// Одновременно работает не больше max_tasks кусков (0 — сколько потоков в пуле).
+		template <typename F>
+		void parallel_for(size_t begin, size_t end, size_t grain, F&& body, size_t max_tasks = 0);
+
+	private:
+		struct Worker
+		{
+			std::mutex mutex;
+			std::deque<Task> tasks;
+		};
+
+		void worker_loop(size_t index);
+		bool pop_local(size_t index, Task& task);
+		bool steal(size_t thief, Task& task);
+
+		std::vector<std::unique_ptr<Worker>> _queues;
+		std::vector<std::thread> _threads;
+		std::atomic<size_t> _queued{0};
+		std::atomic<size_t> _next_queue{0};
+		std::mutex _sleep_mutex;
+		std::condition_variable _wake;
+		bool _stop = false;
+	};
+
+	// Группа задач с общим ожиданием. Первое исключение из задач пробрасывается из wait().
+	class TaskGroup
+	{
+	public:
+		explicit TaskGroup(ThreadPool& pool = ThreadPool::instance()) noexcept;
+		~TaskGroup();
+		TaskGroup(const TaskGroup&) = delete;
+		TaskGroup& operator=(const TaskGroup&) = delete;
+
+		template <typename F>
+		void run(F&& task);
+
+		void wait();
+
+	private:
+		ThreadPool& _pool;
+		std::atomic<size_t> _pending{0};
+		std::mutex _error_mutex;
+		std::exception_ptr _error;
+	};
+
+	namespace detail
+	{
+		// Пул и номер очереди рабочего, на котором выполняется текущий поток.
+		struct PoolWorkerSlot
+		{
+			ThreadPool* pool = nullptr;
+			size_t index = 0;
+		};
+
+		inline PoolWorkerSlot& current_worker() noexcept
+		{
+			thread_local PoolWorkerSlot slot;
+			return slot;
+		}
+
+		// Сколько раз свободный рабочий пробует украсть задачу, прежде чем уснуть.
+		constexpr int POOL_SPIN_TRIES = 64;
+	}
+}
+
+inline M::ThreadPool::ThreadPool(size_t threads)
+{
+	const size_t workers = std::max<size_t>(threads, 1) - 1;
+	// Последняя очередь — для задач от потоков, не входящих в пул.
+	for (size_t i = 0; i <= workers; ++i) {
+		_queues.push_back(std::make_unique<Worker>());
+	}
+	for (size_t i = 0; i < workers; ++i) {
+		_threads.emplace_back([this, i] { worker_loop(i); });
+	}
+}
+
+inline M::ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock{_sleep_mutex};
+		_stop = true;
+	}
+	_wake.notify_all();
+	for (std::thread& thread : _threads) {
+		thread.join();
+	}
+}
+
+inline M::ThreadPool& M::ThreadPool::instance()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+inline size_t M::ThreadPool::size() const noexcept
+{
+	return _threads.size() + 1;
+}
+
+inline void M::ThreadPool::submit(Task task)
+{
+	const detail::PoolWorkerSlot& slot = detail::current_worker();
+	size_t index = _queues.size() - 1;
+	if (slot.pool == this) {
+		index = slot.index;
+	}
+	else if (!_threads.empty()) {
+		index = _next_queue.fetch_add(1, std::memory_order_relaxed) % _threads.size();
+	}
+	{
+		std::lock_guard<std::mutex> lock{_queues[index]->mutex};
+		_queues[index]->tasks.push_back(std::move(task));
+	}
+	{
+		// Под мьютексом сна, чтобы рабочий не пропустил пробуждение между проверкой и wait.
+		std::lock_guard<std::mutex> lock{_sleep_mutex};
+		_queued.fetch_add(1, std::memory_order_release);
+	}
+	_wake.notify_one();
+}
+
+inline bool M::ThreadPool::pop_local(size_t index, Task& task)
+{
+	Worker& worker = *_queues[index];
+	std::lock_guard<std::mutex> lock{worker.mutex};
+	if (worker.tasks.empty()) {
+		return false;
+	}
+	task = std::move(worker.tasks.back());
+	worker.tasks.pop_back();
+	_queued.fetch_sub(1, std::memory_order_relaxed);
+	return true;
+}
+
+inline bool M::ThreadPool::steal(size_t thief, Task& task)
+{
+	const size_t count = _queues.size();
+	for (size_t offset = 1; offset <= count; ++offset) {
+		Worker& victim = *_queues[(thief + offset) % count];
+		std::lock_guard<std::mutex> lock{victim.mutex};
+		if (!victim.tasks.empty()) {
+			task = std::move(victim.tasks.front());
+			victim.tasks.pop_front();
+			_queued.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+inline bool M::ThreadPool::try_run_one()
+{
+	if (_queued.load(std::memory_order_acquire) == 0) {
+		return false;
+	}
+	const detail::PoolWorkerSlot& slot = detail::current_worker();
+	const size_t index = slot.pool == this ? slot.index : _queues.size() - 1;
+	Task task;
+	if (pop_local(index, task) || steal(index, task)) {
+		task();
+		return true;
+	}
+	return false;
+}
+
+inline void M::ThreadPool::worker_loop(size_t index)
+{
+	detail::current_worker() = {this, index};
+	M_TRACE_THREAD_NAME("pool worker " + std::to_string(index));
+	Task task;
+	for (;;) {
+		bool found = false;
+		for (int attempt = 0; attempt < detail::POOL_SPIN_TRIES && !found; ++attempt) {
+			found = pop_local(index, task) || steal(index, task);
+			if (!found) {
+				std::this_thread::yield();
+			}
+		}
+		if (found) {
+			task();
+			task = nullptr;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock{_sleep_mutex};
+		_wake.wait(lock, [this] { return _stop || _queued.load(std::memory_order_acquire) > 0; });
+		if (_stop && _queued.load(std::memory_order_acquire) == 0) {
+			return;
+		}
+	}
+}
+
+template <typename F>
+void M::ThreadPool::parallel_for(size_t begin, size_t end, size_t grain, F&& body, size_t max_tasks)
+{
+	if (begin >= end) {
+		return;
+	}
+	grain = std::max<size_t>(grain, 1);
+	const size_t pieces = (end - begin + grain - 1) / grain;
+	const size_t tasks = std::min(pieces, max_tasks ? max_tasks : size());
+	if (tasks <= 1) {
+		body(begin, end);
+		return;
+	}
+
+	// Куски раздаются через общий счётчик: задача, закончившая раньше, берёт следующий.
+	std::atomic<size_t> next{0};
+	const auto drain = [&] {
+		for (size_t piece = next.fetch_add(1); piece < pieces; piece = next.fetch_add(1)) {
+			const size_t first = begin + piece * grain;
+			body(first, std::min(end, first + grain));
+		}
+	};
+
+	TaskGroup group{*this};
+	for (size_t t = 1; t < tasks; ++t) {
+		group.run(drain);
+	}
+	drain();
+	group.wait();
+}
+
+inline M::TaskGroup::TaskGroup(ThreadPool& pool) noexcept :
+	_pool{pool}
+{ }
+
+inline M::TaskGroup::~TaskGroup()
+{
+	try {
+		wait();
+	}
+	catch (...) {
+	}
+}
+
+template <typename F>
+void M::TaskGroup::run(F&& task)
+{
+	_pending.fetch_add(1, std::memory_order_relaxed);
+	_pool.submit([this, task = std::forward<F>(task)]() mutable {
+		try {
+			task();
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock{_error_mutex};
+			if (!_error) {
+				_error = std::current_exception();
+			}
+		}
+		_pending.fetch_sub(1, std::memory_order_release);
+	});
+}
+
+inline void M::TaskGroup::wait()
+{
+	while (_pending.load(std::memory_order_acquire) != 0) {
+		if (!_pool.try_run_one()) {
+			std::this_thread::yield();
+		}
+	}
+	if (_error) {
+		std::exception_ptr error = std::exchange(_error, nullptr);
+		std::rethrow_exception(error);
+	}
+}
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,18 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <chrono>
+
+namespace M
+{
+	namespace detail
+	{
+		// Секунды монотонного времени с момента start.
+		inline double seconds_since(std::chrono::steady_clock::time_point start)
+		{
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		}
+	}
+}
+
+#endif // TIMER_H
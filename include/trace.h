@@ -0,0 +1,273 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Трассировка отрезков времени в формате Chrome trace-event (открывается в chrome://tracing и Perfetto).
+// M_TRACE_SCOPE("name") записывает отрезок от точки объявления до конца области видимости
+// в кольцевой буфер текущего потока. Без M_TRACE макросы раскрываются в пустоту и ничего не стоят.
+// Имена — строковые литералы: хранится только указатель.
+#ifdef M_TRACE
+#define M_TRACE_CONCAT_IMPL(a, b) a##b
+#define M_TRACE_CONCAT(a, b) M_TRACE_CONCAT_IMPL(a, b)
+#define M_TRACE_SCOPE(name) const M::TraceSpan M_TRACE_CONCAT(trace_span_, __LINE__){name}
+#define M_TRACE_THREAD_NAME(name) M::set_trace_thread_name(name)
+#else
+#define M_TRACE_SCOPE(name) ((void)0)
+#define M_TRACE_THREAD_NAME(name) ((void)0)
+#endif
+
+namespace M
+{
+	struct TraceEvent
+	{
+		const char* name;
+		int64_t start_ns;
+		int64_t end_ns;
+	};
+
+	// Кольцо событий одного потока. Пишет только поток-владелец, поэтому запись без блокировок:
+	// слот заполняется, затем публикуется счётчиком head. При переполнении старые события затираются.
+	class TraceBuffer
+	{
+	public:
+		static constexpr size_t CAPACITY = size_t{1} << 16;
+
+		TraceBuffer(int tid, std::string name);
+
+		void record(const char* name, int64_t start_ns, int64_t end_ns) noexcept;
+		// Последние записанные события; вызывать, когда поток не пишет (после join или барьера).
+		std::vector<TraceEvent> snapshot() const;
+
+		int tid() const noexcept;
+		const std::string& name() const noexcept;
+		void set_name(std::string name);
+
+	private:
+		std::unique_ptr<TraceEvent[]> _events;
+		std::atomic<size_t> _head{0};
+		int _tid;
+		std::string _name;
+	};
+
+	// Наносекунды от общего для процесса начала отсчёта (steady_clock).
+	int64_t trace_now_ns() noexcept;
+
+	// Буфер текущего потока, регистрируется при первом обращении.
+	TraceBuffer& trace_buffer();
+	void set_trace_thread_name(std::string name);
+
+	// Номер процесса в трассе (ранг MPI) и сдвиг часов этого процесса относительно эталонного.
+	void set_trace_process(int pid, int64_t clock_offset_ns);
+
+	// События всех потоков процесса в виде элементов массива traceEvents, через запятую.
+	std::string trace_events_json();
+
+	// Полный файл трассы только этого процесса.
+	void write_trace(const std::string& filename);
+
+	class TraceSpan
+	{
+	public:
+		explicit TraceSpan(const char* name);
+		~TraceSpan();
+		TraceSpan(const TraceSpan&) = delete;
+		TraceSpan& operator=(const TraceSpan&) = delete;
+
+	private:
+		TraceBuffer& _buffer;
+		const char* _name;
+		int64_t _start;
+	};
+
+	namespace detail
+	{
+		struct TraceRegistry
+		{
+			std::mutex mutex;
+			// Буферы живут до конца программы, даже если их поток уже завершился.
+			std::vector<std::unique_ptr<TraceBuffer>> buffers;
+			int pid = 0;
+			int64_t clock_offset_ns = 0;
+			const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+		};
+
+		inline TraceRegistry& trace_registry()
+		{
+			static TraceRegistry registry;
+			return registry;
+		}
+
+		// Микросекунды с дробной частью, как ожидает формат Chrome.
+		inline void append_us(std::string& out, int64_t ns)
+		{
+			char buf[32];
+			std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(ns) / 1000.0);
+			out += buf;
+		}
+
+		inline void append_json_string(std::string& out, const char* text)
+		{
+			out += '"';
+			for (; *text; ++text) {
+				if (*text == '"' || *text == '\\') {
+					out += '\\';
+				}
+				out += *text;
+			}
+			out += '"';
+		}
+	}
+}
+
+inline M::TraceBuffer::TraceBuffer(int tid, std::string name) :
+	_events{new TraceEvent[CAPACITY]},
+	_tid{tid},
+	_name{std::move(name)}
+{ }
+
+inline void M::TraceBuffer::record(const char* name, int64_t start_ns, int64_t end_ns) noexcept
+{
+	const size_t head = _head.load(std::memory_order_relaxed);
+	_events[head % CAPACITY] = {name, start_ns, end_ns};
+	_head.store(head + 1, std::memory_order_release);
+}
+
+inline std::vector<M::TraceEvent> M::TraceBuffer::snapshot() const
+{
+	const size_t head = _head.load(std::memory_order_acquire);
+	const size_t first = head > CAPACITY ? head - CAPACITY : 0;
+	std::vector<TraceEvent> events;
+	events.reserve(head - first);
+	for (size_t i = first; i < head; ++i) {
+		events.push_back(_events[i % CAPACITY]);
+	}
+	return events;
+}
+
+inline int M::TraceBuffer::tid() const noexcept
+{
+	return _tid;
+}
+
+inline const std::string& M::TraceBuffer::name() const noexcept
+{
+	return _name;
+}
+
+inline void M::TraceBuffer::set_name(std::string name)
+{
+	std::lock_guard<std::mutex> lock{detail::trace_registry().mutex};
+	_name = std::move(name);
+}
+
+inline int64_t M::trace_now_ns() noexcept
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - detail::trace_registry().epoch).count();
+}
+
+inline M::TraceBuffer& M::trace_buffer()
+{
+	thread_local TraceBuffer* buffer = nullptr;
+	if (!buffer) {
+		detail::TraceRegistry& registry = detail::trace_registry();
+		std::lock_guard<std::mutex> lock{registry.mutex};
+		const int tid = static_cast<int>(registry.buffers.size());
+		std::string name = tid == 0 ? "main" : "thread " + std::to_string(tid);
+#ifdef _OPENMP
+		// Рабочие OpenMP живут всё время программы, номер в первой команде и становится именем дорожки.
+		if (tid != 0 && omp_in_parallel()) {
+			name = "omp thread " + std::to_string(omp_get_thread_num());
+		}
+#endif
+		registry.buffers.push_back(std::make_unique<TraceBuffer>(tid, std::move(name)));
+		buffer = registry.buffers.back().get();
+	}
+	return *buffer;
+}
+
+inline void M::set_trace_thread_name(std::string name)
+{
+	trace_buffer().set_name(std::move(name));
+}
+
+inline void M::set_trace_process(int pid, int64_t clock_offset_ns)
+{
+	detail::TraceRegistry& registry = detail::trace_registry();
+	std::lock_guard<std::mutex> lock{registry.mutex};
+	registry.pid = pid;
+	registry.clock_offset_ns = clock_offset_ns;
+}
+
+inline std::string M::trace_events_json()
+{
+	using detail::append_json_string;
+	using detail::append_us;
+
+	detail::TraceRegistry& registry = detail::trace_registry();
+	std::lock_guard<std::mutex> lock{registry.mutex};
+	const std::string pid = std::to_string(registry.pid);
+
+	std::string out;
+	out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":0,\"args\":{\"name\":\"rank " + pid + "\"}}";
+	for (const std::unique_ptr<TraceBuffer>& buffer : registry.buffers) {
+		const std::string tid = std::to_string(buffer->tid());
+		out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"args\":{\"name\":";
+		append_json_string(out, buffer->name().c_str());
+		out += "}}";
+
+		for (const TraceEvent& event : buffer->snapshot()) {
+			out += ",\n{\"name\":";
+			append_json_string(out, event.name);
+			out += ",\"ph\":\"X\",\"pid\":" + pid + ",\"tid\":" + tid + ",\"ts\":";
+			append_us(out, event.start_ns + registry.clock_offset_ns);
+			out += ",\"dur\":";
+			append_us(out, event.end_ns - event.start_ns);
+			out += '}';
+		}
+	}
+	return out;
+}
+
+inline void M::write_trace(const std::string& filename)
+{
+	const std::string events = trace_events_json();
+	std::FILE* file = std::fopen(filename.c_str(), "wb");
+	if (!file) {
+		throw std::runtime_error("[write_trace]Couldn't open the file for writing.");
+	}
+	std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+	std::fwrite(events.data(), 1, events.size(), file);
+	std::fputs("\n]}\n", file);
+	if (std::fclose(file) != 0) {
+		throw std::runtime_error("[write_trace]Failed to write the file.");
+	}
+}
+
+inline M::TraceSpan::TraceSpan(const char* name) :
+	_buffer{trace_buffer()},
+	_name{name},
+	_start{trace_now_ns()}
+{ }
+
+inline M::TraceSpan::~TraceSpan()
+{
+	_buffer.record(_name, _start, trace_now_ns());
+}
+
+#endif // TRACE_H
@@ -0,0 +1,112 @@
+#ifndef TRACE_MPI_H
+#define TRACE_MPI_H
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <mpi.h>
+
+#include "trace.h"
+
+namespace M
+{
+	// Сдвиг часов ранга относительно ранга 0 в comm: несколько обменов «пинг-понг»,
+	// берётся обмен с наименьшей задержкой, время ранга 0 относится к середине обмена.
+	// Результат сразу передаётся в set_trace_process вместе с номером ранга.
+	int64_t trace_sync_clock(MPI_Comm comm);
+
+	// Собирает события всех рангов на root и пишет один файл: у каждого ранга своя группа дорожек.
+	void write_trace(const std::string& filename, MPI_Comm comm, int root = 0);
+
+	namespace detail
+	{
+		constexpr int TRACE_SYNC_ROUNDS = 8;
+		constexpr int TRACE_SYNC_TAG = 7001;
+	}
+}
+
+inline int64_t M::trace_sync_clock(MPI_Comm comm)
+{
+	int rank, num_procs;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &num_procs);
+
+	int64_t offset = 0;
+	MPI_Barrier(comm);
+	for (int peer = 1; peer < num_procs; ++peer) {
+		if (rank == 0) {
+			for (int round = 0; round < detail::TRACE_SYNC_ROUNDS; ++round) {
+				char ping;
+				MPI_Recv(&ping, 1, MPI_CHAR, peer, detail::TRACE_SYNC_TAG, comm, MPI_STATUS_IGNORE);
+				const int64_t now = trace_now_ns();
+				MPI_Send(&now, 1, MPI_INT64_T, peer, detail::TRACE_SYNC_TAG, comm);
+			}
+		}
+		else if (rank == peer) {
+			int64_t best_rtt = std::numeric_limits<int64_t>::max();
+			for (int round = 0; round < detail::TRACE_SYNC_ROUNDS; ++round) {
+				const char ping = 0;
+				const int64_t sent = trace_now_ns();
+				MPI_Send(&ping, 1, MPI_CHAR, 0, detail::TRACE_SYNC_TAG, comm);
+				int64_t root_now;
+				MPI_Recv(&root_now, 1, MPI_INT64_T, 0, detail::TRACE_SYNC_TAG, comm, MPI_STATUS_IGNORE);
+				const int64_t received = trace_now_ns();
+				if (received - sent < best_rtt) {
+					best_rtt = received - sent;
+					offset = root_now - (sent + received) / 2;
+				}
+			}
+		}
+	}
+
+	set_trace_process(rank, offset);
+	return offset;
+}
+
+inline void M::write_trace(const std::string& filename, MPI_Comm comm, int root)
+{
+	int rank, num_procs;
+	MPI_Comm_rank(comm, &rank);
+	MPI_Comm_size(comm, &num_procs);
+
+	const std::string events = trace_events_json();
+	int length = static_cast<int>(events.size());
+	std::vector<int> lengths(rank == root ? num_procs : 0), displs(lengths.size());
+	MPI_Gather(&length, 1, MPI_INT, lengths.data(), 1, MPI_INT, root, comm);
+
+	std::string all;
+	if (rank == root) {
+		int total = 0;
+		for (int r = 0; r < num_procs; ++r) {
+			displs[r] = total;
+			total += lengths[r];
+		}
+		all.resize(total);
+	}
+	MPI_Gatherv(events.data(), length, MPI_CHAR, &all[0], lengths.data(), displs.data(), MPI_CHAR, root, comm);
+	if (rank != root) {
+		return;
+	}
+
+	std::FILE* file = std::fopen(filename.c_str(), "wb");
+	if (!file) {
+		throw std::runtime_error("[write_trace]Couldn't open the file for writing.");
+	}
+	std::fputs("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n", file);
+	for (int r = 0; r < num_procs; ++r) {
+		if (r != 0) {
+			std::fputs(",\n", file);
+		}
+		std::fwrite(all.data() + displs[r], 1, lengths[r], file);
+	}
+	std::fputs("\n]}\n", file);
+	if (std::fclose(file) != 0) {
+		throw std::runtime_error("[write_trace]Failed to write the file.");
+	}
+}
+
+#endif // TRACE_MPI_H
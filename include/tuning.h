@@ -0,0 +1,333 @@
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+#include "gemm.h"
+#include "matrix_view.h"
+#include "omp_gemm.h"
+#include "simd_kernels.h"
+
+namespace M
+{
+	// Подобранные параметры умножения для одного ключа. Нулевой strassen_cutoff — «не подбирался».
+	struct TunedParams
+	{
+		OmpGemmConfig omp;
+		int threads = 1;
+		size_t strassen_cutoff = 0;
+		double gflops = 0;
+	};
+
+	// Параметры зависят от процессора, набора инструкций, числа ядер, типа и порядка размера задачи.
+	struct TuningKey
+	{
+		std::string cpu;
+		std::string isa;
+		int cores = 0;
+		std::string type;
+		size_t size_class = 0;
+
+		bool operator<(const TuningKey& other) const
+		{
+			return std::tie(cpu, isa, cores, type, size_class)
+				< std::tie(other.cpu, other.isa, other.cores, other.type, other.size_class);
+		}
+	};
+
+	// Наименьшая степень двойки не меньше среднего геометрического m, n, k (но не меньше 32).
+	size_t size_class(size_t m, size_t n, size_t k) noexcept;
+
+	// Модель процессора из /proc/cpuinfo; "unknown", если её не узнать.
+	const std::string& cpu_model();
+
+	template <typename T>
+	const char* type_name() noexcept;
+
+	template <typename T>
+	TuningKey tuning_key(size_t m, size_t n, size_t k);
+
+	// Кэш подобранных параметров: текстовый файл, строка на ключ, поля через табуляцию.
+	// Путь — переменная MATRIX_TUNING_CACHE (off — кэш отключён), иначе ~/.cache/matrix_tuning.tsv.
+	class TuningCache
+	{
+	public:
+		explicit TuningCache(std::string path);
+
+		// Общий кэш, читается с диска при первом обращении.
+		static TuningCache& instance();
+		static std::string default_path();
+
+		const std::string& path() const noexcept;
+
+		// Точное совпадение ключа, иначе ближайший по size_class для того же процессора и типа.
+		std::optional<TunedParams> find(const TuningKey& key) const;
+		void store(const TuningKey& key, const TunedParams& params);
+		void save() const;
+
+	private:
+		void load();
+
+		std::string _path;
+		std::map<TuningKey, TunedParams> _entries;
+		mutable std::mutex _mutex;
+	};
+
+	template <typename T>
+	std::optional<TunedParams> tuned_params(size_t m, size_t n, size_t k);
+
+	// Явно заданная конфигурация берётся как есть, без неё — подобранная для задачи, иначе OmpGemmConfig{}.
+	// Плитки и chunk подбирались под своё число потоков: на другом threads они отбрасываются.
+	template <typename T>
+	OmpGemmConfig tuned_config(size_t m, size_t n, size_t k, int threads, const std::optional<OmpGemmConfig>& config);
+
+	// C += A * B на подобранных для этого размера потоках и плитках; без записи в кэше — однопоточный gemm.
+	template <typename T>
+	void tuned_gemm(ConstMatrixView<detail::no_deduce_t<T>> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+		MatrixView<T> c);
+
+	template <typename T>
+	size_t tuned_strassen_cutoff(size_t m, size_t n, size_t k, size_t fallback);
+}
+
+inline size_t M::size_class(size_t m, size_t n, size_t k) noexcept
+{
+	const double mean = std::cbrt(static_cast<double>(m) * static_cast<double>(n) * static_cast<double>(k));
+	size_t cls = 32;
+	while (static_cast<double>(cls) < mean) {
+		cls *= 2;
+	}
+	return cls;
+}
+
+inline const std::string& M::cpu_model()
+{
+	static const std::string model = [] {
+		std::ifstream cpuinfo("/proc/cpuinfo");
+		std::string line;
+		while (std::getline(cpuinfo, line)) {
+			if (line.rfind("model name", 0) == 0) {
+				const size_t colon = line.find(':');
+				if (colon != std::string::npos && colon + 2 <= line.size()) {
+					return line.substr(colon + 2);
+				}
+			}
+		}
+		return std::string("unknown");
+	}();
+	return model;
+}
+
+template <typename T>
+const char* M::type_name() noexcept
+{
+	if constexpr (std::is_same_v<T, int>) return "int";
+	else if constexpr (std::is_same_v<T, float>) return "float";
+	else if constexpr (std::is_same_v<T, double>) return "double";
+	else return "other";
+}
+
+template <typename T>
+M::TuningKey M::tuning_key(size_t m, size_t n, size_t k)
+{
+	return {cpu_model(), isa_name(micro_kernel_for<T>().isa), static_cast<int>(std::thread::hardware_concurrency()),
+		type_name<T>(), size_class(m, n, k)};
+}
+
+inline M::TuningCache::TuningCache(std::string path) :
+	_path{std::move(path)}
+{
+	load();
+}
+
+inline M::TuningCache& M::TuningCache::instance()
+{
+	static TuningCache cache(default_path());
+	return cache;
+}
+
+inline std::string M::TuningCache::default_path()
+{
+	if (const char* path = std::getenv("MATRIX_TUNING_CACHE")) {
+		return std::string(path) == "off" ? std::string{} : std::string(path);
+	}
+#ifdef _WIN32
+	if (const char* local = std::getenv("LOCALAPPDATA")) {
+		return std::string(local) + "\\matrix_tuning.tsv";
+	}
+#else
+	if (const char* home = std::getenv("HOME")) {
+		return std::string(home) + "/.cache/matrix_tuning.tsv";
+	}
+#endif
+	return "matrix_tuning.tsv";
+}
+
+inline const std::string& M::TuningCache::path() const noexcept
+{
+	return _path;
+}
+
+inline void M::TuningCache::load()
+{
+	if (_path.empty()) {
+		return;
+	}
+	std::ifstream file(_path);
+	std::string line;
+	while (std::getline(file, line)) {
+		if (line.empty() || line[0] == '#') {
+			continue;
+		}
+		std::istringstream fields(line);
+		TuningKey key;
+		TunedParams params;
+		std::string cells[13];
+		size_t count = 0;
+		while (count < 13 && std::getline(fields, cells[count], '\t')) {
+			++count;
+		}
+		// Битая или чужая строка пропускается: кэш всегда можно пересобрать.
+		if (count != 13) {
+			continue;
+		}
+		try {
+			key = {cells[0], cells[1], std::stoi(cells[2]), cells[3], std::stoul(cells[4])};
+			params.omp.decomposition = parse_decomposition(cells[5]);
+			params.omp.schedule = parse_schedule(cells[6]);
+			params.omp.chunk = std::stoi(cells[7]);
+			params.omp.tile_m = std::stoul(cells[8]);
+			params.omp.tile_n = std::stoul(cells[9]);
+			params.threads = std::stoi(cells[10]);
+			params.strassen_cutoff = std::stoul(cells[11]);
+			params.gflops = std::stod(cells[12]);
+		}
+		catch (const std::exception&) {
+			continue;
+		}
+		_entries[key] = params;
+	}
+}
+
+inline std::optional<M::TunedParams> M::TuningCache::find(const TuningKey& key) const
+{
+	std::lock_guard<std::mutex> lock{_mutex};
+	const auto exact = _entries.find(key);
+	if (exact != _entries.end()) {
+		return exact->second;
+	}
+
+	std::optional<TunedParams> nearest;
+	double best_distance = 0;
+	for (const auto& [other, params] : _entries) {
+		if (other.cpu != key.cpu || other.isa != key.isa || other.cores != key.cores || other.type != key.type) {
+			continue;
+		}
+		const double distance = std::abs(std::log2(static_cast<double>(other.size_class) / key.size_class));
+		if (!nearest || distance < best_distance) {
+			nearest = params;
+			best_distance = distance;
+		}
+	}
+	return nearest;
+}
+
+inline void M::TuningCache::store(const TuningKey& key, const TunedParams& params)
+{
+	std::lock_guard<std::mutex> lock{_mutex};
+	_entries[key] = params;
+}
+
+inline void M::TuningCache::save() const
+{
+	if (_path.empty()) {
+		throw std::runtime_error("[TuningCache::save]Tuning cache is disabled.");
+	}
+	const std::filesystem::path parent = std::filesystem::path(_path).parent_path();
+	if (!parent.empty()) {
+		std::filesystem::create_directories(parent);
+	}
+
+	std::ofstream file(_path);
+	if (!file.is_open()) {
+		throw std::runtime_error("[TuningCache::save]Couldn't open the file for writing.");
+	}
+	file << "# cpu\tisa\tcores\ttype\tsize_class\tdecomposition\tschedule\tchunk\ttile_m\ttile_n\tthreads"
+		"\tstrassen_cutoff\tgflops\n";
+	std::lock_guard<std::mutex> lock{_mutex};
+	for (const auto& [key, params] : _entries) {
+		file << key.cpu << '\t' << key.isa << '\t' << key.cores << '\t' << key.type << '\t' << key.size_class << '\t'
+			<< to_string(params.omp.decomposition) << '\t' << to_string(params.omp.schedule) << '\t'
+			<< params.omp.chunk << '\t' << params.omp.tile_m << '\t' << params.omp.tile_n << '\t'
+			<< params.threads << '\t' << params.strassen_cutoff << '\t' << params.gflops << '\n';
+	}
+	if (!file) {
+		throw std::runtime_error("[TuningCache::save]Failed to write the file.");
+	}
+}
+
+template <typename T>
+std::optional<M::TunedParams> M::tuned_params(size_t m, size_t n, size_t k)
+{
+	// Подбор делается только для типов, на которых работает matrix_bench.
+	if constexpr (std::is_same_v<T, int> || std::is_same_v<T, float> || std::is_same_v<T, double>) {
+		return TuningCache::instance().find(tuning_key<T>(m, n, k));
+	}
+	else {
+		return std::nullopt;
+	}
+}
+
+template <typename T>
+M::OmpGemmConfig M::tuned_config(size_t m, size_t n, size_t k, int threads, const std::optional<OmpGemmConfig>& config)
+{
+	if (config) {
+		return *config;
+	}
+	const std::optional<TunedParams> tuned = tuned_params<T>(m, n, k);
+	if (!tuned) {
+		return {};
+	}
+	OmpGemmConfig result = tuned->omp;
+	if (tuned->threads != std::max(threads, 1)) {
+		result.chunk = 0;
+		result.tile_m = result.tile_n = 0;
+	}
+	return result;
+}
+
+template <typename T>
+void M::tuned_gemm(ConstMatrixView<detail::no_deduce_t<T>> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+	MatrixView<T> c)
+{
+	const std::optional<TunedParams> tuned = tuned_params<T>(c.get_rows(), c.get_cols(), a.get_cols());
+	if (tuned && tuned->threads > 1) {
+		omp_gemm(a, b, c, tuned->threads, tuned->omp);
+	}
+	else {
+		gemm(a, b, c);
+	}
+}
+
+template <typename T>
+size_t M::tuned_strassen_cutoff(size_t m, size_t n, size_t k, size_t fallback)
+{
+	const std::optional<TunedParams> tuned = tuned_params<T>(m, n, k);
+	return tuned && tuned->strassen_cutoff ? tuned->strassen_cutoff : fallback;
+}
+
+#endif // TUNING_H
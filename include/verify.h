@@ -0,0 +1,198 @@
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "matrix.h"
+#include "matrix_view.h"
+#include "random_generator.h"
+#include "trace.h"
+
+namespace M
+{
+	struct VerifyOptions
+	{
+		int rounds = 4;          // число случайных векторов
+		uint64_t seed = 0x5eed;  // векторы зависят только от seed и номера строки, на всех рангах одни и те же
+		double tolerance = 0;    // для вещественных, в долях |A| * (|B| * |r|); 0 — 4 * sqrt(k) * eps(T)
+		int threads = 1;
+	};
+
+	struct VerifyResult
+	{
+		bool passed = true;
+		size_t bad_row = 0;    // первая строка C, на которой проверка не сошлась
+		double error = 0;      // вещественные: наибольшее отклонение в долях допуска (больше 1 — ошибка); целые: 0 или 1
+		double seconds = 0;
+	};
+
+	// Проверка Фрейвалдса: C == A * B без умножения матриц. Для R из rounds случайных столбцов
+	// сравниваются A * (B * R) и C * R — O(n^2 * rounds) операций вместо O(n^3).
+	// Целые считаются по модулю 2^64 со случайными 64-битными R: неверный C проходит
+	// с вероятностью не выше 2^-rounds. Вещественные сравниваются с допуском на округление.
+	template <typename T>
+	VerifyResult freivalds_verify(ConstMatrixView<T> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+		ConstMatrixView<detail::no_deduce_t<T>> c, const VerifyOptions& options = {});
+
+	template <typename T, typename Alloc>
+	VerifyResult freivalds_verify(const Matrix<T, Alloc>& a, const Matrix<T, Alloc>& b, const Matrix<T, Alloc>& c,
+		const VerifyOptions& options = {});
+
+	namespace detail
+	{
+		// Целые — по модулю 2^64 (переполнение не влияет на равенство), вещественные — в double.
+		template <typename T>
+		using verify_t = std::conditional_t<std::is_integral_v<T>, uint64_t, double>;
+
+		template <typename T>
+		verify_t<T> widen(T value) noexcept
+		{
+			if constexpr (std::is_integral_v<T>) {
+				return static_cast<uint64_t>(static_cast<int64_t>(value));
+			}
+			else {
+				return static_cast<double>(value);
+			}
+		}
+
+		// Строка index матрицы R (rounds значений). Зависит только от seed и index, поэтому
+		// любой ранг строит ровно те строки R, которые ему нужны.
+		template <typename V>
+		void random_row(uint64_t seed, size_t index, int rounds, V* out)
+		{
+			for (int q = 0; q < rounds; ++q) {
+				if constexpr (std::is_integral_v<V>) {
+					out[q] = RandomGenerator::value_at<V>(seed, index, q, 0, std::numeric_limits<V>::max());
+				}
+				else {
+					out[q] = RandomGenerator::value_at<V>(seed, index, q, -1.0, 1.0);
+				}
+			}
+		}
+
+		// out(rows x rounds) = X * R; с Abs — |X| * R (R тогда уже неотрицательна).
+		template <bool Abs, typename T>
+		void multiply_columns(ConstMatrixView<T> x, const verify_t<T>* r, int rounds, verify_t<T>* out,
+			[[maybe_unused]] int threads)
+		{
+			const long rows = static_cast<long>(x.get_rows());
+			const size_t k = static_cast<size_t>(rounds);
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+#endif
+			for (long i = 0; i < rows; ++i) {
+				const T* row = x.row(static_cast<size_t>(i));
+				verify_t<T>* acc = out + static_cast<size_t>(i) * k;
+				std::fill(acc, acc + k, verify_t<T>{});
+				for (size_t j = 0; j < x.get_cols(); ++j) {
+					verify_t<T> value = widen(row[j]);
+					if constexpr (Abs) {
+						value = std::abs(value);
+					}
+					const verify_t<T>* r_row = r + j * k;
+					for (size_t q = 0; q < k; ++q) {
+						acc[q] += value * r_row[q];
+					}
+				}
+			}
+		}
+
+		// Сравнение z = A * (B * R) и w = C * R построчно; bound = |A| * (|B| * |R|) нужен только вещественным.
+		template <typename V>
+		VerifyResult compare_rows(const V* z, const V* w, const V* bound, size_t rows, int rounds, double tolerance)
+		{
+			VerifyResult result;
+			const size_t k = static_cast<size_t>(rounds);
+			for (size_t i = 0; i < rows * k; ++i) {
+				double error = 0;
+				bool bad = false;
+				if constexpr (std::is_integral_v<V>) {
+					bad = z[i] != w[i];
+					error = bad ? 1.0 : 0.0;
+				}
+				else {
+					// NaN в C даёт NaN и тоже считается ошибкой.
+					const double allowed = tolerance * bound[i];
+					const double diff = std::abs(z[i] - w[i]);
+					error = diff == 0 ? 0.0
+						: std::isnan(diff) || allowed == 0 ? std::numeric_limits<double>::infinity()
+						: diff / allowed;
+					bad = error > 1.0;
+				}
+				if (bad && result.passed) {
+					result.passed = false;
+					result.bad_row = i / k;
+				}
+				result.error = std::max(result.error, error);
+			}
+			return result;
+		}
+
+		// Строгая граница округления растёт как k * eps, но ошибки слагаемых взаимно гасятся и на деле
+		// растут как sqrt(k) * eps — такой допуск ловит в разы меньшие искажения C.
+		template <typename T>
+		double default_tolerance(size_t inner, double tolerance) noexcept
+		{
+			return tolerance > 0 ? tolerance
+				: 4.0 * std::sqrt(static_cast<double>(std::max<size_t>(inner, 1))) * std::numeric_limits<T>::epsilon();
+		}
+	}
+}
+
+template <typename T>
+M::VerifyResult M::freivalds_verify(ConstMatrixView<T> a, ConstMatrixView<detail::no_deduce_t<T>> b,
+	ConstMatrixView<detail::no_deduce_t<T>> c, const VerifyOptions& options)
+{
+	using V = detail::verify_t<T>;
+	M_TRACE_SCOPE("freivalds_verify");
+	const auto start = std::chrono::steady_clock::now();
+
+	if (a.get_cols() != b.get_rows() || a.get_rows() != c.get_rows() || b.get_cols() != c.get_cols()) {
+		throw std::invalid_argument{"[freivalds_verify]Matrix dimensions do not match."};
+	}
+	if (options.rounds < 1) {
+		throw std::invalid_argument{"[freivalds_verify]At least one round is required."};
+	}
+	const size_t m = a.get_rows(), inner = a.get_cols(), n = b.get_cols();
+	const size_t k = static_cast<size_t>(options.rounds);
+
+	std::vector<V> r(n * k), y(inner * k), z(m * k), w(m * k);
+	for (size_t j = 0; j < n; ++j) {
+		detail::random_row(options.seed, j, options.rounds, r.data() + j * k);
+	}
+	detail::multiply_columns<false>(b, r.data(), options.rounds, y.data(), options.threads);
+	detail::multiply_columns<false>(a, y.data(), options.rounds, z.data(), options.threads);
+	detail::multiply_columns<false>(c, r.data(), options.rounds, w.data(), options.threads);
+
+	std::vector<V> bound;
+	if constexpr (!std::is_integral_v<T>) {
+		for (V& value : r) {
+			value = std::abs(value);
+		}
+		bound.resize(m * k);
+		detail::multiply_columns<true>(b, r.data(), options.rounds, y.data(), options.threads);
+		detail::multiply_columns<true>(a, y.data(), options.rounds, bound.data(), options.threads);
+	}
+
+	VerifyResult result = detail::compare_rows(z.data(), w.data(), bound.data(), m, options.rounds,
+		detail::default_tolerance<T>(inner, options.tolerance));
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+template <typename T, typename Alloc>
+M::VerifyResult M::freivalds_verify(const Matrix<T, Alloc>& a, const Matrix<T, Alloc>& b, const Matrix<T, Alloc>& c,
+	const VerifyOptions& options)
+{
+	return freivalds_verify<T>(a.view(), b.view(), c.view(), options);
+}
+
+#endif // VERIFY_H
@@ -0,0 +1,103 @@
+#ifndef VERIFY_MPI_H
+#define VERIFY_MPI_H
+
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include <mpi.h>
+
+#include "dist_matrix.h"
+#include "mpi_types.h"
+#include "verify.h"
+
+namespace M
+{
+	// Проверка Фрейвалдса для распределённых матриц без сборки на одном процессе:
+	// каждый ранг умножает свои блоки на нужные строки векторов, частичные суммы
+	// складываются через MPI_Allreduce (три обмена по n * rounds значений).
+	// Вызывается всеми процессами решётки, результат одинаков на всех.
+	template <typename T>
+	VerifyResult freivalds_verify(const DistMatrix<T>& a, const DistMatrix<T>& b, const DistMatrix<T>& c,
+		const VerifyOptions& options = {});
+
+	namespace detail
+	{
+		// out (x.get_rows() x rounds, глобальная нумерация строк) = X * R, R задана для всех глобальных столбцов.
+		template <bool Abs, typename T>
+		void dist_multiply_columns(const DistMatrix<T>& x, const verify_t<T>* r, int rounds, std::vector<verify_t<T>>& out,
+			[[maybe_unused]] int threads)
+		{
+			using V = verify_t<T>;
+			const ConstMatrixView<T> local = x.local();
+			const size_t k = static_cast<size_t>(rounds);
+			out.assign(x.get_rows() * k, V{});
+			const long rows = static_cast<long>(local.get_rows());
+#ifdef _OPENMP
+#pragma omp parallel for num_threads(threads) schedule(static) if(threads > 1)
+#endif
+			for (long i = 0; i < rows; ++i) {
+				const T* row = local.row(static_cast<size_t>(i));
+				V* acc = out.data() + x.global_row(static_cast<size_t>(i)) * k;
+				for (size_t j = 0; j < local.get_cols(); ++j) {
+					V value = widen(row[j]);
+					if constexpr (Abs) {
+						value = std::abs(value);
+					}
+					const V* r_row = r + x.global_col(j) * k;
+					for (size_t q = 0; q < k; ++q) {
+						acc[q] += value * r_row[q];
+					}
+				}
+			}
+			MPI_Allreduce(MPI_IN_PLACE, out.data(), static_cast<int>(out.size()), mpi_type<V>(), MPI_SUM,
+				x.grid().comm());
+		}
+	}
+}
+
+template <typename T>
+M::VerifyResult M::freivalds_verify(const DistMatrix<T>& a, const DistMatrix<T>& b, const DistMatrix<T>& c,
+	const VerifyOptions& options)
+{
+	using V = detail::verify_t<T>;
+	M_TRACE_SCOPE("freivalds_verify");
+	const auto start = std::chrono::steady_clock::now();
+
+	if (a.get_cols() != b.get_rows() || a.get_rows() != c.get_rows() || b.get_cols() != c.get_cols()) {
+		throw std::invalid_argument{"[freivalds_verify]Matrix dimensions do not match."};
+	}
+	if (options.rounds < 1) {
+		throw std::invalid_argument{"[freivalds_verify]At least one round is required."};
+	}
+	const size_t inner = a.get_cols(), n = b.get_cols();
+	const size_t k = static_cast<size_t>(options.rounds);
+
+	// R целиком — всего n * rounds значений, каждый ранг строит её сам без обмена.
+	std::vector<V> r(n * k), y, z, w;
+	for (size_t j = 0; j < n; ++j) {
+		detail::random_row(options.seed, j, options.rounds, r.data() + j * k);
+	}
+	detail::dist_multiply_columns<false>(b, r.data(), options.rounds, y, options.threads);
+	detail::dist_multiply_columns<false>(a, y.data(), options.rounds, z, options.threads);
+	detail::dist_multiply_columns<false>(c, r.data(), options.rounds, w, options.threads);
+
+	std::vector<V> bound;
+	if constexpr (!std::is_integral_v<T>) {
+		for (V& value : r) {
+			value = std::abs(value);
+		}
+		detail::dist_multiply_columns<true>(b, r.data(), options.rounds, y, options.threads);
+		detail::dist_multiply_columns<true>(a, y.data(), options.rounds, bound, options.threads);
+	}
+
+	VerifyResult result = detail::compare_rows(z.data(), w.data(), bound.data(), a.get_rows(), options.rounds,
+		detail::default_tolerance<T>(inner, options.tolerance));
+	result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	return result;
+}
+
+#endif // VERIFY_MPI_H
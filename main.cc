@@ -4,11 +4,17 @@
 #include <string>
 
 #include "include/matrix.h"
+#include "include/matrix_io.h"
 #include "include/stat.h"
 #include "include/random_generator.h"
+#include "include/verify.h"
 
 constexpr auto MIN_VALUE = 0;
 constexpr auto MAX_VALUE = 1000;
+constexpr uint64_t SEED = 42;
+
+// Пул переиспользует буферы между прогонами на одном размере.
+using BenchMatrix = M::Matrix<int, M::PoolAllocator<int>>;
 
 static void create_directory(const std::string& dir_name) {
 	try {
@@ -31,7 +37,7 @@ static void chdir(const std::string& dir_name) {
 	}
 }
 
-static void write_matrix(const std::string& filename, M::Matrix<int> matrix) {
+static void write_matrix(const std::string& filename, const BenchMatrix& matrix) {
 	try {
 		matrix.write_to_file(filename);
 		std::cout << "The matrix has been successfully written to the file." << std::endl;
@@ -41,10 +47,27 @@ static void write_matrix(const std::string& filename, M::Matrix<int> matrix) {
 	}
 }
 
+static void write_matrix_binary(const std::string& filename, const BenchMatrix& matrix) {
+	try {
+		M::write_binary(filename, matrix);
+	}
+	catch (const std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+	}
+}
+
 
 
-int main() {
-	
+int main(int argc, char** argv) {
+	// --verify: проверка по Фрейвалдсу вместо записи A, B и result
+	bool verify = false;
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--verify") {
+			verify = true;
+		}
+	}
+
 	std::vector<int> SIZES = { 100, 200, 300, 400, 500, 1000, 2000 };
 	std::vector<double> TIMES(SIZES.size());
 	chdir("C:\\Users\\user\\Desktop\\ALL\\University\\3 cours\\6 semester\\PP\\Labs");
@@ -55,16 +78,31 @@ int main() {
 
 
 	for (size_t i = 0; i < SIZES.size(); i++) {
-		M::Matrix<int> A(SIZES[i], SIZES[i]);
-		M::Matrix<int> B(SIZES[i], SIZES[i]);
-		M::Matrix<int> result(SIZES[i], SIZES[i]);
+		// Блоки прошлого размера здесь уже в пуле, но на этом размере не пригодятся.
+		M::PoolAllocator<int>::trim();
+		BenchMatrix A(SIZES[i], SIZES[i]);
+		BenchMatrix B(SIZES[i], SIZES[i]);
+		BenchMatrix result(SIZES[i], SIZES[i]);
 
-		A.fill_random(MIN_VALUE, MAX_VALUE);
-		B.fill_random(MIN_VALUE, MAX_VALUE);
+		A.fill_random(MIN_VALUE, MAX_VALUE, SEED);
+		B.fill_random(MIN_VALUE, MAX_VALUE, SEED + 1);
 
 		ExecutionTimer timer;
 		result = A * B;
 		timer.stop();
+		TIMES[i] = timer.get_duration();
+
+		// Проверка идёт после замера и в него не входит.
+		if (verify) {
+			const M::VerifyResult check = M::freivalds_verify(A, B, result);
+			if (check.passed) {
+				std::cout << SIZES[i] << "x" << SIZES[i] << " verified in " << check.seconds << " s" << std::endl;
+			}
+			else {
+				std::cout << SIZES[i] << "x" << SIZES[i] << " VERIFICATION FAILED at row " << check.bad_row << std::endl;
+			}
+			continue;
+		}
 
 		std::string dir_name = std::to_string(SIZES[i]);
 		create_directory(dir_name);
@@ -72,11 +110,13 @@ int main() {
 		write_matrix("A.txt", A);
 		write_matrix("B.txt", B);
 		write_matrix("result.txt", result);
-
-		TIMES[i] = timer.get_duration();
+		write_matrix_binary("A.npy", A);
+		write_matrix_binary("B.npy", B);
+		write_matrix_binary("result.npy", result);
 
 		chdir("..");
 	}
+	M::PoolAllocator<int>::trim();
 
 	std::ofstream file("statistic.txt");
 	if (!file.is_open())
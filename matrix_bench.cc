@@ -0,0 +1,975 @@
+#include <omp.h>
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#ifdef MATRIX_BENCH_MPI
+#include <mpi.h>
+#endif
+
+#include "include/autotune.h"
+#include "include/batched_gemm.h"
+#include "include/matrix.h"
+#include "include/matrix_io.h"
+#include "include/out_of_core.h"
+#include "include/pool_gemm.h"
+#include "include/quantized_gemm.h"
+#include "include/roofline.h"
+#include "include/sparse.h"
+#include "include/strassen.h"
+#include "include/stat.h"
+#include "include/trace.h"
+#include "include/tuning.h"
+#include "include/verify.h"
+#ifdef MATRIX_BENCH_MPI
+#include "include/mpi_multiply.h"
+#include "include/trace_mpi.h"
+#endif
+
+// Единый стенд для сравнения ядер: размеры, типы, бэкенды, числа потоков и рангов,
+// прогрев и повторы задаются с командной строки. Каждая точка прогоняется warmup + reps раз,
+// в отчёт идут min, median, p95, stddev и GFLOP/s по медиане.
+// Пример: ./matrix_bench --sizes 500,1000 --types int,double --backends omp,pool --threads 1,4 --reps 10
+// С MPI: mpirun -np 4 ./matrix_bench --backends mpi --ranks 1,2,4
+// --trace file.json пишет трассу Chrome/Perfetto (нужна сборка с -DMATRIX_TRACE=ON).
+// --roofline on калибрует пик умножения-сложения и пропускную способность памяти и добавляет
+// к каждому замеру арифметическую интенсивность и долю от потолка roofline.
+// Бэкенды csr и bsr умножают разреженную A (плотность из --densities, ненулевые кучками
+// --sparse-cluster x --sparse-cluster, блок BSR — --bsr-block) на плотную B; для каждой точки
+// печатается плотность, ниже которой разреженный путь быстрее самого быстрого плотного бэкенда.
+// Бэкенд batched умножает --batch-count пар матриц size x size (size из 4, 8, 16, 32) через
+// batched_multiply; GFLOP/s считается по всем парам.
+// Бэкенд quant (только для int) сужает A и B до int8 или int16 — самого узкого типа, в который
+// помещаются значения [MIN_VALUE, MAX_VALUE], — и умножает через qgemm с накоплением в int32.
+// Бэкенд ooc пишет A и B в файлы .npy в каталоге --ooc-dir и умножает их out_of_core_multiply
+// с бюджетом --ooc-budget МБ на буферы плиток; C тоже пишется в файл. Время включает весь ввод-вывод.
+// --verify on после замеров проверяет C по Фрейвалдсу (--verify-rounds случайных векторов) за O(n^2)
+// вместо сохранения матриц для сверки в NumPy; batched и ooc не проверяются — их C не в памяти.
+// --counters on добавляет аппаратные счётчики (IPC, промахи на 1000 операций); для mpi считается только ранг 0.
+// --tune on перед замерами подбирает параметры omp_gemm и порог Штрассена для каждого типа и размера
+// (--tune-budget секунд на размер) и сохраняет их в кэш автотюнера; omp, pool и strassen без явных
+// --schedule/--decomposition/--strassen-cutoff берут параметры из этого кэша.
+
+constexpr int MIN_VALUE = 0;
+constexpr int MAX_VALUE = 100;
+constexpr uint64_t DEFAULT_SEED = 42;
+
+enum class Backend { Serial, OpenMP, Pool, Strassen, Mpi, Csr, Bsr, Batched, Quant, OutOfCore };
+
+static Backend parse_bench_backend(const std::string& name) {
+    if (name == "serial") return Backend::Serial;
+    if (name == "omp" || name == "openmp") return Backend::OpenMP;
+    if (name == "pool") return Backend::Pool;
+    if (name == "strassen") return Backend::Strassen;
+    if (name == "csr") return Backend::Csr;
+    if (name == "bsr") return Backend::Bsr;
+    if (name == "batched") return Backend::Batched;
+    if (name == "quant") return Backend::Quant;
+    if (name == "ooc") return Backend::OutOfCore;
+    if (name == "mpi") {
+#ifdef MATRIX_BENCH_MPI
+        return Backend::Mpi;
+#else
+        throw std::invalid_argument{"[matrix_bench]Built without MPI, backend 'mpi' is unavailable"};
+#endif
+    }
+    throw std::invalid_argument{"[matrix_bench]Unknown backend: " + name};
+}
+
+static std::string to_string(Backend backend) {
+    switch (backend) {
+    case Backend::Serial: return "serial";
+    case Backend::OpenMP: return "omp";
+    case Backend::Pool: return "pool";
+    case Backend::Strassen: return "strassen";
+    case Backend::Mpi: return "mpi";
+    case Backend::Csr: return "csr";
+    case Backend::Bsr: return "bsr";
+    case Backend::Batched: return "batched";
+    case Backend::Quant: return "quant";
+    case Backend::OutOfCore: return "ooc";
+    }
+    return "unknown";
+}
+
+struct BenchOptions {
+    std::vector<int> sizes = {100, 200, 300, 400, 500, 1000, 2000};
+    std::vector<std::string> types = {"int"};
+    std::vector<Backend> backends = {Backend::OpenMP};
+    std::vector<int> threads;
+    std::vector<int> ranks;
+    int warmup = 1;
+    int repetitions = 5;
+    uint64_t seed = DEFAULT_SEED;
+    size_t strassen_cutoff = 0;  // 0 — из кэша автотюнера
+    std::vector<double> densities = {0.001, 0.01, 0.05, 0.1, 0.2};
+    size_t sparse_cluster = 1;
+    size_t bsr_block = 4;
+    size_t batch_count = 10000;
+    size_t ooc_budget_mb = 64;
+    std::string ooc_dir = std::filesystem::temp_directory_path().string();
+    std::optional<M::OmpGemmConfig> omp_config;  // без --schedule и --decomposition — из кэша автотюнера
+    bool counters = false;
+    bool roofline = false;
+    bool verify = false;
+    int verify_rounds = 4;
+    bool tune = false;
+    double tune_budget = 10;
+    std::string json_path = "bench.json";
+    std::string csv_path = "bench.csv";
+    std::string trace_path;
+};
+
+struct BenchResult {
+    std::string type;
+    Backend backend;
+    int size, ranks, threads;
+    double density;  // 1 для плотных бэкендов
+    double flops;    // операций за прогон
+    std::vector<double> samples;
+    BenchmarkStats stats;
+    double gflops;
+    PerfSample counters;
+    // NaN, если калибровка roofline не запускалась.
+    double intensity = std::numeric_limits<double>::quiet_NaN();
+    double roofline_gflops = std::numeric_limits<double>::quiet_NaN();
+    // Пусто, если проверка не запускалась.
+    std::optional<bool> verified = std::nullopt;
+    double verify_seconds = std::numeric_limits<double>::quiet_NaN();
+};
+
+// Для скольких точек разреженный бэкенд быстрее плотного: bound — "interpolated", если
+// граница лежит между измеренными плотностями, "above"/"below" — если за их пределами.
+struct SparseCrossover {
+    std::string type;
+    Backend backend;
+    int size, threads;
+    Backend baseline;
+    double density;
+    std::string bound;
+};
+
+// Входы одного прогона; для csr и bsr A берётся в разреженном виде.
+template<typename T>
+struct Operands {
+    const M::Matrix<T>& A;
+    const M::Matrix<T>& B;
+    const M::CsrMatrix<T>* csr = nullptr;
+    const M::BsrMatrix<T>* bsr = nullptr;
+    std::function<void(int)> batched = {};  // прогон batched на заданном числе потоков
+    std::function<void(M::MatrixView<T>, int)> quantized = {};  // C += A * B на суженных копиях A и B
+    std::function<void(int)> out_of_core = {};  // умножение файлов A и B в файл C
+};
+
+struct Measurement {
+    std::vector<double> samples;
+    PerfSample counters;  // сумма по всем повторам без прогрева
+};
+
+// Кто участвует в прогоне: только ранг 0 или подгруппа рангов для бэкенда mpi.
+struct RunGroup {
+    bool distributed = false;
+    bool member = true;
+#ifdef MATRIX_BENCH_MPI
+    MPI_Comm comm = MPI_COMM_NULL;
+#endif
+};
+
+// 1, 2, 4, ..., max и сам max, если он не степень двойки.
+static std::vector<int> powers_up_to(int max) {
+    std::vector<int> counts;
+    for (int n = 1; n <= max; n *= 2) {
+        counts.push_back(n);
+    }
+    if (counts.back() != max) {
+        counts.push_back(max);
+    }
+    return counts;
+}
+
+static std::vector<std::string> split_list(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static std::vector<double> parse_density_list(const std::string& list) {
+    std::vector<double> values;
+    for (const std::string& item : split_list(list)) {
+        const double value = std::stod(item);
+        if (!(value > 0.0 && value <= 1.0)) {
+            throw std::invalid_argument{"[matrix_bench]Density must be in (0, 1], got " + item};
+        }
+        values.push_back(value);
+    }
+    std::sort(values.begin(), values.end());
+    return values;
+}
+
+static std::vector<int> parse_int_list(const std::string& list) {
+    std::vector<int> values;
+    for (const std::string& item : split_list(list)) {
+        const int value = std::stoi(item);
+        if (value <= 0) {
+            throw std::invalid_argument{"[matrix_bench]Expected a positive number, got " + item};
+        }
+        values.push_back(value);
+    }
+    return values;
+}
+
+static BenchOptions parse_options(int argc, char** argv, int world_size) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument{"[matrix_bench]Missing value for " + arg};
+        }
+        const std::string value = argv[++i];
+        if (arg == "--sizes") {
+            options.sizes = parse_int_list(value);
+        } else if (arg == "--types") {
+            options.types = split_list(value);
+        } else if (arg == "--backends") {
+            options.backends.clear();
+            for (const std::string& name : split_list(value)) {
+                options.backends.push_back(parse_bench_backend(name));
+            }
+        } else if (arg == "--threads") {
+            options.threads = parse_int_list(value);
+        } else if (arg == "--ranks") {
+            options.ranks = parse_int_list(value);
+        } else if (arg == "--warmup") {
+            options.warmup = std::max(0, std::stoi(value));
+        } else if (arg == "--reps") {
+            options.repetitions = std::max(1, std::stoi(value));
+        } else if (arg == "--seed") {
+            options.seed = std::stoull(value);
+        } else if (arg == "--strassen-cutoff") {
+            options.strassen_cutoff = std::stoul(value);
+        } else if (arg == "--densities") {
+            options.densities = parse_density_list(value);
+        } else if (arg == "--sparse-cluster") {
+            options.sparse_cluster = std::max(1, std::stoi(value));
+        } else if (arg == "--batch-count") {
+            options.batch_count = std::max(1, std::stoi(value));
+        } else if (arg == "--ooc-budget") {
+            options.ooc_budget_mb = std::max(1, std::stoi(value));
+        } else if (arg == "--ooc-dir") {
+            options.ooc_dir = value;
+        } else if (arg == "--bsr-block") {
+            options.bsr_block = std::max(1, std::stoi(value));
+        } else if (arg == "--schedule") {
+            options.omp_config = options.omp_config.value_or(M::OmpGemmConfig{});
+            options.omp_config->schedule = M::parse_schedule(value);
+        } else if (arg == "--decomposition") {
+            options.omp_config = options.omp_config.value_or(M::OmpGemmConfig{});
+            options.omp_config->decomposition = M::parse_decomposition(value);
+        } else if (arg == "--roofline") {
+            options.roofline = value == "on" || value == "1";
+        } else if (arg == "--verify") {
+            options.verify = value == "on" || value == "1";
+        } else if (arg == "--verify-rounds") {
+            options.verify_rounds = std::max(1, std::stoi(value));
+        } else if (arg == "--counters") {
+            options.counters = value == "on" || value == "1";
+        } else if (arg == "--tune") {
+            options.tune = value == "on" || value == "1";
+        } else if (arg == "--tune-budget") {
+            options.tune_budget = std::stod(value);
+        } else if (arg == "--json") {
+            options.json_path = value;
+        } else if (arg == "--csv") {
+            options.csv_path = value;
+        } else if (arg == "--trace") {
+            options.trace_path = value;
+        } else {
+            throw std::invalid_argument{"[matrix_bench]Unknown option: " + arg};
+        }
+    }
+
+    for (const std::string& type : options.types) {
+        if (type != "int" && type != "float" && type != "double") {
+            throw std::invalid_argument{"[matrix_bench]Unknown element type: " + type};
+        }
+    }
+    if (options.threads.empty()) {
+        options.threads = powers_up_to(omp_get_max_threads());
+    }
+    if (options.ranks.empty()) {
+        options.ranks = powers_up_to(world_size);
+    }
+    // Лишние ранги отбрасываются: запуск на 2 процессах не может измерить 4.
+    options.ranks.erase(std::remove_if(options.ranks.begin(), options.ranks.end(),
+                                       [world_size](int ranks) { return ranks > world_size; }),
+                        options.ranks.end());
+    return options;
+}
+
+// Один прогон C = A * B. Для omp, pool, serial, csr и bsr C заранее обнулена (они накапливают C += A * B).
+template<typename T>
+static void run_backend(Backend backend, const Operands<T>& in, M::Matrix<T>& C,
+                        int threads, const BenchOptions& options, [[maybe_unused]] const RunGroup& group) {
+    const M::Matrix<T>& A = in.A;
+    const M::Matrix<T>& B = in.B;
+    switch (backend) {
+    case Backend::Serial:
+        M::gemm(A.view(), B.view(), C.view());
+        break;
+    case Backend::OpenMP:
+        M::parallel_gemm(M::GemmBackend::OpenMP, A.view(), B.view(), C.view(), threads, options.omp_config);
+        break;
+    case Backend::Pool:
+        M::parallel_gemm(M::GemmBackend::Pool, A.view(), B.view(), C.view(), threads, options.omp_config);
+        break;
+    case Backend::Strassen:
+#pragma omp parallel num_threads(threads) if(threads > 1)
+#pragma omp single
+        M::strassen_gemm(A.view(), B.view(), C.view(), options.strassen_cutoff);
+        break;
+    case Backend::Mpi:
+#ifdef MATRIX_BENCH_MPI
+        M::scatter_multiply<T>(A.view(), B.view(), C.view(), group.comm, threads);
+#endif
+        break;
+    case Backend::Csr:
+        M::spmm(*in.csr, B.view(), C.view(), threads);
+        break;
+    case Backend::Bsr:
+        M::spmm(*in.bsr, B.view(), C.view(), threads);
+        break;
+    case Backend::Batched:
+        in.batched(threads);
+        break;
+    case Backend::Quant:
+        in.quantized(C.view(), threads);
+        break;
+    case Backend::OutOfCore:
+        in.out_of_core(threads);
+        break;
+    }
+}
+
+// Для распределённого прогона measure вызывают все ранги, иначе только ранг 0.
+template<typename T>
+static Measurement measure(Backend backend, const Operands<T>& in, M::Matrix<T>& C,
+                           int threads, const BenchOptions& options, const RunGroup& group) {
+    Measurement measurement;
+    PerfCounters counters;
+    for (int rep = 0; rep < options.warmup + options.repetitions; ++rep) {
+        std::fill(C.get_data(), C.get_data() + C.get_rows() * C.get_cols(), T{});
+#ifdef MATRIX_BENCH_MPI
+        if (group.distributed) {
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+#endif
+        ExecutionTimer timer(false, options.counters ? &counters : nullptr);
+        if (group.member) {
+            M_TRACE_SCOPE("bench run");
+            run_backend(backend, in, C, threads, options, group);
+        }
+#ifdef MATRIX_BENCH_MPI
+        if (group.distributed) {
+            MPI_Barrier(MPI_COMM_WORLD);
+        }
+#endif
+        timer.stop();
+        if (rep >= options.warmup) {
+            measurement.samples.push_back(timer.get_duration());
+            measurement.counters += timer.get_counters();
+        }
+    }
+    if (options.counters && !counters.unavailable_reason().empty()) {
+        static bool warned = false;
+        if (!warned) {
+            std::cerr << "Warning: hardware counters disabled, " << counters.unavailable_reason() << std::endl;
+            warned = true;
+        }
+    }
+    return measurement;
+}
+
+// Калибровка roofline для типа на ранге 0; nullptr, если она не нужна.
+template<typename T>
+static const M::RooflineProfile* calibrate(const std::string& type, const BenchOptions& options, int rank,
+                                           std::vector<std::pair<std::string, M::RooflineProfile>>& profiles) {
+    if (!options.roofline || rank != 0) {
+        return nullptr;
+    }
+    const int threads = *std::max_element(options.threads.begin(), options.threads.end());
+    const M::RooflineProfile profile = M::calibrate_roofline<T>(threads);
+    std::cout << "Roofline " << type << " (" << M::isa_name(profile.isa) << "): peak " << profile.peak_core_gflops
+              << " GFLOP/s per core, " << profile.peak_total_gflops << " GFLOP/s on " << profile.threads
+              << " threads, memory " << profile.bandwidth_gbs << " GB/s" << std::endl;
+    profiles.emplace_back(type, profile);
+    return &profiles.back().second;
+}
+
+// Подбор параметров на ранге 0 для каждого размера; результат попадает в кэш, но ещё не на диск.
+template<typename T>
+static void tune(const std::string& type, const BenchOptions& options, int rank) {
+    if (!options.tune || rank != 0) {
+        return;
+    }
+    M::TuneOptions tune_options;
+    tune_options.max_threads = *std::max_element(options.threads.begin(), options.threads.end());
+    tune_options.budget_seconds = options.tune_budget;
+    for (int size : options.sizes) {
+        const M::TunedParams params = M::autotune<T>(size, tune_options);
+        M::TuningCache::instance().store(M::tuning_key<T>(size, size, size), params);
+        std::cout << "Tuned " << type << " " << size << "x" << size << ": " << params.threads << " threads, "
+                  << M::to_string(params.omp.decomposition) << ", schedule " << M::to_string(params.omp.schedule)
+                  << ", chunk " << params.omp.chunk << ", tile " << params.omp.tile_m << "x" << params.omp.tile_n
+                  << ", strassen cutoff " << params.strassen_cutoff << ", " << params.gflops << " GFLOP/s" << std::endl;
+    }
+}
+
+static bool is_sparse(Backend backend) {
+    return backend == Backend::Csr || backend == Backend::Bsr;
+}
+
+// A в разреженном виде для одной плотности; BSR строится, только если он запрошен.
+template<typename T>
+struct SparseInput {
+    double density;
+    M::CsrMatrix<T> csr;
+    M::BsrMatrix<T> bsr;
+};
+
+// Плотность, ниже которой разреженный бэкенд быстрее самого быстрого плотного при том же числе потоков.
+// Время разреженного умножения почти пропорционально плотности, поэтому между замерами
+// граница ищется линейной интерполяцией в логарифмах.
+static void report_crossover(const std::string& type, int size, const std::vector<BenchResult>& results,
+                             std::vector<SparseCrossover>& crossovers) {
+    std::vector<std::pair<Backend, int>> points;
+    for (const BenchResult& r : results) {
+        if (r.type == type && r.size == size && is_sparse(r.backend)
+            && std::find(points.begin(), points.end(), std::make_pair(r.backend, r.threads)) == points.end()) {
+            points.emplace_back(r.backend, r.threads);
+        }
+    }
+    for (const auto& [backend, threads] : points) {
+        const BenchResult* dense = nullptr;
+        std::vector<const BenchResult*> sparse;
+        for (const BenchResult& r : results) {
+            if (r.type != type || r.size != size || r.backend == Backend::Mpi) {
+                continue;
+            }
+            if (r.backend == backend && r.threads == threads) {
+                sparse.push_back(&r);
+            } else if (!is_sparse(r.backend) && r.backend != Backend::Batched && (r.threads == threads || r.backend == Backend::Serial)
+                       && (!dense || r.stats.median < dense->stats.median)) {
+                dense = &r;
+            }
+        }
+        if (!dense) {
+            std::cout << "  " << to_string(backend) << " threads " << threads
+                      << ": no dense backend to compare with (add omp or serial to --backends)" << std::endl;
+            continue;
+        }
+
+        const double limit = dense->stats.median;
+        SparseCrossover crossover{type, backend, size, threads, dense->backend, sparse.front()->density, "below"};
+        for (size_t i = 0; i < sparse.size() && sparse[i]->stats.median < limit; ++i) {
+            if (i + 1 == sparse.size()) {
+                crossover.density = sparse[i]->density;
+                crossover.bound = "above";
+            } else if (sparse[i + 1]->stats.median >= limit) {
+                const double t0 = std::log(sparse[i]->stats.median), t1 = std::log(sparse[i + 1]->stats.median);
+                const double d0 = std::log(sparse[i]->density), d1 = std::log(sparse[i + 1]->density);
+                const double f = t1 > t0 ? (std::log(limit) - t0) / (t1 - t0) : 1.0;
+                crossover.density = std::exp(d0 + f * (d1 - d0));
+                crossover.bound = "interpolated";
+            }
+        }
+
+        std::cout << "  " << to_string(backend) << " threads " << threads << " beats dense "
+                  << to_string(dense->backend) << " (" << limit << " s) ";
+        if (crossover.bound == "interpolated") {
+            std::cout << "below density " << crossover.density;
+        } else if (crossover.bound == "above") {
+            std::cout << "at every tested density up to " << crossover.density;
+        } else {
+            std::cout << "at no tested density (lowest " << crossover.density << ")";
+        }
+        std::cout << std::endl;
+        crossovers.push_back(std::move(crossover));
+    }
+}
+
+// Пакет из count пар S x S со случайными элементами; размер известен только во время выполнения,
+// поэтому поддерживаемые S перечислены явно.
+template<typename T, size_t S>
+static std::function<void(int)> make_batched_run(size_t count, uint64_t seed) {
+    using Batch = M::FixedBatch<T, S, S>;
+    auto a = std::make_shared<Batch>(count), b = std::make_shared<Batch>(count), c = std::make_shared<Batch>(count);
+    const size_t elements = a->get_blocks() * Batch::BLOCK;
+    RandomGenerator::fill_block(a->block_data(0), elements, 0, 0, 1, elements, static_cast<T>(MIN_VALUE),
+                                static_cast<T>(MAX_VALUE), seed, omp_get_max_threads());
+    RandomGenerator::fill_block(b->block_data(0), elements, 0, 0, 1, elements, static_cast<T>(MIN_VALUE),
+                                static_cast<T>(MAX_VALUE), seed + 1, omp_get_max_threads());
+    return [a, b, c](int threads) { M::batched_multiply(*a, *b, *c, threads); };
+}
+
+template<typename T>
+static std::function<void(int)> make_batched_run(int size, size_t count, uint64_t seed) {
+    switch (size) {
+    case 4: return make_batched_run<T, 4>(count, seed);
+    case 8: return make_batched_run<T, 8>(count, seed);
+    case 16: return make_batched_run<T, 16>(count, seed);
+    case 32: return make_batched_run<T, 32>(count, seed);
+    default: return {};
+    }
+}
+
+// Копии A и B в типе Q живут в замыкании, пока идут прогоны этого размера.
+template<typename Q>
+static std::function<void(M::MatrixView<int>, int)> make_narrowed_run(const M::Matrix<int>& A, const M::Matrix<int>& B) {
+    auto a = std::make_shared<M::Matrix<Q>>(A.get_rows(), A.get_cols());
+    auto b = std::make_shared<M::Matrix<Q>>(B.get_rows(), B.get_cols());
+    M::narrow_copy<Q, int>(A.view(), a->view(), omp_get_max_threads());
+    M::narrow_copy<Q, int>(B.view(), b->view(), omp_get_max_threads());
+    return [a, b](M::MatrixView<int> c, int threads) { M::qgemm<Q>(a->view(), b->view(), c, threads); };
+}
+
+template<typename T>
+static std::function<void(M::MatrixView<T>, int)> make_quantized_run(const M::Matrix<T>& A, const M::Matrix<T>& B) {
+    if constexpr (std::is_same_v<T, int32_t>) {
+        if (MIN_VALUE >= std::numeric_limits<int8_t>::min() && MAX_VALUE <= std::numeric_limits<int8_t>::max()) {
+            return make_narrowed_run<int8_t>(A, B);
+        }
+        if (MIN_VALUE >= std::numeric_limits<int16_t>::min() && MAX_VALUE <= std::numeric_limits<int16_t>::max()) {
+            return make_narrowed_run<int16_t>(A, B);
+        }
+    }
+    return {};
+}
+
+// Файлы A, B и C живут, пока жив последний экземпляр замыкания, и удаляются вместе с ним.
+template<typename T>
+static std::function<void(int)> make_out_of_core_run(const M::Matrix<T>& A, const M::Matrix<T>& B,
+                                                     const std::string& type, const BenchOptions& options) {
+    struct Files {
+        std::string a, b, c;
+        ~Files() {
+            std::error_code ignored;
+            for (const std::string* path : {&a, &b, &c}) {
+                std::filesystem::remove(*path, ignored);
+            }
+        }
+    };
+    const std::filesystem::path dir(options.ooc_dir);
+    const std::string prefix = "matrix_bench_ooc_" + type + "_" + std::to_string(A.get_rows()) + "_";
+    auto files = std::make_shared<Files>();
+    files->a = (dir / (prefix + "a.npy")).string();
+    files->b = (dir / (prefix + "b.npy")).string();
+    files->c = (dir / (prefix + "c.npy")).string();
+    M::write_binary(files->a, A);
+    M::write_binary(files->b, B);
+
+    M::OutOfCoreOptions ooc;
+    ooc.memory_budget = options.ooc_budget_mb << 20;
+    return [files, ooc](int threads) mutable {
+        ooc.threads = threads;
+        M::out_of_core_multiply<T>(files->a, files->b, files->c, ooc);
+    };
+}
+
+template<typename T>
+static void bench_type(const std::string& type, const BenchOptions& options, int rank,
+                       const M::RooflineProfile* profile, std::vector<BenchResult>& results,
+                       std::vector<SparseCrossover>& crossovers) {
+    const bool need_sparse = std::any_of(options.backends.begin(), options.backends.end(), is_sparse);
+    const bool need_bsr = std::find(options.backends.begin(), options.backends.end(), Backend::Bsr)
+                          != options.backends.end();
+    const bool need_batched = std::find(options.backends.begin(), options.backends.end(), Backend::Batched)
+                              != options.backends.end();
+    const bool need_quant = std::find(options.backends.begin(), options.backends.end(), Backend::Quant)
+                            != options.backends.end();
+    const bool need_ooc = std::find(options.backends.begin(), options.backends.end(), Backend::OutOfCore)
+                          != options.backends.end();
+
+    for (int size : options.sizes) {
+        // Входные данные нужны только на ранге 0: остальные получают полосы через MPI.
+        M::Matrix<T> A{}, B{}, C{};
+        std::vector<SparseInput<T>> sparse_inputs;
+        std::function<void(int)> batched;
+        std::function<void(M::MatrixView<T>, int)> quantized;
+        std::function<void(int)> out_of_core;
+        if (rank == 0) {
+            std::cout << "Processing " << type << " " << size << "x" << size << std::endl;
+            A = M::Matrix<T>(size, size);
+            B = M::Matrix<T>(size, size);
+            C = M::Matrix<T>(size, size);
+            A.fill_random(static_cast<T>(MIN_VALUE), static_cast<T>(MAX_VALUE), options.seed, omp_get_max_threads());
+            B.fill_random(static_cast<T>(MIN_VALUE), static_cast<T>(MAX_VALUE), options.seed + 1, omp_get_max_threads());
+            for (double density : need_sparse ? options.densities : std::vector<double>{}) {
+                SparseInput<T> input{density, M::random_sparse<T>(size, size, density, static_cast<T>(MIN_VALUE + 1),
+                                                                  static_cast<T>(MAX_VALUE), options.seed + 2,
+                                                                  options.sparse_cluster, omp_get_max_threads()), {}};
+                if (need_bsr) {
+                    input.bsr = M::BsrMatrix<T>::from_csr(input.csr, options.bsr_block);
+                }
+                sparse_inputs.push_back(std::move(input));
+            }
+            if (need_batched) {
+                batched = make_batched_run<T>(size, options.batch_count, options.seed);
+                if (!batched) {
+                    std::cout << "  batched: size " << size << " is not instantiated (use 4, 8, 16 or 32)" << std::endl;
+                }
+            }
+            if (need_quant) {
+                quantized = make_quantized_run<T>(A, B);
+                if (!quantized) {
+                    std::cout << "  quant: only int inputs with values in the int16 range are supported" << std::endl;
+                }
+            }
+            if (need_ooc) {
+                out_of_core = make_out_of_core_run<T>(A, B, type, options);
+            }
+        }
+
+        for (Backend backend : options.backends) {
+            // Serial не зависит от числа потоков, MPI — единственный, кому нужны ранги.
+            const std::vector<int> thread_counts = backend == Backend::Serial ? std::vector<int>{1} : options.threads;
+            const std::vector<int> rank_counts = backend == Backend::Mpi ? options.ranks : std::vector<int>{1};
+            // Плотные бэкенды прогоняются один раз, разреженные — на каждой плотности,
+            // batched — только на размерах, для которых есть ядро, quant — только для int.
+            const size_t variants = is_sparse(backend) ? sparse_inputs.size()
+                                    : backend == Backend::Batched ? (batched ? 1 : 0)
+                                    : backend == Backend::Quant ? (quantized ? 1 : 0) : 1;
+
+            for (int ranks : rank_counts) {
+                RunGroup group;
+#ifdef MATRIX_BENCH_MPI
+                if (backend == Backend::Mpi) {
+                    MPI_Comm_split(MPI_COMM_WORLD, rank < ranks ? 0 : MPI_UNDEFINED, rank, &group.comm);
+                    group.distributed = true;
+                    group.member = group.comm != MPI_COMM_NULL;
+                }
+#endif
+                for (int threads : thread_counts) {
+                    if (!group.distributed && rank != 0) {
+                        continue;
+                    }
+                    for (size_t variant = 0; variant < variants; ++variant) {
+                        Operands<T> in{A, B};
+                        double density = 1.0;
+                        double flops = 2.0 * size * size * size;
+                        if (is_sparse(backend)) {
+                            const SparseInput<T>& input = sparse_inputs[variant];
+                            in.csr = &input.csr;
+                            in.bsr = &input.bsr;
+                            density = input.density;
+                            // Полезные операции: нули, дополняющие блоки BSR, не считаются.
+                            flops = 2.0 * static_cast<double>(input.csr.get_nnz()) * size;
+                        }
+                        if (backend == Backend::Batched) {
+                            in.batched = batched;
+                            flops *= static_cast<double>(options.batch_count);
+                        }
+                        in.quantized = quantized;
+                        in.out_of_core = out_of_core;
+
+                        Measurement measurement = measure(backend, in, C, threads, options, group);
+                        if (rank != 0) {
+                            continue;
+                        }
+
+                        const BenchmarkStats stats = compute_stats(measurement.samples);
+                        const double rate = flops / stats.median * 1e-9;
+                        BenchResult result{type, backend, size, ranks, threads, density, flops,
+                                           std::move(measurement.samples), stats, rate, measurement.counters};
+                        std::cout << "  " << to_string(backend) << " ranks " << ranks << " threads " << threads;
+                        if (is_sparse(backend)) {
+                            std::cout << " density " << density;
+                        }
+                        std::cout << ": median " << stats.median << " s, min " << stats.min << " s, p95 " << stats.p95
+                                  << " s, stddev " << stats.stddev << " s, " << rate << " GFLOP/s";
+                        // Потолок roofline посчитан для плотного gemm на T: к spmm и к qgemm (другие
+                        // команды и ширина данных) он не относится.
+                        if (profile && !is_sparse(backend) && backend != Backend::Quant) {
+                            // Ранги считаются ядрами того же узла, на котором шла калибровка.
+                            result.intensity = M::gemm_intensity<T>(size, size, size);
+                            result.roofline_gflops = M::roofline_bound(*profile, result.intensity, ranks * threads);
+                            std::cout << " (" << 100.0 * rate / result.roofline_gflops << "% of roofline)";
+                        }
+                        if (measurement.counters.has(PerfEvent::Cycles)) {
+                            std::cout << ", IPC " << measurement.counters.ipc();
+                        }
+                        if (options.verify && backend != Backend::Batched && backend != Backend::OutOfCore) {
+                            M::VerifyOptions verify_options;
+                            verify_options.rounds = options.verify_rounds;
+                            verify_options.threads = omp_get_max_threads();
+                            const M::VerifyResult check = is_sparse(backend)
+                                ? M::freivalds_verify(in.csr->to_dense(), B, C, verify_options)
+                                : M::freivalds_verify(A, B, C, verify_options);
+                            result.verified = check.passed;
+                            result.verify_seconds = check.seconds;
+                            if (check.passed) {
+                                std::cout << ", verified in " << check.seconds << " s";
+                            } else {
+                                std::cout << ", VERIFICATION FAILED at row " << check.bad_row;
+                            }
+                        }
+                        std::cout << std::endl;
+                        results.push_back(std::move(result));
+                    }
+                }
+#ifdef MATRIX_BENCH_MPI
+                if (group.comm != MPI_COMM_NULL) {
+                    MPI_Comm_free(&group.comm);
+                }
+#endif
+            }
+        }
+
+        if (rank == 0 && need_sparse) {
+            report_crossover(type, size, results, crossovers);
+        }
+    }
+}
+
+// Производные метрики счётчиков: имя и значение, NaN — счётчик недоступен.
+static std::vector<std::pair<std::string, double>> counter_metrics(const BenchResult& r) {
+    const double flops = r.flops * static_cast<double>(r.samples.size());
+    return {
+        {"IPC", r.counters.ipc()},
+        {"L1DMissesPerKFlop", r.counters.per_kflop(PerfEvent::L1DMisses, flops)},
+        {"LLCMissesPerKFlop", r.counters.per_kflop(PerfEvent::LLCMisses, flops)},
+        {"DTLBMissesPerKFlop", r.counters.per_kflop(PerfEvent::DTLBMisses, flops)},
+        {"BranchMissesPerKFlop", r.counters.per_kflop(PerfEvent::BranchMisses, flops)},
+    };
+}
+
+static std::vector<std::pair<std::string, double>> roofline_metrics(const BenchResult& r) {
+    return {
+        {"Intensity", r.intensity},
+        {"RooflineGFLOPS", r.roofline_gflops},
+        {"RooflinePct", 100.0 * r.gflops / r.roofline_gflops},
+    };
+}
+
+static void write_csv(const std::string& filename, const BenchOptions& options, const std::vector<BenchResult>& results) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("[write_csv]Couldn't open " + filename + " for writing.");
+    }
+
+    file << "Type,Backend,Size,Ranks,Threads,Density,Repetitions,Min,Median,P95,Mean,Stddev,GFLOPS";
+    for (const auto& metric : counter_metrics(BenchResult{})) {
+        file << "," << metric.first;
+    }
+    for (const auto& metric : roofline_metrics(BenchResult{})) {
+        file << "," << metric.first;
+    }
+    file << ",Verified,VerifySeconds\n";
+
+    file << std::setprecision(9);
+    for (const BenchResult& r : results) {
+        file << r.type << "," << to_string(r.backend) << "," << r.size << "," << r.ranks << "," << r.threads << ","
+             << r.density << "," << options.repetitions << "," << r.stats.min << "," << r.stats.median << "," << r.stats.p95 << ","
+             << r.stats.mean << "," << r.stats.stddev << "," << r.gflops;
+        // Недоступный счётчик — пустая ячейка, pandas прочитает её как NaN.
+        for (const auto& metric : counter_metrics(r)) {
+            file << ",";
+            if (!std::isnan(metric.second)) {
+                file << metric.second;
+            }
+        }
+        for (const auto& metric : roofline_metrics(r)) {
+            file << ",";
+            if (!std::isnan(metric.second)) {
+                file << metric.second;
+            }
+        }
+        file << ",";
+        if (r.verified) {
+            file << (*r.verified ? 1 : 0) << "," << r.verify_seconds;
+        } else {
+            file << ",";
+        }
+        file << "\n";
+    }
+}
+
+static void write_json_number(std::ostream& out, double value) {
+    if (std::isnan(value)) {
+        out << "null";
+    } else {
+        out << value;
+    }
+}
+
+static void write_json(const std::string& filename, const BenchOptions& options, const std::vector<BenchResult>& results,
+                       const std::vector<std::pair<std::string, M::RooflineProfile>>& profiles,
+                       const std::vector<SparseCrossover>& crossovers) {
+    std::ofstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("[write_json]Couldn't open " + filename + " for writing.");
+    }
+
+    file << std::setprecision(9);
+    file << "{\n  \"warmup\": " << options.warmup << ",\n  \"repetitions\": " << options.repetitions
+         << ",\n  \"seed\": " << options.seed << ",\n  \"machine\": {";
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        const M::RooflineProfile& p = profiles[i].second;
+        file << (i ? ", " : "") << "\"" << profiles[i].first << "\": {\"isa\": \"" << M::isa_name(p.isa)
+             << "\", \"threads\": " << p.threads << ", \"peak_core_gflops\": " << p.peak_core_gflops
+             << ", \"peak_total_gflops\": " << p.peak_total_gflops << ", \"bandwidth_gbs\": " << p.bandwidth_gbs << "}";
+    }
+    file << "},\n  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        file << (i ? ",\n" : "\n") << "    {\"type\": \"" << r.type << "\", \"backend\": \"" << to_string(r.backend)
+             << "\", \"size\": " << r.size << ", \"ranks\": " << r.ranks << ", \"threads\": " << r.threads
+             << ", \"density\": " << r.density << ", \"min\": " << r.stats.min << ", \"median\": " << r.stats.median << ", \"p95\": " << r.stats.p95
+             << ", \"mean\": " << r.stats.mean << ", \"stddev\": " << r.stats.stddev << ", \"gflops\": " << r.gflops
+             << ", \"samples\": [";
+        for (size_t s = 0; s < r.samples.size(); ++s) {
+            file << (s ? ", " : "") << r.samples[s];
+        }
+        file << "], \"counters\": ";
+        if (!r.counters.empty()) {
+            file << "{";
+            for (size_t e = 0; e < PERF_EVENT_COUNT; ++e) {
+                file << (e ? ", " : "") << "\"" << to_string(static_cast<PerfEvent>(e)) << "\": ";
+                write_json_number(file, r.counters.get(static_cast<PerfEvent>(e)));
+            }
+            for (const auto& metric : counter_metrics(r)) {
+                file << ", \"" << metric.first << "\": ";
+                write_json_number(file, metric.second);
+            }
+            file << "}";
+        }
+        else {
+            file << "null";
+        }
+        file << ", \"roofline\": ";
+        if (!std::isnan(r.roofline_gflops)) {
+            const auto metrics = roofline_metrics(r);
+            for (size_t m = 0; m < metrics.size(); ++m) {
+                file << (m ? ", " : "{") << "\"" << metrics[m].first << "\": " << metrics[m].second;
+            }
+            file << "}";
+        }
+        else {
+            file << "null";
+        }
+        file << ", \"verify\": ";
+        if (r.verified) {
+            file << "{\"passed\": " << (*r.verified ? "true" : "false") << ", \"seconds\": " << r.verify_seconds << "}";
+        }
+        else {
+            file << "null";
+        }
+        file << "}";
+    }
+    file << "\n  ],\n  \"sparse_crossover\": [";
+    for (size_t i = 0; i < crossovers.size(); ++i) {
+        const SparseCrossover& c = crossovers[i];
+        file << (i ? ",\n" : "\n") << "    {\"type\": \"" << c.type << "\", \"backend\": \"" << to_string(c.backend)
+             << "\", \"size\": " << c.size << ", \"threads\": " << c.threads << ", \"baseline\": \""
+             << to_string(c.baseline) << "\", \"density\": " << c.density << ", \"bound\": \"" << c.bound << "\"}";
+    }
+    file << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv) {
+    int rank = 0, world_size = 1;
+#ifdef MATRIX_BENCH_MPI
+    // MPI вызывается только из главного потока, вне параллельных областей.
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &provided);
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+#endif
+
+    int status = 0;
+    try {
+        const BenchOptions options = parse_options(argc, argv, world_size);
+#ifdef MATRIX_BENCH_MPI
+        // Сверка часов — коллективный обмен, нужный только трассе.
+        if (!options.trace_path.empty()) {
+            M::trace_sync_clock(MPI_COMM_WORLD);
+        }
+#endif
+        std::vector<BenchResult> results;
+        std::vector<SparseCrossover> crossovers;
+        std::vector<std::pair<std::string, M::RooflineProfile>> profiles;
+        profiles.reserve(options.types.size());
+
+        for (const std::string& type : options.types) {
+            if (type == "int") {
+                tune<int>(type, options, rank);
+            } else if (type == "float") {
+                tune<float>(type, options, rank);
+            } else {
+                tune<double>(type, options, rank);
+            }
+        }
+        if (options.tune && rank == 0) {
+            M::TuningCache::instance().save();
+            std::cout << "Tuning cache written to " << M::TuningCache::instance().path() << std::endl;
+        }
+
+        for (const std::string& type : options.types) {
+            if (type == "int") {
+                bench_type<int>(type, options, rank, calibrate<int>(type, options, rank, profiles), results,
+                                crossovers);
+            } else if (type == "float") {
+                bench_type<float>(type, options, rank, calibrate<float>(type, options, rank, profiles), results,
+                                  crossovers);
+            } else {
+                bench_type<double>(type, options, rank, calibrate<double>(type, options, rank, profiles), results,
+                                   crossovers);
+            }
+        }
+
+        if (rank == 0) {
+            write_csv(options.csv_path, options, results);
+            write_json(options.json_path, options, results, profiles, crossovers);
+            std::cout << "Results written to " << options.csv_path << " and " << options.json_path << std::endl;
+        }
+
+        if (!options.trace_path.empty()) {
+#ifndef M_TRACE
+            if (rank == 0) {
+                std::cerr << "Warning: built without MATRIX_TRACE, the trace has no spans" << std::endl;
+            }
+#endif
+#ifdef MATRIX_BENCH_MPI
+            M::write_trace(options.trace_path, MPI_COMM_WORLD);
+#else
+            M::write_trace(options.trace_path);
+#endif
+        }
+    } catch (const std::exception& e) {
+        if (rank == 0) {
+            std::cerr << "Error: " << e.what() << std::endl;
+        }
+        status = 1;
+    }
+
+#ifdef MATRIX_BENCH_MPI
+    MPI_Finalize();
+#endif
+    return status;
+}
@@ -3,34 +3,40 @@
 #include <vector>
 #include <string>
 #include <fstream>
+#ifdef _WIN32
 #include <direct.h>
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 #include <stdexcept>
 #include <iomanip>
+#include <optional>
 
 #include "include/matrix.h"
+#include "include/pool_gemm.h"
+#include "include/strassen.h"
+#include "include/verify.h"
 #include "stat.h"
 
 constexpr auto MIN_VALUE = 0;
 constexpr auto MAX_VALUE = 100;
+constexpr uint64_t DEFAULT_SEED = 42;
+
+// Пул переиспользует буферы между прогонами на одном размере.
+using BenchMatrix = M::Matrix<int, M::PoolAllocator<int>>;
 
-template<typename T>
-static M::Matrix<T> matrix_multiply_omp(const M::Matrix<T>& lhs, const M::Matrix<T>& rhs, int threads) {
+template<typename T, typename Alloc>
+static M::Matrix<T, Alloc> matrix_multiply_omp(const M::Matrix<T, Alloc>& lhs, const M::Matrix<T, Alloc>& rhs,
+                                               int threads, M::GemmBackend backend = M::GemmBackend::OpenMP,
+                                               const std::optional<M::OmpGemmConfig>& config = std::nullopt) {
     if (lhs.get_cols() != rhs.get_rows()) {
         throw std::invalid_argument{"Matrix dimensions mismatch"};
     }
 
-    M::Matrix<T> result(lhs.get_rows(), rhs.get_cols());
+    M::Matrix<T, Alloc> result(lhs.get_rows(), rhs.get_cols());
 
-#pragma omp parallel for num_threads(threads)
-    for (int i = 0; i < lhs.get_rows(); ++i) {
-        for (int j = 0; j < rhs.get_cols(); ++j) {
-            T sum{};
-            for (size_t k = 0; k < lhs.get_cols(); ++k) {
-                sum += lhs(i, k) * rhs(k, j);
-            }
-            result(i, j) = sum;
-        }
-    }
+    M::parallel_gemm(backend, lhs.view(), rhs.view(), result.view(), threads, config);
 
     return result;
 }
@@ -51,7 +57,9 @@ bool change_directory(const std::string& path) {
 #endif
 }
 
-void test_threads_performance(const M::Matrix<int>& A, const M::Matrix<int>& B, const std::string& dir_name) {
+void test_threads_performance(const BenchMatrix& A, const BenchMatrix& B, const std::string& dir_name,
+                              M::GemmBackend backend = M::GemmBackend::OpenMP,
+                              const M::OmpGemmConfig& config = {}) {
     std::vector<int> thread_counts;
     int max_threads = omp_get_max_threads();
 
@@ -67,7 +75,7 @@ void test_threads_performance(const M::Matrix<int>& A, const M::Matrix<int>& B,
     for (size_t i = 0; i < thread_counts.size(); i++) {
         int threads = thread_counts[i];
         ExecutionTimer timer;
-        M::Matrix<int> result = matrix_multiply_omp(A, B, threads);
+        BenchMatrix result = matrix_multiply_omp(A, B, threads, backend, config);
         timer.stop();
         thread_times[i] = timer.get_duration();
         std::cout << "Size " << A.get_rows() << "x" << A.get_cols()
@@ -87,25 +95,17 @@ void test_threads_performance(const M::Matrix<int>& A, const M::Matrix<int>& B,
     thread_file.close();
 }
 
-template<typename T>
+template<typename T, typename Alloc>
 void write_matrix(const std::string& filename,
-                 const M::Matrix<T>& matrix,
-                 std::ios_base::openmode mode = std::ios::out) {
-    std::ofstream file(filename, mode);
-    if (!file) throw std::runtime_error("File error");
-
-    file << matrix.get_rows() << " " << matrix.get_cols() << "\n";
-    for (int i = 0; i < matrix.get_rows(); ++i) {
-        for (int j = 0; j < matrix.get_cols(); ++j) {
-            file << matrix(i, j) << " ";
-        }
-        file << "\n";
-    }
+                  const M::Matrix<T, Alloc>& matrix,
+                  int threads = 1) {
+    M::write_text(filename, matrix.view(), M::TextLayout{' ', true}, threads);
 }
 
 void write_csv_results(const std::vector<int>& sizes,
                       const std::vector<int>& thread_counts,
-                      const std::vector<std::vector<double>>& results) {
+                      const std::vector<std::vector<double>>& results,
+                      const std::vector<double>& strassen_times) {
     std::ofstream file("statistic.csv");
     if (!file.is_open()) {
         throw std::runtime_error("Couldn't open statistic.csv for writing");
@@ -124,10 +124,68 @@ void write_csv_results(const std::vector<int>& sizes,
         }
         file << "\n";
     }
+
+    // Штрассен запускается на максимальном числе потоков, экономия считается
+    // относительно классического умножения на том же числе потоков.
+    file << "Strassen";
+    for (size_t j = 0; j < sizes.size(); j++) {
+        file << "," << std::fixed << std::setprecision(4) << strassen_times[j];
+    }
+    file << "\n";
+
+    file << "Saved";
+    for (size_t j = 0; j < sizes.size(); j++) {
+        file << "," << std::fixed << std::setprecision(4) << results.back()[j] - strassen_times[j];
+    }
+    file << "\n";
 }
 
-int main() {
+int main(int argc, char** argv) {
     std::vector<int> SIZES = {100, 200, 300, 400, 500, 1000, 2000};
+    size_t strassen_cutoff = 0;  // 0 — подобранный автотюнером или STRASSEN_DEFAULT_CUTOFF
+    uint64_t seed = DEFAULT_SEED;
+    M::OmpGemmConfig omp_config;
+    bool omp_config_given = false;  // без --schedule, --chunk, --decomposition и --tile — из кэша автотюнера
+    M::GemmBackend backend = M::GemmBackend::OpenMP;
+    bool verify = false;  // --verify: проверка по Фрейвалдсу вместо записи A.txt, B.txt и result.txt
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if (arg == "--strassen-cutoff" && i + 1 < argc) {
+            strassen_cutoff = std::stoul(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::stoull(argv[++i]);
+        } else if (arg == "--backend" && i + 1 < argc) {
+            backend = M::parse_backend(argv[++i]);
+        } else if (arg == "--schedule" && i + 1 < argc) {
+            omp_config.schedule = M::parse_schedule(argv[++i]);
+            omp_config_given = true;
+        } else if (arg == "--chunk" && i + 1 < argc) {
+            omp_config.chunk = std::stoi(argv[++i]);
+            omp_config_given = true;
+        } else if (arg == "--decomposition" && i + 1 < argc) {
+            omp_config.decomposition = M::parse_decomposition(argv[++i]);
+            omp_config_given = true;
+        } else if (arg == "--tile" && i + 1 < argc) {
+            // --tile MxN, например 64x256
+            const std::string tile = argv[++i];
+            const size_t x = tile.find('x');
+            omp_config.tile_m = std::stoul(tile.substr(0, x));
+            omp_config.tile_n = x == std::string::npos ? omp_config.tile_m : std::stoul(tile.substr(x + 1));
+            omp_config_given = true;
+        } else if (arg == "--verify") {
+            verify = true;
+        }
+    }
+    const std::optional<M::OmpGemmConfig> config = omp_config_given ? std::optional{omp_config} : std::nullopt;
+    std::cout << "Backend: " << M::to_string(backend);
+    if (config) {
+        std::cout << ", " << M::to_string(config->decomposition) << ", schedule " << M::to_string(config->schedule)
+                  << ", chunk " << config->chunk << std::endl;
+    } else {
+        std::cout << ", tuned configuration" << std::endl;
+    }
+
     std::vector<int> THREAD_COUNTS;
 
     for (int threads = 1; threads <= omp_get_max_threads(); threads *= 2) {
@@ -139,6 +197,19 @@ int main() {
 
     std::vector<std::vector<double>> results(THREAD_COUNTS.size(),
                                           std::vector<double>(SIZES.size()));
+    std::vector<double> strassen_times(SIZES.size());
+
+    // Проверка идёт после замера и в него не входит.
+    M::VerifyOptions verify_options;
+    verify_options.threads = omp_get_max_threads();
+    const auto report = [&](const BenchMatrix& A, const BenchMatrix& B, const BenchMatrix& result) {
+        const M::VerifyResult check = M::freivalds_verify(A, B, result, verify_options);
+        if (check.passed) {
+            std::cout << "    Verified in " << check.seconds << " s" << std::endl;
+        } else {
+            std::cout << "    VERIFICATION FAILED at row " << check.bad_row << std::endl;
+        }
+    };
 
     if (!change_directory("C:\\Users\\user\\Desktop\\ALL\\University\\3 cours\\6 semester\\PP\\Labs")) {
         std::cerr << "Failed to change directory!" << std::endl;
@@ -154,24 +225,47 @@ int main() {
 
     for (size_t size_idx = 0; size_idx < SIZES.size(); size_idx++) {
         int current_size = SIZES[size_idx];
+        // Блоки прошлого размера здесь уже в пуле, но на этом размере не пригодятся.
+        M::PoolAllocator<int>::trim();
         std::cout << "Processing size: " << current_size << "x" << current_size << std::endl;
 
-        M::Matrix<int> A(current_size, current_size);
-        M::Matrix<int> B(current_size, current_size);
-        A.fill_random(MIN_VALUE, MAX_VALUE);
-        B.fill_random(MIN_VALUE, MAX_VALUE);
+        BenchMatrix A(current_size, current_size);
+        BenchMatrix B(current_size, current_size);
+        // Одинаковый seed даёт одинаковые входные данные в каждом запуске.
+        A.fill_random(MIN_VALUE, MAX_VALUE, seed, omp_get_max_threads());
+        B.fill_random(MIN_VALUE, MAX_VALUE, seed + 1, omp_get_max_threads());
 
         for (size_t thread_idx = 0; thread_idx < THREAD_COUNTS.size(); thread_idx++) {
             int threads = THREAD_COUNTS[thread_idx];
 
             ExecutionTimer timer;
-            M::Matrix<int> result = matrix_multiply_omp(A, B, threads);
+            BenchMatrix result = matrix_multiply_omp(A, B, threads, backend, config);
             timer.stop();
 
             double time = timer.get_duration();
             results[thread_idx][size_idx] = time;
 
             std::cout << "  Threads: " << threads << " Time: " << time << " ms" << std::endl;
+            if (verify) {
+                report(A, B, result);
+            }
+        }
+
+        {
+            ExecutionTimer timer;
+            BenchMatrix result = M::strassen_multiply(A, B, strassen_cutoff, omp_get_max_threads());
+            timer.stop();
+
+            strassen_times[size_idx] = timer.get_duration();
+            std::cout << "  Strassen (cutoff " << (strassen_cutoff ? std::to_string(strassen_cutoff) : "auto") << "): " << strassen_times[size_idx]
+                      << " Saved: " << results.back()[size_idx] - strassen_times[size_idx] << std::endl;
+            if (verify) {
+                report(A, B, result);
+            }
+        }
+
+        if (verify) {
+            continue;
         }
 
         std::string dir_name = std::to_string(current_size);
@@ -183,17 +277,19 @@ int main() {
 
         // Последовательная запись файлов
         try {
-            write_matrix("A.txt", A);
-            write_matrix("B.txt", B);
-            write_matrix("result.txt", matrix_multiply_omp(A, B, omp_get_max_threads()));
+            const int threads = omp_get_max_threads();
+            write_matrix("A.txt", A, threads);
+            write_matrix("B.txt", B, threads);
+            write_matrix("result.txt", matrix_multiply_omp(A, B, threads, backend, config), threads);
         } catch (const std::exception& e) {
             std::cerr << "Error writing files: " << e.what() << std::endl;
         }
 
         change_directory("..");
     }
+    M::PoolAllocator<int>::trim();
 
-    write_csv_results(SIZES, THREAD_COUNTS, results);
+    write_csv_results(SIZES, THREAD_COUNTS, results, strassen_times);
 
     return 0;
 }
\ No newline at end of file
@@ -1,18 +1,253 @@
 #include "../include/stat.h"
 
-ExecutionTimer::ExecutionTimer() :
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#ifdef __linux__
+#include <dirent.h>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef __linux__
+    struct EventConfig {
+        uint32_t type;
+        uint64_t config;
+    };
+
+    constexpr uint64_t cache_miss(uint64_t cache) {
+        return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    }
+
+    // Порядок совпадает с PerfEvent.
+    constexpr std::array<EventConfig, PERF_EVENT_COUNT> EVENT_CONFIGS = {{
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_L1D)},
+        {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_LL)},
+        {PERF_TYPE_HW_CACHE, cache_miss(PERF_COUNT_HW_CACHE_DTLB)},
+        {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    }};
+
+    int open_counter(const EventConfig& event, pid_t tid) {
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = event.type;
+        attr.config = event.config;
+        attr.disabled = 1;
+        // Только пользовательский код: так счётчики доступны и при perf_event_paranoid = 2.
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // Время включения и работы нужно, чтобы пересчитать значение при мультиплексировании.
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, tid, -1, -1, 0));
+    }
+
+    std::vector<pid_t> process_threads() {
+        std::vector<pid_t> tids;
+        if (DIR* dir = opendir("/proc/self/task")) {
+            while (const dirent* entry = readdir(dir)) {
+                if (entry->d_name[0] != '.') {
+                    tids.push_back(static_cast<pid_t>(std::atoi(entry->d_name)));
+                }
+            }
+            closedir(dir);
+        }
+        return tids;
+    }
+#endif
+}
+
+const char* to_string(PerfEvent event) {
+    switch (event) {
+    case PerfEvent::Cycles: return "cycles";
+    case PerfEvent::Instructions: return "instructions";
+    case PerfEvent::L1DMisses: return "l1d_misses";
+    case PerfEvent::LLCMisses: return "llc_misses";
+    case PerfEvent::DTLBMisses: return "dtlb_misses";
+    case PerfEvent::BranchMisses: return "branch_misses";
+    }
+    return "unknown";
+}
+
+bool PerfSample::empty() const {
+    return std::none_of(valid.begin(), valid.end(), [](bool v) { return v; });
+}
+
+bool PerfSample::has(PerfEvent event) const {
+    const size_t e = static_cast<size_t>(event);
+    return valid[e] && !std::isnan(values[e]);
+}
+
+double PerfSample::get(PerfEvent event) const {
+    return has(event) ? values[static_cast<size_t>(event)] : std::numeric_limits<double>::quiet_NaN();
+}
+
+double PerfSample::ipc() const {
+    if (!has(PerfEvent::Cycles) || !has(PerfEvent::Instructions) || get(PerfEvent::Cycles) == 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return get(PerfEvent::Instructions) / get(PerfEvent::Cycles);
+}
+
+double PerfSample::per_kflop(PerfEvent event, double flops) const {
+    if (!has(event) || flops <= 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return get(event) / flops * 1000.0;
+}
+
+PerfSample& PerfSample::operator+=(const PerfSample& other) {
+    for (size_t i = 0; i < PERF_EVENT_COUNT; ++i) {
+        values[i] += other.values[i];
+        valid[i] = valid[i] || other.valid[i];
+    }
+    return *this;
+}
+
+PerfCounters::~PerfCounters() {
+    close_all();
+}
+
+void PerfCounters::close_all() {
+#ifdef __linux__
+    for (const Counter& counter : _counters) {
+        close(counter.fd);
+    }
+#endif
+    _counters.clear();
+}
+
+void PerfCounters::start() {
+    close_all();
+    _reason.clear();
+#ifdef __linux__
+    int error = 0;
+    for (pid_t tid : process_threads()) {
+        for (size_t e = 0; e < PERF_EVENT_COUNT; ++e) {
+            const int fd = open_counter(EVENT_CONFIGS[e], tid);
+            if (fd >= 0) {
+                _counters.push_back({fd, static_cast<PerfEvent>(e)});
+            } else if (errno != ESRCH) {
+                // ESRCH — поток успел завершиться, это не ошибка доступа.
+                error = errno;
+            }
+        }
+    }
+    if (_counters.empty()) {
+        _reason = std::string("perf_event_open failed: ") + std::strerror(error)
+                  + " (see /proc/sys/kernel/perf_event_paranoid)";
+        return;
+    }
+    for (const Counter& counter : _counters) {
+        ioctl(counter.fd, PERF_EVENT_IOC_RESET, 0);
+    }
+    for (const Counter& counter : _counters) {
+        ioctl(counter.fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#else
+    _reason = "hardware counters are only supported on Linux";
+#endif
+}
+
+PerfSample PerfCounters::stop() {
+    PerfSample sample;
+#ifdef __linux__
+    for (const Counter& counter : _counters) {
+        ioctl(counter.fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+    for (const Counter& counter : _counters) {
+        uint64_t data[3] = {};  // value, time_enabled, time_running
+        if (read(counter.fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+            continue;
+        }
+        const size_t e = static_cast<size_t>(counter.event);
+        sample.valid[e] = true;
+        if (data[2] > 0) {
+            sample.values[e] += static_cast<double>(data[0]) * static_cast<double>(data[1]) / static_cast<double>(data[2]);
+        } else if (data[1] > 0) {
+            // Счётчик был включён, но ни разу не попал на PMU (вытеснен мультиплексированием):
+            // значения нет, и NaN не даёт принять его за честный ноль ни здесь, ни в сумме повторов.
+            // time_enabled == 0 означает, что поток вовсе не работал, — это настоящий ноль.
+            sample.values[e] = std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+#endif
+    close_all();
+    return sample;
+}
+
+const std::string& PerfCounters::unavailable_reason() const {
+    return _reason;
+}
+
+ExecutionTimer::ExecutionTimer(bool verbose, PerfCounters* counters) :
     _end{},
-    _duration{}
+    _duration{},
+    _verbose{verbose},
+    _counters{counters}
 {
+    // Счётчики открываются до засечки времени, чтобы их открытие не попадало в замер.
+    if (_counters) {
+        _counters->start();
+    }
     _start = std::chrono::high_resolution_clock::now();
 }
 
 void ExecutionTimer::stop() {
     _end = std::chrono::high_resolution_clock::now();
     _duration = _end - _start;
-    std::cout << "Duration of the process: " << _duration.count() << std::endl;
+    if (_counters) {
+        _sample = _counters->stop();
+    }
+    if (_verbose) {
+        std::cout << "Duration of the process: " << _duration.count() << std::endl;
+    }
 }
 
 double ExecutionTimer::get_duration() const {
     return _duration.count();
-}
\ No newline at end of file
+}
+
+const PerfSample& ExecutionTimer::get_counters() const {
+    return _sample;
+}
+
+BenchmarkStats compute_stats(std::vector<double> samples) {
+    BenchmarkStats stats;
+    if (samples.empty()) {
+        return stats;
+    }
+    std::sort(samples.begin(), samples.end());
+    const size_t n = samples.size();
+
+    stats.min = samples.front();
+    stats.median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    const size_t rank = static_cast<size_t>(std::ceil(0.95 * static_cast<double>(n)));
+    stats.p95 = samples[std::max<size_t>(rank, 1) - 1];
+    stats.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(n);
+
+    if (n > 1) {
+        double sum = 0;
+        for (double sample : samples) {
+            sum += (sample - stats.mean) * (sample - stats.mean);
+        }
+        stats.stddev = std::sqrt(sum / static_cast<double>(n - 1));
+    }
+    return stats;
+}
+
+double gflops(size_t m, size_t n, size_t k, double seconds) {
+    if (seconds <= 0) {
+        return 0;
+    }
+    return 2.0 * static_cast<double>(m) * static_cast<double>(n) * static_cast<double>(k) / seconds * 1e-9;
+}
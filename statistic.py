@@ -1,3 +1,5 @@
+import os
+
 import numpy as np
 import matplotlib.pyplot as plt
 import pandas as pd
@@ -5,10 +7,19 @@ import pandas as pd
 SIZES = {100, 200, 300, 400, 500, 1000, 2000}
 
 
+def load_matrix(directory: str, name: str) -> np.ndarray:
+    # Бинарный .npy читается без разбора текста, .txt остаётся запасным вариантом
+    binary = os.path.join(directory, f"{name}.npy")
+    if os.path.exists(binary):
+        return np.load(binary, mmap_mode="r")
+    return np.loadtxt(os.path.join(directory, f"{name}.txt"), dtype=int)
+
+
 def checking_multiplication_correctness(path: str) -> bool:
-    A = np.loadtxt(f"result\\{path}\\A.txt", dtype=int)
-    B = np.loadtxt(f"result\\{path}\\B.txt", dtype=int)
-    result = np.loadtxt(f"result\\{path}\\result.txt", dtype=int)
+    directory = os.path.join("result", path)
+    A = load_matrix(directory, "A")
+    B = load_matrix(directory, "B")
+    result = load_matrix(directory, "result")
 
     current_result = np.dot(A, B)
     return (current_result == result).all()
@@ -37,8 +48,30 @@ def plot_results(path):
     plt.show()
 
 
+def plot_bench_results(path: str):
+    # CSV от matrix_bench: одна кривая GFLOP/s на каждую комбинацию типа, бэкенда, рангов, потоков и плотности
+    df = pd.read_csv(path)
+
+    for (dtype, backend, ranks, threads, density), group in df.groupby(["Type", "Backend", "Ranks", "Threads", "Density"]):
+        group = group.sort_values("Size")
+        label = f"{dtype} {backend} r={ranks} t={threads}" + (f" d={density}" if density < 1 else "")
+        plt.errorbar(group["Size"], group["GFLOPS"],
+                     yerr=group["GFLOPS"] * group["Stddev"] / group["Median"],
+                     marker="o", capsize=3, label=label)
+
+    plt.xlabel("Sizes")
+    plt.ylabel("GFLOP/s (по медиане)")
+    plt.title("Производительность ядер умножения")
+    plt.legend()
+    plt.grid(True)
+    plt.show()
+
+
 def main():
     plot_results("result\\statistic.txt")
+    # matrix_bench по умолчанию пишет bench.csv в текущий каталог
+    if os.path.exists("bench.csv"):
+        plot_bench_results("bench.csv")
 
 
 if __name__ == "__main__":
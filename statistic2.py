@@ -23,6 +23,9 @@ def write_compare_res(output_path: str):
 def plot_results(csv_path):
     # Читаем CSV файл
     df = pd.read_csv(csv_path)
+    # Строки Strassen/Saved рисуем отдельно от строк с числом потоков
+    extra = df[pd.to_numeric(df.iloc[:, 0], errors='coerce').isna()]
+    df = df[pd.to_numeric(df.iloc[:, 0], errors='coerce').notna()]
 
     # Получаем список размеров матриц из заголовков (исключая первый столбец)
     sizes = [int(col) for col in df.columns[1:]]
@@ -36,6 +39,10 @@ def plot_results(csv_path):
 
         plt.plot(sizes, times, marker='o', label=f'{thread_count} threads')
 
+    for i in range(len(extra)):
+        if extra.iloc[i, 0] == 'Strassen':
+            plt.plot(sizes, extra.iloc[i, 1:].values, marker='s', linestyle='--', label='Strassen')
+
     plt.xlabel('Size')
     plt.ylabel('Time (s)')
     plt.title('Зависимость Times от Sizes')
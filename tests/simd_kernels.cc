@@ -0,0 +1,114 @@
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "../include/batched_gemm.h"
+#include "../include/quantized_gemm.h"
+#include "../include/roofline.h"
+#include "../include/simd_kernels.h"
+
+// Каждое ядро каждого доступного набора инструкций сверяется с прямым счётом. Цель собирается
+// без оптимизаций: при -O0 flatten не встраивает тела, и именно там проявляется рассогласование
+// ABI векторных аргументов между функциями с разным target. Значения — небольшие целые,
+// поэтому и для float/double сравнение точное.
+
+static int failures = 0;
+
+static void check(bool ok, const char* what, M::Isa isa) {
+    if (!ok) {
+        std::printf("%s: mismatch on %s\n", what, M::isa_name(isa));
+        ++failures;
+    }
+}
+
+template <typename T>
+static T small_value(size_t i) {
+    return static_cast<T>(static_cast<int>((i * 7919 + 13) % 11) - 5);
+}
+
+// Полная и неполная полоска C для микроядра gemm.
+template <typename T>
+static void check_micro_kernel(M::Isa isa, const char* what) {
+    const M::MicroKernel<T> kernel = M::micro_kernel_for<T>(isa);
+    const size_t kc = 37, ldc = kernel.nr + 3;
+    std::vector<T> ap(kc * kernel.mr), bp(kc * kernel.nr);
+    for (size_t i = 0; i < ap.size(); ++i) ap[i] = small_value<T>(i);
+    for (size_t i = 0; i < bp.size(); ++i) bp[i] = small_value<T>(i + 5);
+
+    for (size_t shrink : {0, 1}) {
+        const size_t mr = kernel.mr - shrink, nr = kernel.nr - shrink;
+        std::vector<T> c(kernel.mr * ldc, T(1)), expected = c;
+        kernel.run(kc, ap.data(), bp.data(), c.data(), ldc, mr, nr);
+        for (size_t i = 0; i < mr; ++i) {
+            for (size_t j = 0; j < nr; ++j) {
+                for (size_t p = 0; p < kc; ++p) {
+                    expected[i * ldc + j] += ap[p * kernel.mr + i] * bp[p * kernel.nr + j];
+                }
+            }
+        }
+        check(c == expected, what, isa);
+    }
+}
+
+// Блок из L произведений R x K на K x N против переносимого варианта.
+template <typename T, size_t R, size_t K, size_t N>
+static void check_batched_block(M::Isa isa, const char* what) {
+    constexpr size_t L = M::FixedBatch<T, R, K>::LANES;
+    std::vector<T> a(R * K * L), b(K * N * L), c(R * N * L), expected(R * N * L);
+    for (size_t i = 0; i < a.size(); ++i) a[i] = small_value<T>(i);
+    for (size_t i = 0; i < b.size(); ++i) b[i] = small_value<T>(i + 3);
+    M::detail::BatchedKernels<T, R, K, N, L>::get(isa)(a.data(), b.data(), c.data());
+    M::detail::scalar_batched_block<T, R, K, N, L>(a.data(), b.data(), expected.data());
+    check(c == expected, what, isa);
+}
+
+// Микроядро int16 -> int32 на упакованных парах, k нечётное (последняя пара дополнена нулём).
+static void check_quant_kernel(M::Isa isa) {
+    const M::QuantKernel kernel = M::quant_kernel(isa);
+    const size_t kc = 29, kp = (kc + 1) / 2, ldc = kernel.nr;
+    std::vector<int16_t> a(kernel.mr * kc), b(kc * kernel.nr);
+    for (size_t i = 0; i < a.size(); ++i) a[i] = small_value<int16_t>(i) * 100;
+    for (size_t i = 0; i < b.size(); ++i) b[i] = small_value<int16_t>(i + 1) * 100;
+    std::vector<int16_t> ap(2 * kernel.mr * kp), bp(2 * kernel.nr * kp);
+    M::detail::pack_a_pairs(kernel.mr, kc, a.data(), kc, ap.data(), kernel.mr);
+    M::detail::pack_b_pairs(kc, kernel.nr, b.data(), kernel.nr, bp.data(), kernel.nr);
+
+    std::vector<int32_t> c(kernel.mr * ldc, 1), expected = c;
+    kernel.run(kp, ap.data(), bp.data(), c.data(), ldc, kernel.mr, kernel.nr);
+    for (size_t i = 0; i < kernel.mr; ++i) {
+        for (size_t j = 0; j < kernel.nr; ++j) {
+            for (size_t p = 0; p < kc; ++p) {
+                expected[i * ldc + j] += int32_t{a[i * kc + p]} * b[p * kernel.nr + j];
+            }
+        }
+    }
+    check(c == expected, "quant kernel", isa);
+}
+
+// acc = acc * 1 + 2 за 10 итераций даёт 20 в каждой дорожке каждого аккумулятора.
+template <typename T>
+static void check_peak_loop(M::Isa isa, const char* what) {
+    const M::detail::PeakLoop<T> loop = M::detail::PeakLoops<T>::get(isa);
+    const T expected = static_cast<T>(20 * M::detail::PEAK_ACCUMULATORS * loop.width);
+    check(loop.run(10, T(1), T(2)) == expected, what, isa);
+}
+
+int main() {
+    const M::Isa detected = M::detect_isa();
+    for (M::Isa isa : {M::Isa::Scalar, M::Isa::Sse42, M::Isa::Avx2, M::Isa::Avx512}) {
+        if (isa > detected) {
+            break;
+        }
+        check_micro_kernel<int>(isa, "int micro kernel");
+        check_micro_kernel<float>(isa, "float micro kernel");
+        check_micro_kernel<double>(isa, "double micro kernel");
+        check_batched_block<int, 4, 4, 4>(isa, "int batched 4x4x4");
+        check_batched_block<float, 5, 3, 7>(isa, "float batched 5x3x7");
+        check_batched_block<double, 8, 8, 8>(isa, "double batched 8x8x8");
+        check_quant_kernel(isa);
+        check_peak_loop<int>(isa, "int peak loop");
+        check_peak_loop<float>(isa, "float peak loop");
+        check_peak_loop<double>(isa, "double peak loop");
+    }
+    return failures == 0 ? 0 : 1;
+}